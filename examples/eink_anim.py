@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+"""
+eink_anim.py - Precompiled 1bpp animations for Pamir AI E-Ink display
+
+Copyright (C) 2025 Pamir AI
+License: GPL v2
+
+Frames are converted to 1bpp once, offline, and stored as the byte-aligned
+rectangles that change from one frame to the next. Playback maps the file
+and copies those rectangles straight into the framebuffer, refreshing only
+the area they cover, so almost no CPU is spent per frame.
+
+Usage:
+    eink_anim.py compile <input.gif> <output.eanim> [options]
+    eink_anim.py play <file.eanim> [--loops N] [--device DEV]
+
+File format (little endian):
+    header      magic "EINKANIM", version, width, height, reserved,
+                frame count
+    key frame   frame 0 as height rows of width / 8 bytes
+    frame table per frame: data offset, duration in ms, rect count and
+                the bounding box of its rects
+    frame data  per frame: rect headers (x, y, width, height) followed by
+                their packed rows
+
+Width is padded to a multiple of 8 and every rect is byte aligned, so rows
+are copied without shifting. The delta of frame 0 goes from the last
+frame back to the first, so loops never need a full frame again.
+"""
+
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+import numpy as np
+from PIL import Image
+
+try:
+    from eink_common import EInkDisplay, EPD_MODE_FULL, EPD_MODE_PARTIAL
+    import eink_dither
+except ImportError:
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    from eink_common import EInkDisplay, EPD_MODE_FULL, EPD_MODE_PARTIAL
+    import eink_dither
+
+ANIM_MAGIC = b"EINKANIM"
+ANIM_VERSION = 1
+
+_HEADER = struct.Struct("<8sHHHHI")
+_FRAME = struct.Struct("<IIHHHHH2x")
+_RECT = struct.Struct("<HHHH")
+
+# Unchanged rows that still get merged into one rect rather than split
+DEFAULT_ROW_GAP = 8
+
+
+def pack_frame(image, width, height, method=None):
+    """Convert an image to packed rows, padded white to width pixels.
+
+    Ordered dithering is the default when eink_dither is available: its
+    pattern does not move between frames, which keeps the deltas small.
+    """
+    grey = Image.new("L", (width, height), 255)
+    grey.paste(image.convert("L"), (0, 0))
+
+    if eink_dither.available():
+        if method is None:
+            method = eink_dither.DITHER_ORDERED
+        return eink_dither.dither_packed(np.asarray(grey), method)
+
+    mono = grey.convert("1")
+    return np.frombuffer(mono.tobytes(), dtype=np.uint8).reshape(height, width // 8)
+
+
+def delta_rects(prev, cur, row_gap=DEFAULT_ROW_GAP):
+    """Byte-aligned rects covering every byte that differs.
+
+    Changed rows are grouped into bands, joining bands separated by fewer
+    than row_gap unchanged rows, and each band is trimmed to its changed
+    byte columns.
+
+    Returns:
+        list of (x, y, width, height) in pixels
+    """
+    changed = prev != cur
+    rows = np.flatnonzero(changed.any(axis=1))
+    if rows.size == 0:
+        return []
+
+    # Split where the gap to the next changed row is too large
+    breaks = np.flatnonzero(np.diff(rows) > row_gap)
+    starts = np.concatenate(([rows[0]], rows[breaks + 1]))
+    ends = np.concatenate((rows[breaks], [rows[-1]])) + 1
+
+    rects = []
+    for y0, y1 in zip(starts, ends):
+        cols = np.flatnonzero(changed[y0:y1].any(axis=0))
+        rects.append(
+            (
+                int(cols[0]) * 8,
+                int(y0),
+                int(cols[-1] - cols[0] + 1) * 8,
+                int(y1 - y0),
+            )
+        )
+    return rects
+
+
+def compile_frames(frames, durations, method=None, row_gap=DEFAULT_ROW_GAP):
+    """Compile PIL frames and durations in ms to animation file bytes."""
+    if not frames:
+        raise ValueError("no frames to compile")
+
+    width = (frames[0].width + 7) // 8 * 8
+    height = frames[0].height
+    packed = [pack_frame(frame, width, height, method) for frame in frames]
+    count = len(packed)
+
+    data_offset = _HEADER.size + packed[0].nbytes + count * _FRAME.size
+    table = []
+    data = []
+
+    for i, cur in enumerate(packed):
+        rects = delta_rects(packed[i - 1], cur, row_gap)
+        if rects:
+            ux0 = min(r[0] for r in rects)
+            uy0 = min(r[1] for r in rects)
+            ux1 = max(r[0] + r[2] for r in rects)
+            uy1 = max(r[1] + r[3] for r in rects)
+            union = (ux0, uy0, ux1 - ux0, uy1 - uy0)
+        else:
+            union = (0, 0, 0, 0)
+
+        table.append(_FRAME.pack(data_offset, int(durations[i]), len(rects), *union))
+        for x, y, w, h in rects:
+            chunk = (
+                _RECT.pack(x, y, w, h) + cur[y : y + h, x // 8 : (x + w) // 8].tobytes()
+            )
+            data.append(chunk)
+            data_offset += len(chunk)
+
+    header = _HEADER.pack(ANIM_MAGIC, ANIM_VERSION, width, height, 0, count)
+    return b"".join([header, packed[0].tobytes()] + table + data)
+
+
+class Animation:
+    """A compiled animation, mapped from a file or wrapped from bytes."""
+
+    def __init__(self, source):
+        self._file = None
+        self._map = None
+
+        if isinstance(source, (bytes, bytearray)):
+            data = source
+        else:
+            self._file = open(source, "rb")
+            self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+            data = self._map
+
+        try:
+            parsed = self._parse(data)
+        except (ValueError, struct.error) as e:
+            error = str(e) if isinstance(e, ValueError) else "truncated animation file"
+        else:
+            self.width, self.height, self.key_frame, self.frames = parsed
+            return
+
+        # Only now is the traceback, and the views it held, gone
+        self.close()
+        raise ValueError(error)
+
+    def _parse(self, data):
+        """Returns (width, height, key_frame, frames)."""
+        if len(data) < _HEADER.size:
+            raise ValueError("not an animation file")
+        magic, version, width, height, _, count = _HEADER.unpack_from(data, 0)
+        if magic != ANIM_MAGIC or version != ANIM_VERSION:
+            raise ValueError("not an animation file, or an unsupported version")
+
+        stride = width // 8
+        offset = _HEADER.size
+        key_frame = np.frombuffer(data, np.uint8, height * stride, offset)
+        key_frame = key_frame.reshape(height, stride)
+        offset += height * stride
+
+        # Views into the mapping, so frame data is never copied until drawn
+        frames = []
+        for i in range(count):
+            data_offset, duration, nrects, *union = _FRAME.unpack_from(
+                data, offset + i * _FRAME.size
+            )
+            rects = []
+            for _ in range(nrects):
+                x, y, w, h = _RECT.unpack_from(data, data_offset)
+                data_offset += _RECT.size
+                if x + w > width or y + h > height:
+                    raise ValueError(f"frame {i}: rect outside the animation")
+                rows = np.frombuffer(data, np.uint8, h * w // 8, data_offset)
+                rects.append((x, y, rows.reshape(h, w // 8)))
+                data_offset += h * w // 8
+            frames.append((duration, rects, tuple(union)))
+        return width, height, key_frame, frames
+
+    def close(self):
+        """Drop the frame views and unmap the file."""
+        self.key_frame = None
+        self.frames = []
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
+def play(display, anim, x=None, y=None, loops=1, mode=EPD_MODE_PARTIAL, on_frame=None):
+    """Play an animation, refreshing only what changes between frames.
+
+    Frame 0 is drawn whole and shown with a full update, then each frame
+    copies its rects into the framebuffer and refreshes their bounding box
+    in the given mode. Frames are paced by their durations; when the panel
+    is slower than that the animation just runs at the panel's rate.
+
+    Args:
+        display: EInkDisplay
+        anim: Animation
+        x, y: Position; centred by default, x is rounded down to 8
+        loops: Number of loops, 0 for endless
+        mode: Update mode for the frames after the first
+        on_frame: Optional callback(frame, loop) after each update
+    """
+    stride_px = display.buffer.shape[1] * 8
+    if x is None:
+        x = (display.width - anim.width) // 2
+    if y is None:
+        y = (display.height - anim.height) // 2
+    x = max(0, x) // 8 * 8
+    y = max(0, y)
+    if x + anim.width > stride_px or y + anim.height > display.height:
+        raise ValueError(
+            f"{anim.width}x{anim.height} animation does not fit at ({x}, {y})"
+        )
+
+    fb = display.buffer
+    bx = x // 8
+    fb[y : y + anim.height, bx : bx + anim.width // 8] = anim.key_frame
+    display.set_update_mode(EPD_MODE_FULL)
+    display.update_display()
+    display.set_update_mode(mode)
+    if on_frame:
+        on_frame(0, 0)
+
+    # Frame 0 is on screen, so its delta (last to first) is only needed
+    # from the second loop on
+    deadline = time.monotonic()
+    first = 1
+    loop = 0
+    while loops == 0 or loop < loops:
+        for i in range(first, len(anim.frames)):
+            deadline += anim.frames[i - 1][0] / 1000.0
+            delay = deadline - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            else:
+                deadline = time.monotonic()
+
+            _, rects, union = anim.frames[i]
+            for rx, ry, rows in rects:
+                fb[
+                    y + ry : y + ry + rows.shape[0],
+                    bx + rx // 8 : bx + rx // 8 + rows.shape[1],
+                ] = rows
+            if rects:
+                display.add_damage(x + union[0], y + union[1], union[2], union[3])
+                display.update_damage()
+            if on_frame:
+                on_frame(i, loop)
+        first = 0
+        loop += 1
+
+    # Hold the last frame for its duration too
+    delay = deadline + anim.frames[-1][0] / 1000.0 - time.monotonic()
+    if delay > 0:
+        time.sleep(delay)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compile and play 1bpp animations on Pamir AI E-Ink display"
+    )
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    comp = sub.add_parser("compile", help="Compile a GIF to an animation file")
+    comp.add_argument("input", help="Input GIF")
+    comp.add_argument("output", help="Output animation file")
+    comp.add_argument(
+        "--width", type=int, default=128, help="Maximum width (default: 128)"
+    )
+    comp.add_argument(
+        "--height", type=int, default=250, help="Maximum height (default: 250)"
+    )
+    comp.add_argument(
+        "--dither-method",
+        choices=list(eink_dither.DITHER_METHODS),
+        default="ordered",
+        help="Dither method when eink_dither is available (default: ordered)",
+    )
+
+    ply = sub.add_parser("play", help="Play an animation file")
+    ply.add_argument("file", help="Animation file")
+    ply.add_argument(
+        "--loops", type=int, default=3, help="Number of loops (0 for infinite)"
+    )
+    ply.add_argument("--device", default="/dev/fb0", help="Framebuffer device path")
+
+    args = parser.parse_args()
+
+    if args.command == "compile":
+        from gif import load_gif_frames
+
+        frames, durations = load_gif_frames(args.input, args.width, args.height)
+        data = compile_frames(
+            frames, durations, eink_dither.DITHER_METHODS[args.dither_method]
+        )
+        with open(args.output, "wb") as f:
+            f.write(data)
+        print(f"{len(frames)} frames, {len(data):,} bytes written to {args.output}")
+        return
+
+    try:
+        with Animation(args.file) as anim, EInkDisplay(args.device) as display:
+            print(f"{anim.width}x{anim.height}, {len(anim.frames)} frames")
+            play(
+                display,
+                anim,
+                loops=args.loops,
+                on_frame=lambda i, loop: print(
+                    f"Frame {i + 1}/{len(anim.frames)} (loop {loop + 1})", end="\r"
+                ),
+            )
+            print()
+    except KeyboardInterrupt:
+        print("\nAnimation interrupted")
+    except (OSError, ValueError) as e:
+        print(f"Error: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,466 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * eink_bench.c - E-Ink display latency and throughput benchmark
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Measures update latency per mode (full, fast, base map, clear and
+ * partial at several area sizes), the sustained partial update rate,
+ * ioctl overhead and mmap write bandwidth, and prints the results as
+ * JSON so runs on different kernels, SPI clocks and driver versions can
+ * be compared.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <linux/fb.h>
+#include "pamir-ai-eink.h"
+
+#define BENCH_IOCTL_CALLS 10000
+#define BENCH_MMAP_BYTES (64 << 20)
+
+enum {
+	TEST_FULL = 1 << 0,
+	TEST_FAST = 1 << 1,
+	TEST_BASE_MAP = 1 << 2,
+	TEST_CLEAR = 1 << 3,
+	TEST_PARTIAL = 1 << 4,
+	TEST_RATE = 1 << 5,
+	TEST_IOCTL = 1 << 6,
+	TEST_MMAP = 1 << 7,
+	TEST_ALL = (1 << 8) - 1,
+};
+
+static const char *const test_names[] = {
+	"full", "fast", "base_map", "clear",
+	"partial", "rate", "ioctl", "mmap",
+};
+
+struct bench {
+	int fd;
+	uint8_t *fb;
+	size_t fb_size;
+	unsigned int width;
+	unsigned int height;
+	unsigned int line_length;
+	unsigned int iterations;
+	unsigned int rate_seconds;
+	unsigned int frame;
+	FILE *out;
+	int first;	/* No comma before the next JSON member */
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Alternate between two patterns so every update has something to do */
+static void draw_frame(struct bench *b, unsigned int x, unsigned int y,
+		       unsigned int w, unsigned int h)
+{
+	uint8_t value = b->frame++ & 1 ? 0x00 : 0xFF;
+	unsigned int row;
+
+	for (row = y; row < y + h; row++)
+		memset(b->fb + row * b->line_length + x / 8,
+		       row & 8 ? value : (uint8_t)~value, w / 8);
+}
+
+static void json_key(struct bench *b, const char *key)
+{
+	fprintf(b->out, "%s\n    \"%s\": ", b->first ? "" : ",", key);
+	b->first = 0;
+}
+
+static void json_stats(struct bench *b, double *ms, unsigned int n,
+		       const char *error)
+{
+	double sum = 0;
+	unsigned int i;
+
+	if (!n) {
+		fprintf(b->out, "{ \"error\": \"%s\" }", error);
+		return;
+	}
+
+	qsort(ms, n, sizeof(*ms), cmp_double);
+	for (i = 0; i < n; i++)
+		sum += ms[i];
+
+	fprintf(b->out,
+		"{ \"n\": %u, \"min\": %.2f, \"median\": %.2f, \"mean\": %.2f, \"p95\": %.2f, \"max\": %.2f }",
+		n, ms[0], ms[n / 2], sum / n, ms[(n * 95 - 1) / 100], ms[n - 1]);
+}
+
+static int set_mode(struct bench *b, int mode)
+{
+	return ioctl(b->fd, EPD_IOC_SET_UPDATE_MODE, &mode);
+}
+
+/* Time @iterations refreshes in @mode, or clears when @mode is negative */
+static void bench_latency(struct bench *b, const char *name, int mode)
+{
+	double *ms = calloc(b->iterations, sizeof(*ms));
+	const char *error = "out of memory";
+	unsigned int i, n = 0;
+
+	json_key(b, name);
+	if (!ms) {
+		json_stats(b, NULL, 0, error);
+		return;
+	}
+
+	if (mode >= 0 && set_mode(b, mode) < 0) {
+		error = strerror(errno);
+		goto out;
+	}
+
+	for (i = 0; i < b->iterations; i++) {
+		double start;
+		int ret;
+
+		draw_frame(b, 0, 0, b->width, b->height);
+		start = now_ms();
+		if (mode < 0)
+			ret = ioctl(b->fd, EPD_IOC_CLEAR_DISPLAY);
+		else
+			ret = ioctl(b->fd, EPD_IOC_UPDATE_DISPLAY);
+		if (ret < 0) {
+			error = strerror(errno);
+			break;
+		}
+		ms[n++] = now_ms() - start;
+	}
+
+out:
+	json_stats(b, ms, n, error);
+	free(ms);
+}
+
+static int set_area(struct bench *b, unsigned int w, unsigned int h)
+{
+	struct epd_update_area area = {
+		.x = 0,
+		.y = 0,
+		.width = w,
+		.height = h,
+	};
+
+	return ioctl(b->fd, EPD_IOC_SET_PARTIAL_AREA, &area);
+}
+
+/* Partial updates of the top-left 1/16, 1/4, 1/2 and all of the panel */
+static void bench_partial(struct bench *b)
+{
+	static const unsigned int percent[] = { 6, 25, 50, 100 };
+	double *ms = calloc(b->iterations, sizeof(*ms));
+	unsigned int i, j;
+	int first = 1;
+
+	json_key(b, "partial");
+	fprintf(b->out, "[");
+
+	for (i = 0; ms && i < sizeof(percent) / sizeof(percent[0]); i++) {
+		unsigned int w = b->width & ~7u;
+		unsigned int h = b->height * percent[i] / 100;
+		const char *error = NULL;
+		unsigned int n = 0;
+
+		/* Shrink the width first so rows stay contiguous for small areas */
+		if (percent[i] < 50) {
+			w = (b->width / 2) & ~7u;
+			h = b->height * percent[i] / 50;
+		}
+		if (!w || !h)
+			continue;
+
+		if (set_mode(b, EPD_MODE_PARTIAL) < 0 || set_area(b, w, h) < 0)
+			error = strerror(errno);
+
+		for (j = 0; !error && j < b->iterations; j++) {
+			double start;
+
+			draw_frame(b, 0, 0, w, h);
+			start = now_ms();
+			if (ioctl(b->fd, EPD_IOC_UPDATE_DISPLAY) < 0) {
+				error = strerror(errno);
+				break;
+			}
+			ms[n++] = now_ms() - start;
+		}
+
+		fprintf(b->out, "%s\n      { \"width\": %u, \"height\": %u, \"latency_ms\": ",
+			first ? "" : ",", w, h);
+		first = 0;
+		json_stats(b, ms, n, error ? error : "no updates");
+		fprintf(b->out, " }");
+	}
+
+	fprintf(b->out, "\n    ]");
+	free(ms);
+
+	/* Full mode also drops the partial area */
+	set_mode(b, EPD_MODE_FULL);
+}
+
+/* Back-to-back partial updates of a quarter of the panel */
+static void bench_rate(struct bench *b)
+{
+	unsigned int w = (b->width / 2) & ~7u, h = b->height / 2;
+	unsigned int frames = 0;
+	double start, elapsed;
+	int error = 0;
+
+	json_key(b, "partial_rate");
+	if (set_mode(b, EPD_MODE_PARTIAL) < 0 || set_area(b, w, h) < 0) {
+		fprintf(b->out, "{ \"error\": \"%s\" }", strerror(errno));
+		set_mode(b, EPD_MODE_FULL);
+		return;
+	}
+
+	start = now_ms();
+	do {
+		draw_frame(b, 0, 0, w, h);
+		if (ioctl(b->fd, EPD_IOC_UPDATE_DISPLAY) < 0) {
+			error = errno;
+			break;
+		}
+		frames++;
+		elapsed = now_ms() - start;
+	} while (elapsed < b->rate_seconds * 1e3);
+
+	elapsed = now_ms() - start;
+	if (!frames) {
+		fprintf(b->out, "{ \"error\": \"%s\" }", strerror(error));
+		set_mode(b, EPD_MODE_FULL);
+		return;
+	}
+
+	fprintf(b->out,
+		"{ \"width\": %u, \"height\": %u, \"seconds\": %.2f, \"frames\": %u, \"fps\": %.2f }",
+		w, h, elapsed / 1e3, frames, frames * 1e3 / elapsed);
+	set_mode(b, EPD_MODE_FULL);
+}
+
+/* Round trip of the cheapest ioctl, in microseconds */
+static void bench_ioctl(struct bench *b)
+{
+	double start, elapsed;
+	unsigned int i;
+	int mode;
+
+	json_key(b, "ioctl_us");
+	start = now_ms();
+	for (i = 0; i < BENCH_IOCTL_CALLS; i++) {
+		if (ioctl(b->fd, EPD_IOC_GET_UPDATE_MODE, &mode) < 0) {
+			fprintf(b->out, "{ \"error\": \"%s\" }",
+				strerror(errno));
+			return;
+		}
+	}
+	elapsed = now_ms() - start;
+
+	fprintf(b->out, "{ \"calls\": %u, \"mean\": %.3f }",
+		BENCH_IOCTL_CALLS, elapsed * 1e3 / BENCH_IOCTL_CALLS);
+}
+
+/* Whole-frame stores into the mapping, without refreshing */
+static void bench_mmap(struct bench *b)
+{
+	size_t frame = (size_t)b->line_length * b->height;
+	size_t total = 0;
+	uint8_t *src = malloc(frame);
+	double start, elapsed;
+
+	json_key(b, "mmap_write");
+	if (!src) {
+		fprintf(b->out, "{ \"error\": \"out of memory\" }");
+		return;
+	}
+	memset(src, 0x55, frame);
+
+	start = now_ms();
+	while (total < BENCH_MMAP_BYTES) {
+		memcpy(b->fb, src, frame);
+		total += frame;
+	}
+	elapsed = now_ms() - start;
+
+	fprintf(b->out, "{ \"bytes\": %zu, \"mb_per_s\": %.1f }", total,
+		total / (elapsed / 1e3) / (1 << 20));
+	free(src);
+}
+
+static unsigned int parse_tests(const char *list)
+{
+	char *copy = strdup(list), *tok, *save = NULL;
+	unsigned int tests = 0, i;
+
+	for (tok = strtok_r(copy, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < sizeof(test_names) / sizeof(test_names[0]); i++) {
+			if (!strcmp(tok, test_names[i]))
+				break;
+		}
+		if (i == sizeof(test_names) / sizeof(test_names[0])) {
+			fprintf(stderr, "Unknown test '%s'\n", tok);
+			tests = 0;
+			break;
+		}
+		tests |= 1 << i;
+	}
+
+	free(copy);
+	return tests;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEVICE  framebuffer device (default /dev/fb0)\n"
+		"  -n COUNT   refreshes per latency test (default 5)\n"
+		"  -r SECS    duration of the partial rate test (default 10)\n"
+		"  -t TESTS   comma separated subset of: full, fast, base_map,\n"
+		"             clear, partial, rate, ioctl, mmap (default all)\n"
+		"  -o FILE    write the JSON there instead of stdout\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fb_var_screeninfo vinfo;
+	struct fb_fix_screeninfo finfo;
+	const char *device = "/dev/fb0";
+	const char *output = NULL;
+	unsigned int tests = TEST_ALL;
+	struct bench b = {
+		.iterations = 5,
+		.rate_seconds = 10,
+		.first = 1,
+	};
+	struct utsname uts;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:n:r:t:o:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'n':
+			b.iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			b.rate_seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			tests = parse_tests(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!b.iterations || !tests) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	b.fd = open(device, O_RDWR);
+	if (b.fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	if (ioctl(b.fd, FBIOGET_VSCREENINFO, &vinfo) < 0 ||
+	    ioctl(b.fd, FBIOGET_FSCREENINFO, &finfo) < 0) {
+		perror("FBIOGET_SCREENINFO");
+		close(b.fd);
+		return 1;
+	}
+
+	b.width = vinfo.xres;
+	b.height = vinfo.yres;
+	b.line_length = finfo.line_length;
+	b.fb_size = finfo.smem_len;
+	b.fb = mmap(NULL, b.fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, b.fd,
+		    0);
+	if (b.fb == MAP_FAILED) {
+		perror("mmap");
+		close(b.fd);
+		return 1;
+	}
+
+	b.out = output ? fopen(output, "w") : stdout;
+	if (!b.out) {
+		perror(output);
+		munmap(b.fb, b.fb_size);
+		close(b.fd);
+		return 1;
+	}
+
+	if (uname(&uts) < 0)
+		memset(&uts, 0, sizeof(uts));
+
+	fprintf(b.out, "{\n  \"device\": \"%s\",\n  \"id\": \"%.16s\",\n",
+		device, finfo.id);
+	fprintf(b.out, "  \"kernel\": \"%s\",\n  \"machine\": \"%s\",\n",
+		uts.release, uts.machine);
+	fprintf(b.out, "  \"width\": %u,\n  \"height\": %u,\n", b.width,
+		b.height);
+	fprintf(b.out, "  \"iterations\": %u,\n  \"results\": {", b.iterations);
+
+	if (tests & TEST_FULL)
+		bench_latency(&b, "full", EPD_MODE_FULL);
+	if (tests & TEST_FAST)
+		bench_latency(&b, "fast", EPD_MODE_FAST);
+	if (tests & TEST_BASE_MAP)
+		bench_latency(&b, "base_map", EPD_MODE_BASE_MAP);
+	if (tests & TEST_CLEAR)
+		bench_latency(&b, "clear", -1);
+	if (tests & TEST_PARTIAL)
+		bench_partial(&b);
+	if (tests & TEST_RATE)
+		bench_rate(&b);
+	if (tests & TEST_IOCTL)
+		bench_ioctl(&b);
+	if (tests & TEST_MMAP)
+		bench_mmap(&b);
+
+	fprintf(b.out, "\n  }\n}\n");
+
+	/* Leave the panel in a known state */
+	set_mode(&b, EPD_MODE_FULL);
+	memset(b.fb, 0xFF, b.fb_size);
+	ioctl(b.fd, EPD_IOC_CLEAR_DISPLAY);
+
+	if (b.out != stdout)
+		fclose(b.out);
+	munmap(b.fb, b.fb_size);
+	close(b.fd);
+	return 0;
+}
@@ -9,13 +9,17 @@ This module contains:
 1. All IOCTL definitions extracted from pamir-ai-eink.h
 2. Common framebuffer helper functions
 3. Display dimensions constants
-4. EInkDisplay class with all common functionality
+4. EInkDisplay class with all common functionality, including a numpy
+   view of the framebuffer and damage tracking for partial updates
 """
 
+import math
 import mmap
 import fcntl
 import struct
-from PIL import Image
+from collections import OrderedDict
+import numpy as np
+from PIL import Image, ImageDraw, ImageFont
 
 # Display dimensions constants
 EINK_DEFAULT_WIDTH = 128
@@ -56,11 +60,16 @@ EPD_IOC_DEEP_SLEEP = _IO(EPD_IOC_MAGIC, 5)  # _IO('E', 5)
 EPD_IOC_SET_BASE_MAP = _IOW(EPD_IOC_MAGIC, 6, 8)  # _IOW('E', 6, void *)
 EPD_IOC_RESET = _IO(EPD_IOC_MAGIC, 7)  # _IO('E', 7)
 EPD_IOC_CLEAR_DISPLAY = _IO(EPD_IOC_MAGIC, 8)  # _IO('E', 8)
+EPD_IOC_GROUP_UPDATE = _IO(EPD_IOC_MAGIC, 9)  # _IO('E', 9)
 
 # Display update modes from pamir-ai-eink.h
 EPD_MODE_FULL = 0  # Full refresh, 2-4 seconds
 EPD_MODE_PARTIAL = 1  # Fast partial, ~500ms
 EPD_MODE_BASE_MAP = 2  # Dual-buffer mode
+EPD_MODE_FAST = 3  # Shorter full-screen waveform where the controller has one
+
+# Coordinates taking the single-pixel paths
+_SCALARS = (int, np.integer)
 
 
 class EInkDisplay:
@@ -82,6 +91,8 @@ class EInkDisplay:
         self.width = EINK_DEFAULT_WIDTH
         self.height = EINK_DEFAULT_HEIGHT
         self.bytes_per_line = 0
+        self._fb = None
+        self._damage = None
 
         self._open_framebuffer()
 
@@ -112,14 +123,23 @@ class EInkDisplay:
 
         # Memory map the framebuffer
         self.fb_mmap = mmap.mmap(
-            self.fb_file.fileno(), fb_size, mmap.MAP_SHARED, mmap.PROT_WRITE
+            self.fb_file.fileno(),
+            fb_size,
+            mmap.MAP_SHARED,
+            mmap.PROT_READ | mmap.PROT_WRITE,
+        )
+
+        # Rows of packed bytes over the mapping, shared with the driver
+        self._fb = np.frombuffer(self.fb_mmap, dtype=np.uint8).reshape(
+            self.height, self.bytes_per_line
         )
 
     def set_update_mode(self, mode):
         """Set the display update mode.
 
         Args:
-            mode: EPD_MODE_FULL, EPD_MODE_PARTIAL, or EPD_MODE_BASE_MAP
+            mode: EPD_MODE_FULL, EPD_MODE_PARTIAL, EPD_MODE_BASE_MAP or
+                EPD_MODE_FAST
         """
         mode_bytes = struct.pack("i", mode)
         fcntl.ioctl(self.fb_file, EPD_IOC_SET_UPDATE_MODE, mode_bytes)
@@ -160,6 +180,69 @@ class EInkDisplay:
     def update_display(self):
         """Trigger a display update."""
         fcntl.ioctl(self.fb_file, EPD_IOC_UPDATE_DISPLAY)
+        self._damage = None
+
+    @property
+    def buffer(self):
+        """The framebuffer as a (height, bytes_per_line) uint8 array.
+
+        This is a view of the mapping, not a copy: writing to it changes
+        the framebuffer directly. Pixels are packed MSB first and a set
+        bit is white. Report direct writes with add_damage() so
+        update_damage() refreshes them.
+        """
+        return self._fb
+
+    @property
+    def damage(self):
+        """Area drawn since the last update as (x, y, width, height), or None."""
+        if self._damage is None:
+            return None
+        x0, y0, x1, y1 = self._damage
+        return (x0, y0, x1 - x0, y1 - y0)
+
+    def add_damage(self, x, y, width, height):
+        """Mark an area as changed. It is clipped to the display."""
+        x0, y0 = max(0, x), max(0, y)
+        x1 = min(self.width, x + width)
+        y1 = min(self.height, y + height)
+        if x0 >= x1 or y0 >= y1:
+            return
+        if self._damage is not None:
+            dx0, dy0, dx1, dy1 = self._damage
+            x0, y0 = min(x0, dx0), min(y0, dy0)
+            x1, y1 = max(x1, dx1), max(y1, dy1)
+        self._damage = (x0, y0, x1, y1)
+
+    def clear_damage(self):
+        """Forget the damage without refreshing."""
+        self._damage = None
+
+    def update_damage(self):
+        """Refresh only the area drawn since the last update.
+
+        The area is widened to whole bytes for the driver and refreshed
+        in the current update mode. Does nothing when nothing was drawn.
+
+        Returns:
+            bool: True if an update was sent
+        """
+        if self._damage is None:
+            return False
+
+        x0, y0, x1, y1 = self._damage
+        x0 = x0 // 8 * 8
+        x1 = min((x1 + 7) // 8 * 8, self.width // 8 * 8)
+        self.set_partial_area(x0, y0, max(8, x1 - x0), y1 - y0)
+        self.update_display()
+        return True
+
+    def group_update(self):
+        """Refresh every panel in this display's group concurrently.
+
+        Behaves like update_display() for panels that are not grouped.
+        """
+        fcntl.ioctl(self.fb_file, EPD_IOC_GROUP_UPDATE)
 
     def deep_sleep(self):
         """Enter deep sleep mode."""
@@ -196,6 +279,11 @@ class EInkDisplay:
     def draw_image(self, image, x=0, y=0):
         """Draw a PIL Image to the display.
 
+        The image is packed to 1bpp in one step and written a block of
+        rows at a time. An x that is not a multiple of 8 is handled by
+        shifting the packed rows, and only the edge bytes are merged with
+        what is already on screen.
+
         Args:
             image: PIL Image object (will be converted to 1-bit)
             x: X position on display
@@ -205,32 +293,126 @@ class EInkDisplay:
         if image.mode != "1":
             image = image.convert("1")
 
-        # Get pixels
-        pixels = image.load()
+        # Clip to the display
         width, height = image.size
+        if x + width <= 0 or y + height <= 0:
+            return
+        if x < 0 or y < 0:
+            image = image.crop((max(0, -x), max(0, -y), width, height))
+            x, y = max(0, x), max(0, y)
+            width, height = image.size
+        width = min(width, self.width - x)
+        height = min(height, self.height - y)
+        if width <= 0 or height <= 0:
+            return
+        if (width, height) != image.size:
+            image = image.crop((0, 0, width, height))
+
+        # Mode "1" packs MSB first with 1 = white, as the framebuffer does
+        src = np.frombuffer(image.tobytes(), dtype=np.uint8).reshape(
+            height, (width + 7) // 8
+        )
+        self._blit_packed(src, x, y, width)
+
+    def _blit_packed(self, src, x, y, width):
+        """Copy packed rows to the framebuffer at any x.
+
+        Args:
+            src: uint8 array of packed rows, MSB first
+            x: X position on display
+            y: Y position on display
+            width: Pixels per row to copy
+        """
+        shift = x & 7
+        first, last, mask = self._span_mask(x, width)
+        nbytes = last - first + 1
+
+        if shift:
+            rows = np.zeros((src.shape[0], nbytes), dtype=np.uint8)
+            n = min(src.shape[1], nbytes)
+            rows[:, :n] = src[:, :n] >> shift
+            n = min(src.shape[1], nbytes - 1)
+            rows[:, 1 : n + 1] |= (src[:, :n] << (8 - shift)).astype(np.uint8)
+        else:
+            rows = src[:, :nbytes]
+
+        # The edge masks keep the pixels left and right of the image
+        dst = self._fb[y : y + src.shape[0], first : last + 1]
+        dst[:] = (dst & ~mask) | (rows & mask)
+        self.add_damage(x, y, width, src.shape[0])
+
+    def _span_mask(self, x, width):
+        """Byte range and per-byte masks covering pixels [x, x + width)."""
+        first = x >> 3
+        last = (x + width - 1) >> 3
+        mask = np.full(last - first + 1, 0xFF, dtype=np.uint8)
+        mask[0] &= 0xFF >> (x & 7)
+        mask[-1] &= (0xFF << (7 - ((x + width - 1) & 7))) & 0xFF
+        return first, last, mask
+
+    def _fill(self, x, y, width, height, color):
+        """Fill a clipped rectangle, color 0 for black, nonzero for white."""
+        x0, y0 = max(0, x), max(0, y)
+        x1 = min(self.width, x + width)
+        y1 = min(self.height, y + height)
+        if x0 >= x1 or y0 >= y1:
+            return
+
+        first, last, mask = self._span_mask(x0, x1 - x0)
+        dst = self._fb[y0:y1, first : last + 1]
+        if color:
+            dst |= mask
+        else:
+            dst &= ~mask
+        self.add_damage(x0, y0, x1 - x0, y1 - y0)
+
+    def get_pixels(self, x=0, y=0, width=None, height=None):
+        """Unpack an area of the framebuffer.
+
+        Args:
+            x: X coordinate of the area
+            y: Y coordinate of the area
+            width: Area width (default: to the right edge)
+            height: Area height (default: to the bottom edge)
+
+        Returns:
+            numpy.ndarray: (height, width) bool array, True for white.
+            This is a copy; write it back with set_pixels().
+        """
+        if width is None:
+            width = self.width - x
+        if height is None:
+            height = self.height - y
+        x0, y0 = max(0, x), max(0, y)
+        x1 = min(self.width, x + width)
+        y1 = min(self.height, y + height)
+        if x0 >= x1 or y0 >= y1:
+            return np.zeros((0, 0), dtype=bool)
+
+        first, last = x0 >> 3, (x1 - 1) >> 3
+        bits = np.unpackbits(self._fb[y0:y1, first : last + 1], axis=1)
+        start = x0 & 7
+        return bits[:, start : start + x1 - x0].astype(bool)
+
+    def set_pixels(self, pixels, x=0, y=0):
+        """Write a bool array to the framebuffer.
 
-        # Draw to framebuffer
-        for py in range(min(height, self.height - y)):
-            for px in range(min(width, self.width - x)):
-                # Calculate position in framebuffer
-                fb_x = x + px
-                fb_y = y + py
-                byte_idx = fb_y * self.bytes_per_line + (fb_x // 8)
-                bit_idx = 7 - (fb_x % 8)
-
-                # Read current byte
-                self.fb_mmap.seek(byte_idx)
-                current = ord(self.fb_mmap.read(1))
-
-                # Update bit
-                if pixels[px, py] == 0:  # Black pixel
-                    current &= ~(1 << bit_idx)
-                else:  # White pixel
-                    current |= 1 << bit_idx
-
-                # Write back
-                self.fb_mmap.seek(byte_idx)
-                self.fb_mmap.write(bytes([current]))
+        Args:
+            pixels: 2D array, True (or nonzero) for white
+            x: X position on display
+            y: Y position on display
+        """
+        pixels = np.asarray(pixels)
+        height, width = pixels.shape
+        left, top = max(0, -x), max(0, -y)
+        width = min(width, self.width - x)
+        height = min(height, self.height - y)
+        if width <= left or height <= top:
+            return
+
+        pixels = pixels[top:height, left:width]
+        src = np.packbits(pixels.astype(bool), axis=1)
+        self._blit_packed(src, max(0, x), max(0, y), width - left)
 
     def clear(self, color=255):
         """Clear the display.
@@ -238,64 +420,87 @@ class EInkDisplay:
         Args:
             color: 0 for black, 255 for white
         """
-        fill_byte = 0xFF if color else 0x00
-        self.fb_mmap.seek(0)
-        self.fb_mmap.write(bytes([fill_byte]) * len(self.fb_mmap))
+        self._fb[:] = 0xFF if color else 0x00
+        self.add_damage(0, 0, self.width, self.height)
 
     def draw_pixel(self, x, y, color=0):
-        """Draw a single pixel.
+        """Draw one pixel, or many at once.
 
         Args:
-            x: X coordinate
-            y: Y coordinate
+            x: X coordinate, or an array of them
+            y: Y coordinate, or an array of them
             color: 0 for black, 1 for white
         """
-        if x < 0 or x >= self.width or y < 0 or y >= self.height:
+        if isinstance(x, _SCALARS) and isinstance(y, _SCALARS):
+            if x < 0 or x >= self.width or y < 0 or y >= self.height:
+                return
+            # Indexing the mmap is cheaper than numpy for a single byte
+            byte_idx = y * self.bytes_per_line + (x >> 3)
+            bit = 0x80 >> (x & 7)
+            if color == 0:  # Black pixel
+                self.fb_mmap[byte_idx] &= ~bit & 0xFF
+            else:  # White pixel
+                self.fb_mmap[byte_idx] |= bit
+
+            damage = self._damage
+            if damage is None:
+                self._damage = (x, y, x + 1, y + 1)
+            elif not (damage[0] <= x < damage[2] and damage[1] <= y < damage[3]):
+                self.add_damage(x, y, 1, 1)
             return
 
-        byte_idx = y * self.bytes_per_line + (x // 8)
-        bit_idx = 7 - (x % 8)
-
-        # Read current byte
-        self.fb_mmap.seek(byte_idx)
-        current = ord(self.fb_mmap.read(1))
-
-        # Update bit
-        if color == 0:  # Black pixel
-            current &= ~(1 << bit_idx)
-        else:  # White pixel
-            current |= 1 << bit_idx
+        x, y = np.broadcast_arrays(np.asarray(x), np.asarray(y))
+        keep = (x >= 0) & (x < self.width) & (y >= 0) & (y < self.height)
+        x, y = x[keep], y[keep]
+        if not x.size:
+            return
 
-        # Write back
-        self.fb_mmap.seek(byte_idx)
-        self.fb_mmap.write(bytes([current]))
+        flat = y * self.bytes_per_line + (x >> 3)
+        bits = (0x80 >> (x & 7)).astype(np.uint8)
+        fb = self._fb.reshape(-1)
+        # ufunc.at applies every pixel even when several share a byte
+        if color == 0:
+            np.bitwise_and.at(fb, flat, ~bits)
+        else:
+            np.bitwise_or.at(fb, flat, bits)
+        self.add_damage(
+            int(x.min()),
+            int(y.min()),
+            int(x.max() - x.min()) + 1,
+            int(y.max() - y.min()) + 1,
+        )
 
     def get_pixel(self, x, y):
-        """Get the color of a pixel.
+        """Get the color of a pixel, or of many at once.
 
         Args:
-            x: X coordinate
-            y: Y coordinate
+            x: X coordinate, or an array of them
+            y: Y coordinate, or an array of them
 
         Returns:
-            int: 0 for black, 1 for white, or None if coordinates are invalid
+            int: 0 for black, 1 for white, or None if coordinates are
+            invalid. For arrays, an int array with -1 for invalid
+            coordinates.
         """
-        if x < 0 or x >= self.width or y < 0 or y >= self.height:
-            return None
-
-        byte_idx = y * self.bytes_per_line + (x // 8)
-        bit_idx = 7 - (x % 8)
-
-        # Read byte
-        self.fb_mmap.seek(byte_idx)
-        current = ord(self.fb_mmap.read(1))
-
-        # Extract bit
-        return 1 if (current & (1 << bit_idx)) else 0
+        if isinstance(x, _SCALARS) and isinstance(y, _SCALARS):
+            if x < 0 or x >= self.width or y < 0 or y >= self.height:
+                return None
+            byte_idx = y * self.bytes_per_line + (x >> 3)
+            return 1 if self.fb_mmap[byte_idx] & (0x80 >> (x & 7)) else 0
+
+        x, y = np.broadcast_arrays(np.asarray(x), np.asarray(y))
+        keep = (x >= 0) & (x < self.width) & (y >= 0) & (y < self.height)
+        result = np.full(x.shape, -1, dtype=np.int8)
+        xs, ys = x[keep], y[keep]
+        result[keep] = (self._fb[ys, xs >> 3] >> (7 - (xs & 7))) & 1
+        return result
 
     def draw_rectangle(self, x, y, width, height, fill=None, outline=None):
         """Draw a rectangle.
 
+        The inside is painted white when no fill is given, as if the
+        rectangle were an image.
+
         Args:
             x: X coordinate of top-left corner
             y: Y coordinate of top-left corner
@@ -304,43 +509,46 @@ class EInkDisplay:
             fill: Fill color (0 for black, 1 for white)
             outline: Outline color (0 for black, 1 for white)
         """
-        # Create a temporary image for the rectangle
-        img = Image.new("1", (width, height), 1)
-        from PIL import ImageDraw
-
-        draw = ImageDraw.Draw(img)
+        if width <= 0 or height <= 0:
+            return
 
-        if fill is not None:
-            draw.rectangle([(0, 0), (width - 1, height - 1)], fill=fill)
+        self._fill(x, y, width, height, 1 if fill is None else fill)
         if outline is not None:
-            draw.rectangle([(0, 0), (width - 1, height - 1)], outline=outline)
+            self._fill(x, y, width, 1, outline)
+            self._fill(x, y + height - 1, width, 1, outline)
+            self._fill(x, y, 1, height, outline)
+            self._fill(x + width - 1, y, 1, height, outline)
 
-        self.draw_image(img, x, y)
+    def draw_text(self, x, y, text, color=0, font=None):
+        """Draw one line of text on a box of the opposite colour.
 
-    def draw_text(self, x, y, text, color=0):
-        """Draw text at the specified position.
+        Glyphs come from the font's GlyphAtlas, rasterized once, so
+        drawing text again only composes and copies bits.
 
         Args:
             x: X coordinate
             y: Y coordinate
             text: Text to draw
             color: Text color (0 for black, 1 for white)
+            font: PIL font, the default font if None
 
-        Note: This is a basic implementation. For better text rendering,
-        create a PIL Image with text and use draw_image().
+        Returns:
+            int: Width of the text in pixels
         """
-        # Create a temporary image for the text
-        from PIL import ImageDraw
-
-        # Estimate text size (this is approximate)
-        text_width = len(text) * 6  # Approximate character width
-        text_height = 12  # Approximate character height
+        ink = GlyphAtlas.for_font(font).render(text)
+        height, width = ink.shape
 
-        img = Image.new("1", (text_width, text_height), 1)
-        draw = ImageDraw.Draw(img)
-        draw.text((0, 0), text, fill=color)
+        # Clip to the display
+        x0, y0 = max(0, -x), max(0, -y)
+        x1 = min(width, self.width - x)
+        y1 = min(height, self.height - y)
+        if x0 >= x1 or y0 >= y1:
+            return width
 
-        self.draw_image(img, x, y)
+        ink = ink[y0:y1, x0:x1]
+        src = np.packbits(ink if color else ~ink, axis=1)
+        self._blit_packed(src, x + x0, y + y0, x1 - x0)
+        return width
 
     def close(self, clear_on_exit=True):
         """Close the framebuffer device and clean up resources.
@@ -354,6 +562,8 @@ class EInkDisplay:
             except Exception:
                 pass  # Ignore errors on cleanup
 
+        # The mapping cannot be closed while an array still refers to it
+        self._fb = None
         if self.fb_mmap:
             self.fb_mmap.close()
             self.fb_mmap = None
@@ -373,6 +583,135 @@ class EInkDisplay:
 # Common helper functions
 
 
+def _pixel(x):
+    """Round a pen position to a pixel the way PIL does, halves up."""
+    return math.floor(x + 0.5)
+
+
+class GlyphAtlas:
+    """The glyphs of one font, rasterized to 1bpp once.
+
+    Each glyph is drawn by PIL the first time it is used and kept as an
+    ink mask, and so is the distance between each pair of characters, which
+    includes their kerning. A line of text is put together from those, and
+    the most recently drawn lines are kept whole as well. For FreeType
+    fonts, which includes the default font since Pillow 10.1, the result
+    is the same as PIL's; mismatch() checks that. In a bitmap font whose
+    glyph cells overlap, PIL lets a glyph's blank cell erase its
+    neighbour's ink, which the atlas keeps.
+    """
+
+    _atlases = {}
+
+    # Lines of text kept composed
+    LINE_CACHE = 64
+
+    def __init__(self, font=None):
+        self.font = font if font is not None else ImageFont.load_default()
+        if hasattr(self.font, "getmetrics"):
+            ascent, descent = self.font.getmetrics()
+            self.height = ascent + descent
+        else:
+            self.height = self.font.getbbox("Ag|")[3]
+        self._glyphs = {}
+        self._pairs = {}
+        self._lines = OrderedDict()
+
+    @classmethod
+    def for_font(cls, font=None):
+        """Return the shared atlas of a font, creating it on first use."""
+        atlas = cls._atlases.get(font)
+        if atlas is None:
+            atlas = cls._atlases[font] = cls(font)
+        return atlas
+
+    def _length(self, text):
+        # Hinting for mode "1" changes the advances
+        return self.font.getlength(text, mode="1")
+
+    def glyph(self, char):
+        """Return (ink mask, x offset of the mask, line offset) of a character.
+
+        The x offset is negative when ink starts left of the pen position.
+        PIL places a glyph differently at the start of a line, where its
+        ink may pull the whole line left; the line offset is that shift.
+        """
+        glyph = self._glyphs.get(char)
+        if glyph is None:
+            # Drawn after a space to get its placement inside a line, with
+            # room to spare on both sides since getbbox() can fall short
+            pad = self.height
+            pen = pad + _pixel(self._length(" " + char) - self._length(char))
+            width = max(_pixel(self._length(char)), 1)
+            mask = self._draw(" " + char, pad, pen + width + pad)
+            cols = np.flatnonzero(mask.any(axis=0))
+            x0 = min(pen, int(cols[0])) if cols.size else pen
+            x1 = max(pen + width, int(cols[-1]) + 1) if cols.size else pen + width
+
+            lead = 0
+            alone = np.flatnonzero(self._draw(char, pad, width + 2 * pad).any(axis=0))
+            if cols.size and alone.size:
+                lead = min(0, (int(alone[0]) - pad) - (int(cols[0]) - pen))
+            glyph = self._glyphs[char] = (mask[:, x0:x1], x0 - pen, lead)
+        return glyph
+
+    def _draw(self, text, x, width):
+        img = Image.new("1", (width, self.height), 0)
+        ImageDraw.Draw(img).text((x, 0), text, font=self.font, fill=1)
+        return np.array(img, dtype=bool)
+
+    def advance(self, prev, char):
+        """Distance from the start of prev to the start of char after it."""
+        pair = prev + char
+        advance = self._pairs.get(pair)
+        if advance is None:
+            advance = self._length(pair) - self._length(char)
+            self._pairs[pair] = advance
+        return advance
+
+    def render(self, text):
+        """Return the ink mask of a line of text, height x width bools."""
+        ink = self._lines.get(text)
+        if ink is not None:
+            self._lines.move_to_end(text)
+            return ink
+
+        # Advances are exact in FreeType's 1/64 pixel units; like PIL,
+        # sum them and round each pen position, not each advance
+        pen = 0.0
+        lead = self.glyph(text[0])[2] if text else 0
+        placed = []
+        for i, char in enumerate(text):
+            if i:
+                pen += self.advance(text[i - 1], char)
+            mask, offset, _ = self.glyph(char)
+            placed.append((_pixel(pen) + offset + lead, mask))
+        if text:
+            pen += self._length(text[-1])
+        width = max([_pixel(pen)] + [x + m.shape[1] for x, m in placed])
+
+        # Ink left of the first pen position is cut off, as PIL does
+        ink = np.zeros((self.height, width), dtype=bool)
+        for x, mask in placed:
+            if x < 0:
+                mask = mask[:, -x:]
+                x = 0
+            ink[:, x : x + mask.shape[1]] |= mask
+
+        self._lines[text] = ink
+        while len(self._lines) > self.LINE_CACHE:
+            self._lines.popitem(last=False)
+        return ink
+
+    def mismatch(self, text):
+        """Count the pixels where render() differs from ImageDraw.text()."""
+        ink = self.render(text)
+        ref = self._draw(text, 0, ink.shape[1] + self.height)
+        return int(np.count_nonzero(ref[:, : ink.shape[1]] != ink)) + int(
+            np.count_nonzero(ref[:, ink.shape[1] :])
+        )
+
+
 def validate_byte_alignment(x, width):
     """Validate that coordinates are byte-aligned for partial updates.
 
@@ -526,3 +865,22 @@ class EInkAlignmentError(EInkError):
     """Exception for byte alignment errors."""
 
     pass
+
+
+if __name__ == "__main__":
+    # Check the glyph atlas against PIL for the default font
+    import sys
+
+    atlas = GlyphAtlas()
+    samples = [
+        "Page 12/345",
+        "The quick brown fox jumps over the lazy dog",
+        "AVAWAy Te, fi. 0123456789",
+        "Wi-Fi: 72% | 12:34:56",
+    ]
+    failed = 0
+    for sample in samples:
+        wrong = atlas.mismatch(sample)
+        print(f"{'FAIL' if wrong else 'ok':4} {sample!r}: {wrong} pixels differ")
+        failed += bool(wrong)
+    sys.exit(1 if failed else 0)
@@ -13,6 +13,7 @@
 #include <unistd.h>
 #include <linux/fb.h>
 #include "pamir-ai-eink.h"
+#include "libeink.h"
 
 /* Simple font - 8x8 bitmap for characters */
 static const unsigned char font8x8_basic[128][8] = {
@@ -23,55 +24,28 @@ static const unsigned char font8x8_basic[128][8] = {
 	['O'] = { 0x7E, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x7E },
 };
 
-static void draw_char(unsigned char *fb, int fb_width, int x, int y, char c)
-{
-	int i, j;
-	const unsigned char *glyph = font8x8_basic[(int)c];
-
-	for (i = 0; i < 8; i++) {
-		for (j = 0; j < 8; j++) {
-			int px = x + j;
-			int py = y + i;
-			int byte_offset = py * (fb_width / 8) + (px / 8);
-			int bit_offset = 7 - (px % 8);
-
-			if (glyph[i] & (1 << (7 - j))) {
-				/* Black pixel */
-				fb[byte_offset] &= ~(1 << bit_offset);
-			}
-		}
-	}
-}
+static const struct eink_font font8x8 = {
+	.width = 8,
+	.height = 8,
+	.advance = 8,
+	.first = 0,
+	.last = 127,
+	.glyphs = &font8x8_basic[0][0],
+};
 
-static void draw_string(unsigned char *fb, int fb_width, int x, int y,
+static void draw_string(struct eink_surface *fb, int x, int y,
 			const char *str)
 {
-	int i;
-	for (i = 0; str[i]; i++) {
-		draw_char(fb, fb_width, x + i * 8, y, str[i]);
-	}
+	eink_text(fb, &font8x8, x, y, 1, str, EINK_BLACK);
 }
 
-static void draw_rectangle(unsigned char *fb, int fb_width, int x, int y,
-			   int width, int height, int filled)
+static void draw_rectangle(struct eink_surface *fb, int x, int y, int width,
+			   int height, int filled)
 {
-	int i, j;
-
-	for (i = 0; i < height; i++) {
-		for (j = 0; j < width; j++) {
-			if (filled || i == 0 || i == height - 1 || j == 0 ||
-			    j == width - 1) {
-				int px = x + j;
-				int py = y + i;
-				int byte_offset =
-					py * (fb_width / 8) + (px / 8);
-				int bit_offset = 7 - (px % 8);
-
-				/* Black pixel */
-				fb[byte_offset] &= ~(1 << bit_offset);
-			}
-		}
-	}
+	if (filled)
+		eink_fill_rect(fb, x, y, width, height, EINK_BLACK);
+	else
+		eink_rect(fb, x, y, width, height, EINK_BLACK);
 }
 
 int main(int argc, char *argv[])
@@ -79,11 +53,11 @@ int main(int argc, char *argv[])
 	struct fb_var_screeninfo vinfo;
 	struct fb_fix_screeninfo finfo;
 	struct epd_update_area area;
+	struct eink_surface fb;
 	unsigned char *fbp;
 	size_t screensize;
 	int fbfd;
 	int mode;
-	int ret;
 
 	fbfd = open("/dev/fb0", O_RDWR);
 	if (fbfd < 0) {
@@ -116,6 +90,7 @@ int main(int argc, char *argv[])
 		close(fbfd);
 		return 1;
 	}
+	eink_surface_init(&fb, fbp, vinfo.xres, vinfo.yres, finfo.line_length);
 
 	printf("\n=== Demo 1: Full Update Mode ===\n");
 
@@ -126,11 +101,12 @@ int main(int argc, char *argv[])
 	}
 
 	memset(fbp, 0xFF, screensize);
-	draw_rectangle(fbp, vinfo.xres, 2, 2, vinfo.xres - 4, vinfo.yres - 4,
-		       0);
-	draw_string(fbp, vinfo.xres, 10, 10, "HELLO E-INK");
-	draw_rectangle(fbp, vinfo.xres, 10, 30, 50, 30, 1);
-	draw_rectangle(fbp, vinfo.xres, 70, 30, 50, 30, 0);
+	draw_rectangle(&fb, 2, 2, vinfo.xres - 4, vinfo.yres - 4, 0);
+	draw_string(&fb, 10, 10, "HELLO E-INK");
+	draw_rectangle(&fb, 10, 30, 50, 30, 1);
+	draw_rectangle(&fb, 70, 30, 50, 30, 0);
+	eink_line(&fb, 70, 30, 119, 59, EINK_BLACK);
+	eink_line(&fb, 119, 30, 70, 59, EINK_BLACK);
 
 	if (ioctl(fbfd, EPD_IOC_UPDATE_DISPLAY) < 0) {
 		perror("EPD_IOC_UPDATE_DISPLAY");
@@ -157,7 +133,7 @@ int main(int argc, char *argv[])
 		goto cleanup;
 	}
 
-	draw_rectangle(fbp, vinfo.xres, 42, 32, 76, 36, 1);
+	draw_rectangle(&fb, 42, 32, 76, 36, 1);
 
 	if (ioctl(fbfd, EPD_IOC_UPDATE_DISPLAY) < 0) {
 		perror("EPD_IOC_UPDATE_DISPLAY partial");
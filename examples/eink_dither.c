@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * eink_dither.c - Greyscale to 1bpp conversion for the e-ink framebuffer
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Threshold, ordered and noise dithering compare each row against a row
+ * of thresholds, 16 pixels at a time with SSE2 or NEON, and pack the
+ * result straight into framebuffer bytes. Error diffusion is serial by
+ * nature, so it runs in integer arithmetic without SIMD.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define EINK_DITHER_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define EINK_DITHER_NEON 1
+#endif
+
+#include "eink_dither.h"
+
+/* 8x8 Bayer matrix, 0..63 */
+static const uint8_t bayer8[8][8] = {
+	{ 0, 32, 8, 40, 2, 34, 10, 42 },  { 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44, 4, 36, 14, 46, 6, 38 }, { 60, 28, 52, 20, 62, 30, 54, 22 },
+	{ 3, 35, 11, 43, 1, 33, 9, 41 },  { 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47, 7, 39, 13, 45, 5, 37 }, { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+static inline uint8_t eink_clamp8(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+#if defined(EINK_DITHER_SSE2)
+/* movemask gives pixel 0 in bit 0, the framebuffer wants it in bit 7 */
+static uint8_t bitrev8(uint8_t b)
+{
+	b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+	b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+	b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+	return b;
+}
+#endif
+
+/* Pack one row: a pixel is white when grey > thr */
+static void eink_pack_row(const uint8_t *grey, const uint8_t *thr, int width,
+			  uint8_t *out)
+{
+	int x = 0;
+
+#if defined(EINK_DITHER_SSE2)
+	for (; x + 16 <= width; x += 16) {
+		__m128i g = _mm_loadu_si128((const __m128i *)(grey + x));
+		__m128i t = _mm_loadu_si128((const __m128i *)(thr + x));
+		/* max(g, t) == t is g <= t, i.e. black */
+		int black = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_max_epu8(g, t), t));
+
+		out[x >> 3] = bitrev8(~black & 0xFF);
+		out[(x >> 3) + 1] = bitrev8(~black >> 8 & 0xFF);
+	}
+#elif defined(EINK_DITHER_NEON)
+	static const uint8_t weights[16] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04,
+					     0x02, 0x01, 0x80, 0x40, 0x20, 0x10,
+					     0x08, 0x04, 0x02, 0x01 };
+	const uint8x16_t w = vld1q_u8(weights);
+
+	for (; x + 16 <= width; x += 16) {
+		uint8x16_t white = vcgtq_u8(vld1q_u8(grey + x),
+					    vld1q_u8(thr + x));
+		uint8x16_t bits = vandq_u8(white, w);
+
+		out[x >> 3] = vaddv_u8(vget_low_u8(bits));
+		out[(x >> 3) + 1] = vaddv_u8(vget_high_u8(bits));
+	}
+#endif
+
+	if (x < width)
+		memset(out + (x >> 3), 0, ((width + 7) >> 3) - (x >> 3));
+	for (; x < width; x++) {
+		if (grey[x] > thr[x])
+			out[x >> 3] |= 0x80 >> (x & 7);
+	}
+}
+
+static void eink_thresholds(uint8_t *thr, int width, int y, int method,
+			    int threshold)
+{
+	int bias = threshold - 128;
+	int x;
+
+	switch (method) {
+	case EINK_DITHER_ORDERED:
+		for (x = 0; x < width && x < 8; x++)
+			thr[x] = eink_clamp8(bayer8[y & 7][x] * 4 + 2 + bias);
+		for (; x < width; x++)
+			thr[x] = thr[x - 8];
+		break;
+	case EINK_DITHER_NOISE:
+		/*
+		 * Interleaved gradient noise (Jimenez 2014): cheap to compute
+		 * per pixel and free of the regular pattern Bayer leaves.
+		 */
+		for (x = 0; x < width; x++) {
+			float f = 0.06711056f * x + 0.00583715f * y;
+
+			/* Both terms are positive, so truncation is floor */
+			f = 52.9829189f * (f - (int)f);
+			/* 0..254, so pure white never turns black */
+			thr[x] = eink_clamp8((int)(255.0f * (f - (int)f)) + bias);
+		}
+		break;
+	default:
+		memset(thr, eink_clamp8(threshold), width);
+		break;
+	}
+}
+
+static int eink_dither_compare(const uint8_t *grey, int width, int height,
+			       int grey_stride, uint8_t *out, int out_stride,
+			       int method, int threshold)
+{
+	uint8_t *thr = malloc(width);
+	int y;
+
+	if (!thr)
+		return -ENOMEM;
+
+	for (y = 0; y < height; y++) {
+		/* A flat threshold is the same on every row */
+		if (y == 0 || method != EINK_DITHER_THRESHOLD)
+			eink_thresholds(thr, width, y, method, threshold);
+		eink_pack_row(grey + (size_t)y * grey_stride, thr, width,
+			      out + (size_t)y * out_stride);
+	}
+
+	free(thr);
+	return 0;
+}
+
+/*
+ * Serpentine error diffusion. Errors for the rows below are kept in int
+ * rows with two pixels of padding on each side, those for the pixels ahead
+ * and the row below's trailing sums in locals, so the only memory traffic
+ * per pixel is one read and two writes. Floyd-Steinberg works in 16ths of
+ * the error and Atkinson in 8ths.
+ */
+static int eink_dither_diffuse(const uint8_t *grey, int width, int height,
+			       int grey_stride, uint8_t *out, int out_stride,
+			       int method, int threshold)
+{
+	const int atkinson = method == EINK_DITHER_ATKINSON;
+	int row = width + 4;
+	int *err = calloc(3 * row, sizeof(*err));
+	int *cur, *next, *next2, *tmp;
+	int y;
+
+	if (!err)
+		return -ENOMEM;
+
+	cur = err + 2;
+	next = cur + row;
+	next2 = next + row;
+
+	for (y = 0; y < height; y++) {
+		const uint8_t *g = grey + (size_t)y * grey_stride;
+		uint8_t *o = out + (size_t)y * out_stride;
+		int dir = y & 1 ? -1 : 1;
+		int x = y & 1 ? width - 1 : 0;
+		/* Error owed to x + dir and x + 2 * dir on this row */
+		int ahead = 0, ahead2 = 0;
+		/* Partial sums for x - dir and x on the row below */
+		int below = 0, below2 = 0;
+		int i;
+
+		memset(o, 0, (width + 7) >> 3);
+
+		for (i = 0; i < width; i++, x += dir) {
+			int v, white, e;
+
+			if (atkinson) {
+				v = g[x] + ((cur[x] + ahead) >> 3);
+			} else {
+				v = g[x] + ((cur[x] + ahead) >> 4);
+			}
+
+			/* Branch free: dithered output is close to random */
+			white = v > threshold;
+			e = v - (-white & 255);
+			o[x >> 3] |= white << (7 - (x & 7));
+
+			if (atkinson) {
+				ahead = ahead2 + e;
+				ahead2 = e;
+				next[x - dir] += below + e;
+				below = below2 + e;
+				below2 = e;
+				next2[x] = e;
+			} else {
+				ahead = e * 7;
+				next[x - dir] += below + e * 3;
+				below = below2 + e * 5;
+				below2 = e;
+			}
+		}
+		next[x - dir] += below;
+		next[x] += below2;
+
+		/* Rotate the rows, the oldest one becomes the new last row */
+		tmp = cur;
+		cur = next;
+		next = next2;
+		next2 = tmp;
+		memset(next2 - 2, 0, row * sizeof(*err));
+	}
+
+	free(err);
+	return 0;
+}
+
+int eink_dither(const uint8_t *grey, int width, int height, int grey_stride,
+		uint8_t *out, int out_stride, int method, int threshold)
+{
+	if (!grey || !out || width <= 0 || height <= 0 ||
+	    grey_stride < width || out_stride < (width + 7) / 8 ||
+	    threshold < 0 || threshold > 255)
+		return -EINVAL;
+
+	switch (method) {
+	case EINK_DITHER_THRESHOLD:
+	case EINK_DITHER_ORDERED:
+	case EINK_DITHER_NOISE:
+		return eink_dither_compare(grey, width, height, grey_stride, out,
+					   out_stride, method, threshold);
+	case EINK_DITHER_FLOYD_STEINBERG:
+	case EINK_DITHER_ATKINSON:
+		return eink_dither_diffuse(grey, width, height, grey_stride, out,
+					   out_stride, method, threshold);
+	default:
+		return -EINVAL;
+	}
+}
+
+const char *eink_dither_kernel(void)
+{
+#if defined(EINK_DITHER_SSE2)
+	return "sse2";
+#elif defined(EINK_DITHER_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
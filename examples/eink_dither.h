@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * eink_dither.h - Greyscale to 1bpp conversion for the e-ink framebuffer
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Output rows are packed MSB first with a set bit for white, the layout
+ * of /dev/fbN, so they can be copied straight into the mapping.
+ */
+
+#ifndef _EINK_DITHER_H
+#define _EINK_DITHER_H
+
+#include <stdint.h>
+
+enum eink_dither_method {
+	EINK_DITHER_THRESHOLD = 0, /* white when grey > threshold */
+	EINK_DITHER_FLOYD_STEINBERG, /* serpentine error diffusion */
+	EINK_DITHER_ATKINSON, /* serpentine, 3/4 of the error diffused */
+	EINK_DITHER_ORDERED, /* 8x8 Bayer matrix */
+	EINK_DITHER_NOISE, /* interleaved gradient noise threshold */
+};
+
+/*
+ * Convert width x height 8-bit grey pixels (0 black, 255 white) to packed
+ * rows of at least (width + 7) / 8 bytes. threshold shifts the midpoint
+ * for every method; 128 is neutral. Returns 0, or -EINVAL for bad
+ * arguments and -ENOMEM when scratch memory cannot be allocated.
+ */
+int eink_dither(const uint8_t *grey, int width, int height, int grey_stride,
+		uint8_t *out, int out_stride, int method, int threshold);
+
+/* Name of the SIMD kernel in use: "sse2", "neon" or "scalar" */
+const char *eink_dither_kernel(void);
+
+#endif /* _EINK_DITHER_H */
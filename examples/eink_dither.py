@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+eink_dither.py - Python binding for the libeink_dither.so dithering library
+
+Copyright (C) 2025 Pamir AI
+License: GPL v2
+
+Converts greyscale images to the packed 1bpp framebuffer layout in C,
+using SSE2 or NEON for the threshold, ordered and noise methods. Build the
+library with 'make' in the examples directory; EINK_DITHER_LIB overrides
+the search path. available() is False when it cannot be loaded, so
+callers can fall back to PIL.
+"""
+
+import ctypes
+import ctypes.util
+import os
+import numpy as np
+from PIL import Image
+
+# Methods, matching enum eink_dither_method in eink_dither.h
+DITHER_THRESHOLD = 0
+DITHER_FLOYD_STEINBERG = 1
+DITHER_ATKINSON = 2
+DITHER_ORDERED = 3
+DITHER_NOISE = 4
+
+DITHER_METHODS = {
+    "threshold": DITHER_THRESHOLD,
+    "floyd-steinberg": DITHER_FLOYD_STEINBERG,
+    "atkinson": DITHER_ATKINSON,
+    "ordered": DITHER_ORDERED,
+    "noise": DITHER_NOISE,
+}
+
+_LIB_NAME = "libeink_dither.so"
+
+
+def _load_library():
+    """Find and load libeink_dither.so, returning None if it is missing."""
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [
+        os.environ.get("EINK_DITHER_LIB"),
+        os.path.join(here, _LIB_NAME),
+        # Packaged layout: python/ next to examples/
+        os.path.join(here, "..", "examples", _LIB_NAME),
+        ctypes.util.find_library("eink_dither"),
+    ]
+
+    for path in candidates:
+        if not path:
+            continue
+        try:
+            lib = ctypes.CDLL(path)
+        except OSError:
+            continue
+
+        lib.eink_dither.argtypes = [
+            ctypes.c_void_p,
+            ctypes.c_int,
+            ctypes.c_int,
+            ctypes.c_int,
+            ctypes.c_void_p,
+            ctypes.c_int,
+            ctypes.c_int,
+            ctypes.c_int,
+        ]
+        lib.eink_dither.restype = ctypes.c_int
+        lib.eink_dither_kernel.argtypes = []
+        lib.eink_dither_kernel.restype = ctypes.c_char_p
+        return lib
+
+    return None
+
+
+_lib = _load_library()
+
+
+def available():
+    """Return True if the C library was loaded."""
+    return _lib is not None
+
+
+def kernel():
+    """Name of the SIMD kernel in use, or None without the library."""
+    return _lib.eink_dither_kernel().decode() if _lib else None
+
+
+def dither_packed(grey, method=DITHER_FLOYD_STEINBERG, threshold=128):
+    """Dither a 2D uint8 array (0 black, 255 white) to packed 1bpp rows.
+
+    Returns a (height, (width + 7) // 8) uint8 array, MSB first with a set
+    bit for white: the framebuffer layout, ready for EInkDisplay.buffer.
+    """
+    if _lib is None:
+        raise OSError(f"{_LIB_NAME} not found, run 'make' in examples/")
+
+    grey = np.ascontiguousarray(grey, dtype=np.uint8)
+    if grey.ndim != 2:
+        raise ValueError("grey must be a 2D array")
+
+    height, width = grey.shape
+    out = np.empty((height, (width + 7) // 8), dtype=np.uint8)
+    ret = _lib.eink_dither(
+        grey.ctypes.data,
+        width,
+        height,
+        grey.strides[0],
+        out.ctypes.data,
+        out.strides[0],
+        method,
+        threshold,
+    )
+    if ret < 0:
+        raise OSError(-ret, os.strerror(-ret))
+    return out
+
+
+def dither(image, method=DITHER_FLOYD_STEINBERG, threshold=128):
+    """Dither a PIL image and return it in mode '1'."""
+    if image.mode != "L":
+        image = image.convert("L")
+
+    packed = dither_packed(np.asarray(image), method, threshold)
+    return Image.frombytes("1", image.size, packed.tobytes())
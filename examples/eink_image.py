@@ -15,10 +15,15 @@ Options:
     --mode MODE       Scaling mode: fit, fill, stretch, center (default: fit)
     --dither          Enable dithering for better grayscale (default)
     --no-dither       Disable dithering
+    --dither-method M Dither method: floyd-steinberg, atkinson, ordered,
+                      noise (default: floyd-steinberg)
     --rotate ANGLE    Rotate image: 0, 90, 180, 270 degrees
     --invert          Invert black and white
     --update MODE     Update mode: full, partial (default: full)
-    --threshold VAL   Threshold for B&W conversion without dither (0-255)
+    --threshold VAL   Threshold for B&W conversion (0-255, default: 128)
+
+Dithering runs in libeink_dither.so when it has been built (see
+eink_dither.py), otherwise PIL's Floyd-Steinberg or threshold is used.
 """
 
 import sys
@@ -30,10 +35,12 @@ from PIL import Image, ImageOps
 # Import common e-ink module
 try:
     from eink_common import EInkDisplay, EPD_MODE_FULL, EPD_MODE_PARTIAL
+    import eink_dither
 except ImportError:
     # Try from parent directory if running from source
     sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
     from eink_common import EInkDisplay, EPD_MODE_FULL, EPD_MODE_PARTIAL
+    import eink_dither
 
 
 def load_and_convert_image(
@@ -45,6 +52,7 @@ def load_and_convert_image(
     rotate=0,
     invert=False,
     threshold=128,
+    dither_method="floyd-steinberg",
 ):
     """Load an image and convert it for e-ink display.
 
@@ -56,7 +64,8 @@ def load_and_convert_image(
         dither: Enable dithering for better grayscale representation
         rotate: Rotation angle in degrees (0, 90, 180, 270)
         invert: Invert black and white
-        threshold: Threshold for B&W conversion without dither
+        threshold: Threshold for B&W conversion, 128 is neutral
+        dither_method: Key of eink_dither.DITHER_METHODS used with dither
 
     Returns:
         PIL Image in mode '1' (1-bit black and white)
@@ -138,7 +147,10 @@ def load_and_convert_image(
         img = ImageOps.invert(img)
 
     # Convert to 1-bit black and white
-    if dither:
+    if eink_dither.available():
+        method = eink_dither.DITHER_METHODS[dither_method if dither else "threshold"]
+        img = eink_dither.dither(img, method, threshold)
+    elif dither:
         # Use Floyd-Steinberg dithering for better quality
         img = img.convert("1", dither=Image.Dither.FLOYDSTEINBERG)
     else:
@@ -196,7 +208,13 @@ Supported formats: PNG, JPEG, BMP, TIFF, GIF, WEBP, PPM, and more via PIL/Pillow
         "--threshold",
         type=int,
         default=128,
-        help="B&W threshold without dither (0-255, default: 128)",
+        help="B&W threshold (0-255, default: 128)",
+    )
+    parser.add_argument(
+        "--dither-method",
+        choices=[m for m in eink_dither.DITHER_METHODS if m != "threshold"],
+        default="floyd-steinberg",
+        help="Dither method (default: floyd-steinberg)",
     )
 
     args = parser.parse_args()
@@ -227,6 +245,9 @@ Supported formats: PNG, JPEG, BMP, TIFF, GIF, WEBP, PPM, and more via PIL/Pillow
         # Load and convert image
         print(f"Loading image: {args.image}")
         print(f"Mode: {args.mode}, Dither: {args.dither}, Rotate: {args.rotate}°")
+        if args.dither and not eink_dither.available():
+            if args.dither_method != "floyd-steinberg":
+                print(f"{args.dither_method} needs libeink_dither.so, using PIL")
 
         img = load_and_convert_image(
             image_path,
@@ -237,6 +258,7 @@ Supported formats: PNG, JPEG, BMP, TIFF, GIF, WEBP, PPM, and more via PIL/Pillow
             rotate=args.rotate,
             invert=args.invert,
             threshold=args.threshold,
+            dither_method=args.dither_method,
         )
 
         # Clear display first
@@ -6,21 +6,17 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/statvfs.h>
-#include <linux/fb.h>
 #include <signal.h>
 #include <time.h>
 #include "pamir-ai-eink.h"
+#include "libeink.h"
 
 static volatile int keep_running = 1;
-static int fb_fd = -1;
-static uint8_t *fb_mem = NULL;
-static struct fb_var_screeninfo vinfo;
-static struct fb_fix_screeninfo finfo;
+static struct eink_display disp;
+static struct eink_surface *fb = &disp.surface;
 
 #define HISTORY_SIZE 50
 static int cpu_history[HISTORY_SIZE] = { 0 };
@@ -46,20 +42,39 @@ static const uint8_t font_5x7[][7] = {
 	/* space */ { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
 };
 
-/* Letters for labels */
-static const uint8_t font_letters[][7] = {
-	/* C */ { 0x7C, 0xC6, 0xC0, 0xC0, 0xC0, 0xC6, 0x7C },
-	/* P */ { 0xFC, 0xC6, 0xC6, 0xFC, 0xC0, 0xC0, 0xC0 },
-	/* U */ { 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C },
-	/* M */ { 0xC6, 0xEE, 0xFE, 0xD6, 0xC6, 0xC6, 0xC6 },
-	/* e */ { 0x00, 0x7C, 0xC6, 0xFE, 0xC0, 0xC6, 0x7C },
-	/* m */ { 0x00, 0xDC, 0xEE, 0xD6, 0xD6, 0xD6, 0xC6 },
-	/* D */ { 0xF8, 0xCC, 0xC6, 0xC6, 0xC6, 0xCC, 0xF8 },
-	/* i */ { 0x18, 0x00, 0x38, 0x18, 0x18, 0x18, 0x3C },
-	/* s */ { 0x00, 0x7C, 0xC6, 0x70, 0x1C, 0xC6, 0x7C },
-	/* k */ { 0xC0, 0xC0, 0xCC, 0xD8, 0xF0, 0xD8, 0xCC },
+static const struct eink_font font_small = {
+	.width = 8,
+	.height = 7,
+	.advance = 6,
+	.chars = "0123456789%:-. ",
+	.glyphs = &font_5x7[0][0],
 };
 
+/* Title letters (white on the black header bar) */
+static const uint8_t font_title[][7] = {
+	/* E */ { 0x00, 0x78, 0x40, 0x78, 0x40, 0x78, 0x00 },
+	/* I */ { 0x00, 0x78, 0x30, 0x30, 0x30, 0x78, 0x00 },
+	/* M */ { 0x00, 0x48, 0x78, 0x48, 0x48, 0x48, 0x00 },
+	/* N */ { 0x00, 0x48, 0x68, 0x58, 0x48, 0x48, 0x00 },
+	/* O */ { 0x00, 0x78, 0x48, 0x48, 0x48, 0x78, 0x00 },
+	/* R */ { 0x00, 0x78, 0x48, 0x78, 0x40, 0x48, 0x00 },
+	/* S */ { 0x00, 0x78, 0x40, 0x78, 0x08, 0x78, 0x00 },
+	/* T */ { 0x00, 0x78, 0x30, 0x30, 0x30, 0x30, 0x00 },
+	/* Y */ { 0x00, 0x48, 0x48, 0x30, 0x30, 0x30, 0x00 },
+};
+
+static const struct eink_font font_header = {
+	.width = 8,
+	.height = 7,
+	.advance = 6,
+	.chars = "EIMNORSTY",
+	.glyphs = &font_title[0][0],
+};
+
+/* The fonts as atlases, since every refresh redraws all the text */
+static struct eink_atlas atlas_small;
+static struct eink_atlas atlas_header;
+
 /* Simple icons (8x8) */
 static const uint8_t icon_cpu[8] = { 0x3C, 0x42, 0x99, 0xBD,
 				     0xBD, 0x99, 0x42, 0x3C };
@@ -70,12 +85,15 @@ static const uint8_t icon_mem[8] = { 0xFF, 0x81, 0xBD, 0xA5,
 static const uint8_t icon_disk[8] = { 0x7E, 0xFF, 0xFF, 0xFF,
 				      0xE7, 0xC3, 0x81, 0x7E };
 
-/* Dithering patterns for gradient effects */
-static const uint8_t dither_patterns[4] = {
-	0x00, /* 0% - all white */
-	0x55, /* 25% - checkerboard */
-	0xAA, /* 50% - inverse checkerboard */
-	0xFF /* 100% - all black */
+/*
+ * Dithering patterns for gradient effects, one byte per row of a 2x2
+ * cell repeated across the byte
+ */
+static const uint8_t dither_patterns[4][2] = {
+	{ 0x00, 0x00 }, /* 0% - all white */
+	{ 0xAA, 0xAA }, /* 50% - even columns */
+	{ 0x55, 0x55 }, /* 50% - odd columns */
+	{ 0xFF, 0xFF } /* 100% - all black */
 };
 
 static void signal_handler(int sig)
@@ -85,177 +103,68 @@ static void signal_handler(int sig)
 
 static int open_framebuffer(const char *device)
 {
-	fb_fd = open(device, O_RDWR);
-	if (fb_fd < 0) {
+	if (eink_open(&disp, device) < 0) {
 		perror("open framebuffer");
 		return -1;
 	}
 
-	if (ioctl(fb_fd, FBIOGET_VSCREENINFO, &vinfo) < 0) {
-		perror("FBIOGET_VSCREENINFO");
-		close(fb_fd);
-		return -1;
-	}
-
-	if (ioctl(fb_fd, FBIOGET_FSCREENINFO, &finfo) < 0) {
-		perror("FBIOGET_FSCREENINFO");
-		close(fb_fd);
-		return -1;
-	}
-
-	size_t fb_size = finfo.smem_len;
-	fb_mem = mmap(NULL, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fb_fd,
-		      0);
-	if (fb_mem == MAP_FAILED) {
-		perror("mmap");
-		close(fb_fd);
-		return -1;
-	}
+	if (eink_atlas_init(&atlas_small, &font_small, 1) < 0)
+		goto err_atlas;
+	if (eink_atlas_init(&atlas_header, &font_header, 1) < 0)
+		goto err_atlas_small;
 
-	printf("Framebuffer: %dx%d, %d bpp\n", vinfo.xres, vinfo.yres,
-	       vinfo.bits_per_pixel);
+	printf("Framebuffer: %dx%d, %d bpp\n", disp.vinfo.xres,
+	       disp.vinfo.yres, disp.vinfo.bits_per_pixel);
 
 	return 0;
-}
-
-static void close_framebuffer(void)
-{
-	if (fb_mem != MAP_FAILED) {
-		munmap(fb_mem, finfo.smem_len);
-	}
-	if (fb_fd >= 0) {
-		close(fb_fd);
-	}
-}
-
-static void set_pixel(int x, int y, int value)
-{
-	if (x < 0 || x >= vinfo.xres || y < 0 || y >= vinfo.yres)
-		return;
 
-	int byte_offset = y * finfo.line_length + (x / 8);
-	int bit_offset = 7 - (x % 8);
-
-	if (value) {
-		fb_mem[byte_offset] &= ~(1 << bit_offset);
-	} else {
-		fb_mem[byte_offset] |= (1 << bit_offset);
-	}
+err_atlas_small:
+	eink_atlas_free(&atlas_small);
+err_atlas:
+	perror("eink_atlas_init");
+	eink_close(&disp);
+	return -1;
 }
 
-static void draw_char_5x7(int x, int y, char c)
+static void close_framebuffer(void)
 {
-	const uint8_t *bitmap = NULL;
-
-	if (c >= '0' && c <= '9') {
-		bitmap = font_5x7[c - '0'];
-	} else if (c == '%') {
-		bitmap = font_5x7[10];
-	} else if (c == ':') {
-		bitmap = font_5x7[11];
-	} else if (c == '-') {
-		bitmap = font_5x7[12];
-	} else if (c == '.') {
-		bitmap = font_5x7[13];
-	} else if (c == ' ') {
-		bitmap = font_5x7[14];
-	} else {
-		return;
-	}
-
-	for (int row = 0; row < 7; row++) {
-		uint8_t line = bitmap[row];
-		for (int col = 0; col < 6; col++) {
-			if (line & (0x80 >> col)) {
-				set_pixel(x + col, y + row, 1);
-			}
-		}
-	}
+	eink_atlas_free(&atlas_header);
+	eink_atlas_free(&atlas_small);
+	eink_close(&disp);
 }
 
 static void draw_string(int x, int y, const char *str)
 {
-	int pos = 0;
-	while (*str) {
-		draw_char_5x7(x + pos * 6, y, *str);
-		str++;
-		pos++;
-	}
+	eink_atlas_text(fb, &atlas_small, x, y, str, EINK_BLACK);
 }
 
 static void draw_icon(int x, int y, const uint8_t *icon)
 {
-	for (int row = 0; row < 8; row++) {
-		uint8_t line = icon[row];
-		for (int col = 0; col < 8; col++) {
-			if (line & (0x80 >> col)) {
-				set_pixel(x + col, y + row, 1);
-			}
-		}
-	}
+	eink_blit(fb, x, y, icon, 8, 8, 1, EINK_BLACK, 0);
 }
 
 static void draw_rect(int x, int y, int width, int height, int filled)
 {
-	if (filled) {
-		for (int row = y; row < y + height; row++) {
-			for (int col = x; col < x + width; col++) {
-				set_pixel(col, row, 1);
-			}
-		}
-	} else {
-		/* Top and bottom edges */
-		for (int col = x; col < x + width; col++) {
-			set_pixel(col, y, 1);
-			set_pixel(col, y + height - 1, 1);
-		}
-		/* Left and right edges */
-		for (int row = y; row < y + height; row++) {
-			set_pixel(x, row, 1);
-			set_pixel(x + width - 1, row, 1);
-		}
-	}
+	if (filled)
+		eink_fill_rect(fb, x, y, width, height, EINK_BLACK);
+	else
+		eink_rect(fb, x, y, width, height, EINK_BLACK);
 }
 
 static void draw_dithered_rect(int x, int y, int width, int height, int level)
 {
-	uint8_t pattern = dither_patterns[level % 4];
-
-	for (int row = y; row < y + height; row++) {
-		for (int col = x; col < x + width; col++) {
-			int bit = ((row & 1) << 1) | (col & 1);
-			if (pattern & (1 << bit)) {
-				set_pixel(col, row, 1);
-			}
-		}
-	}
+	eink_fill_pattern(fb, x, y, width, height, dither_patterns[level % 4],
+			  2, EINK_BLACK);
 }
 
 static void clear_area(int x, int y, int width, int height)
 {
-	for (int row = y; row < y + height && row < vinfo.yres; row++) {
-		for (int col = x; col < x + width && col < vinfo.xres; col++) {
-			set_pixel(col, row, 0);
-		}
-	}
+	eink_fill_rect(fb, x, y, width, height, EINK_WHITE);
 }
 
 static void draw_horizontal_line(int x, int y, int width, int dashed)
 {
-	for (int i = 0; i < width; i++) {
-		if (!dashed || (i % 4 < 2)) {
-			set_pixel(x + i, y, 1);
-		}
-	}
-}
-
-static void draw_vertical_line(int x, int y, int height, int dashed)
-{
-	for (int i = 0; i < height; i++) {
-		if (!dashed || (i % 4 < 2)) {
-			set_pixel(x, y + i, 1);
-		}
-	}
+	eink_hline(fb, x, y, width, dashed ? 0xCC : 0xFF, EINK_BLACK);
 }
 
 static int get_cpu_usage(void)
@@ -368,31 +277,20 @@ static void draw_enhanced_graph(int x, int y, int width, int height, int *data,
 		int bar_height = (value * graph_height) / 100;
 
 		/* Draw vertical line for this data point */
-		for (int j = 0; j < bar_height; j++) {
-			int y_pos = graph_y + graph_height - j - 1;
-			/* Use dithering for visual effect */
-			if (j < bar_height / 4) {
-				set_pixel(graph_x + i, y_pos, 1);
-			} else if (j < bar_height / 2 && (i % 2 == 0)) {
-				set_pixel(graph_x + i, y_pos, 1);
-			} else if (j < 3 * bar_height / 4 &&
-				   ((i + j) % 3 != 0)) {
-				set_pixel(graph_x + i, y_pos, 1);
-			} else {
-				set_pixel(graph_x + i, y_pos, 1);
-			}
-		}
+		eink_vline(fb, graph_x + i, graph_y + graph_height - bar_height,
+			   bar_height, 0xFF, EINK_BLACK);
 	}
 
 	/* Draw alert indicator if value is high */
 	if (current_value > 80) {
 		/* Draw warning triangle */
-		for (int i = 0; i < 5; i++) {
-			set_pixel(x + width - 10 + i, y + 2 + (4 - i), 1);
-			set_pixel(x + width - 10 + i, y + 2 + (4 + i), 1);
-		}
-		set_pixel(x + width - 8, y + 5, 1); /* Exclamation mark */
-		set_pixel(x + width - 8, y + 7, 1);
+		eink_line(fb, x + width - 10, y + 6, x + width - 6, y + 2,
+			  EINK_BLACK);
+		eink_line(fb, x + width - 10, y + 6, x + width - 6, y + 10,
+			  EINK_BLACK);
+		/* Exclamation mark */
+		eink_pixel(fb, x + width - 8, y + 5, EINK_BLACK);
+		eink_pixel(fb, x + width - 8, y + 7, EINK_BLACK);
 	}
 }
 
@@ -429,78 +327,20 @@ static void draw_enhanced_bar(int x, int y, int width, int height, int value,
 static void draw_header(void)
 {
 	/* Draw title bar */
-	draw_rect(0, 0, vinfo.xres, 16, 1); /* Filled black bar */
+	draw_rect(0, 0, fb->width, 16, 1); /* Filled black bar */
 
-	/* Draw inverted title text (white on black) */
+	/* Draw title text in white on the bar */
 	char title[] = "SYSTEM MONITOR";
-	int title_x = (vinfo.xres - strlen(title) * 6) / 2;
-
-	/* First draw the text area in black, then invert pixels for text */
-	for (int i = 0; title[i]; i++) {
-		for (int row = 0; row < 7; row++) {
-			for (int col = 0; col < 6; col++) {
-				/* Invert the pixel color for white text on black */
-				set_pixel(title_x + i * 6 + col, 4 + row, 0);
-			}
-		}
-	}
+	int title_x = (fb->width - strlen(title) * 6) / 2;
 
-	/* Now draw the actual text in white */
-	int pos = 0;
-	for (int i = 0; title[i]; i++) {
-		if (title[i] >= 'A' && title[i] <= 'Z') {
-			/* Simple uppercase letter rendering */
-			for (int px = 1; px < 5; px++) {
-				for (int py = 1; py < 6; py++) {
-					if ((title[i] == 'S' &&
-					     ((px == 1 && py < 3) ||
-					      (py == 1 || py == 3 || py == 5) ||
-					      (px == 4 && py > 3))) ||
-					    (title[i] == 'Y' &&
-					     (((px == 1 || px == 4) && py < 3) ||
-					      ((px == 2 || px == 3) &&
-					       py >= 3))) ||
-					    (title[i] == 'T' &&
-					     (py == 1 || px == 2 || px == 3)) ||
-					    (title[i] == 'E' &&
-					     (px == 1 || py == 1 || py == 3 ||
-					      py == 5)) ||
-					    (title[i] == 'M' &&
-					     (px == 1 || px == 4 ||
-					      (px == 2 && py == 2) ||
-					      (px == 3 && py == 2))) ||
-					    (title[i] == 'O' &&
-					     ((px == 1 || px == 4) ||
-					      ((py == 1 || py == 5) && px > 1 &&
-					       px < 4))) ||
-					    (title[i] == 'N' &&
-					     (px == 1 || px == 4 ||
-					      (px == 2 && py == 2) ||
-					      (px == 3 && py == 3))) ||
-					    (title[i] == 'I' &&
-					     ((px == 2 || px == 3) ||
-					      ((py == 1 || py == 5) &&
-					       px >= 1 && px <= 4))) ||
-					    (title[i] == 'R' &&
-					     (px == 1 || (py == 1 || py == 3) ||
-					      (px == 4 && py != 3 &&
-					       py != 4)))) {
-						set_pixel(title_x + pos * 6 +
-								  px,
-							  4 + py, 0);
-					}
-				}
-			}
-		}
-		pos++;
-	}
+	eink_atlas_text(fb, &atlas_header, title_x, 4, title, EINK_WHITE);
 
 	/* Draw timestamp */
 	time_t now = time(NULL);
 	struct tm *tm_info = localtime(&now);
 	char time_str[9];
 	strftime(time_str, sizeof(time_str), "%H:%M:%S", tm_info);
-	draw_string(vinfo.xres - 50, 4, time_str);
+	draw_string(fb->width - 50, 4, time_str);
 }
 
 static void update_display(void)
@@ -516,15 +356,15 @@ static void update_display(void)
 	history_index = (history_index + 1) % HISTORY_SIZE;
 
 	/* Clear display */
-	memset(fb_mem, 0xFF, finfo.smem_len);
+	eink_fill(fb, EINK_WHITE);
 
 	/* Draw header */
 	draw_header();
 
 	/* Calculate layout - improved spacing */
-	int graph_width = (vinfo.xres - 20) / 2; /* Two graphs side by side */
+	int graph_width = (fb->width - 20) / 2; /* Two graphs side by side */
 	int graph_height = 70;
-	int bar_width = vinfo.xres - 16;
+	int bar_width = fb->width - 16;
 	int bar_height = 25;
 
 	/* Ensure byte alignment */
@@ -560,53 +400,18 @@ static void update_display(void)
 	draw_string(8, 155, info_str);
 
 	/* Draw separator line */
-	draw_horizontal_line(8, 165, vinfo.xres - 16, 0);
+	draw_horizontal_line(8, 165, fb->width - 16, 0);
 
 	/* Add update indicator */
 	static int update_counter = 0;
 	update_counter++;
 	for (int i = 0; i < (update_counter % 4); i++) {
-		set_pixel(vinfo.xres - 20 + i * 4, 170, 1);
+		eink_pixel(fb, fb->width - 20 + i * 4, 170, EINK_BLACK);
 	}
 
-	/* Define partial update areas */
-	struct epd_update_area areas[] = {
-		{ .x = 8,
-		  .y = 20,
-		  .width = graph_width,
-		  .height = graph_height },
-		{ .x = 8 + graph_width + 4,
-		  .y = 20,
-		  .width = graph_width,
-		  .height = graph_height },
-		{ .x = 8,
-		  .y = 95,
-		  .width = (bar_width - 4) / 2,
-		  .height = bar_height },
-		{ .x = 12 + (bar_width - 4) / 2,
-		  .y = 95,
-		  .width = (bar_width - 4) / 2,
-		  .height = bar_height },
-		{ .x = 8, .y = 125, .width = bar_width, .height = bar_height },
-		{ .x = 0,
-		  .y = 0,
-		  .width = vinfo.xres,
-		  .height = 16 }, /* Header */
-	};
-
-	/* Apply byte alignment and set partial areas */
-	for (int i = 0; i < 6; i++) {
-		areas[i].x = (areas[i].x / 8) * 8;
-		areas[i].width = (areas[i].width / 8) * 8;
-
-		if (ioctl(fb_fd, EPD_IOC_SET_PARTIAL_AREA, &areas[i]) < 0) {
-			perror("EPD_IOC_SET_PARTIAL_AREA");
-		}
-	}
-
-	/* Trigger display update */
-	if (ioctl(fb_fd, EPD_IOC_UPDATE_DISPLAY) < 0) {
-		perror("EPD_IOC_UPDATE_DISPLAY");
+	/* Refresh everything drawn above in one partial update */
+	if (eink_flush(&disp) < 0) {
+		perror("eink_flush");
 	}
 }
 
@@ -626,22 +431,20 @@ int main(int argc, char *argv[])
 	}
 
 	/* Clear display and do initial full update */
-	memset(fb_mem, 0xFF, finfo.smem_len);
-	int mode = EPD_MODE_FULL;
-	if (ioctl(fb_fd, EPD_IOC_SET_UPDATE_MODE, &mode) < 0) {
+	eink_fill(fb, EINK_WHITE);
+	if (eink_set_mode(&disp, EPD_MODE_FULL) < 0) {
 		perror("EPD_IOC_SET_UPDATE_MODE");
 	}
-	if (ioctl(fb_fd, EPD_IOC_UPDATE_DISPLAY) < 0) {
+	if (eink_update(&disp) < 0) {
 		perror("EPD_IOC_UPDATE_DISPLAY");
 	}
 
 	printf("Enhanced E-Ink System Monitor\n");
-	printf("Display: %dx%d\n", vinfo.xres, vinfo.yres);
+	printf("Display: %dx%d\n", fb->width, fb->height);
 	printf("Press Ctrl+C to exit\n");
 
 	/* Switch to partial mode for updates */
-	mode = EPD_MODE_PARTIAL;
-	if (ioctl(fb_fd, EPD_IOC_SET_UPDATE_MODE, &mode) < 0) {
+	if (eink_set_mode(&disp, EPD_MODE_PARTIAL) < 0) {
 		perror("EPD_IOC_SET_UPDATE_MODE partial");
 	}
 
@@ -656,7 +459,7 @@ int main(int argc, char *argv[])
 
 	/* Clear display on exit */
 	printf("Clearing display...\n");
-	if (ioctl(fb_fd, EPD_IOC_CLEAR_DISPLAY) < 0) {
+	if (ioctl(disp.fd, EPD_IOC_CLEAR_DISPLAY) < 0) {
 		perror("EPD_IOC_CLEAR_DISPLAY");
 	}
 
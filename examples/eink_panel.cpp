@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * eink_panel.cpp - C++ Panel API demonstration
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Draws a landscape layout on the 128x250 panel from the device tree
+ * overlay, then animates a progress bar with damage-only partial updates.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <thread>
+
+#include "pamir-ai-eink.hpp"
+
+using namespace pamir::eink;
+
+/* The overlay panel, turned to 250x128 */
+using Display = Panel<128, 250, Rotation::R90>;
+
+static const std::uint8_t icon_check[8] = { 0x00, 0x01, 0x03, 0x86,
+					    0xCC, 0x78, 0x30, 0x00 };
+
+int main(int argc, char *argv[])
+{
+	const char *fb_device = argc > 1 ? argv[1] : "/dev/fb0";
+
+	try {
+		Display panel(fb_device);
+
+		std::printf("Panel %dx%d, drawing %dx%d\n", Display::panel_width,
+			    Display::panel_height, Display::width,
+			    Display::height);
+
+		panel.fill(Color::White);
+		panel.rect({ 0, 0, Display::width, Display::height },
+			   Color::Black);
+		panel.fill_rect({ 0, 0, Display::width, 16 }, Color::Black);
+		panel.fill_rect({ 8, 24, 100, 40 }, Color::Black, 0xAA);
+		panel.rect({ 8, 24, 100, 40 }, Color::Black);
+		panel.blit(116, 28, icon_check, 8, 8, 1, Color::Black);
+		panel.rect({ 8, 80, Display::width - 16, 16 }, Color::Black);
+		panel.update(FullUpdate{});
+
+		for (int step = 1; step <= 10; step++) {
+			int filled = (Display::width - 20) * step / 10;
+
+			panel.fill_rect({ 10, 82, filled, 12 }, Color::Black);
+			panel.update(DamageUpdate{});
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+
+		panel.clear_display();
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "eink_panel: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,7 +1,14 @@
 #!/usr/bin/env python3
+import array
+import functools
+import mmap
 import os
+import struct
 import sys
 import textwrap
+import threading
+from collections import OrderedDict
+import numpy as np
 from PIL import Image, ImageDraw
 from eink_common import (
     EInkDisplay,
@@ -9,30 +16,7 @@ from eink_common import (
     EPD_MODE_PARTIAL,
 )
 
-
-class EInkReader:
-    def __init__(self, fb_device="/dev/fb0"):
-        self.display = EInkDisplay(fb_device)
-
-        self.font_size = 12
-        self.line_height = 14
-        self.margin = 5
-        self.text_width = self.display.width - (2 * self.margin)
-        self.text_height = self.display.height - (2 * self.margin) - 20
-        self.lines_per_page = self.text_height // self.line_height
-
-        self.book_text = ""
-        self.pages = []
-        self.current_page = 0
-
-        print(f"E-book reader initialized: {self.display.width}x{self.display.height}")
-
-    def load_text(self, text_file):
-        if text_file and os.path.exists(text_file):
-            with open(text_file, "r", encoding="utf-8") as f:
-                self.book_text = f.read()
-        else:
-            self.book_text = """
+SAMPLE_TEXT = """
 E-Ink Display Technology
 
 Electronic ink, or e-ink, is a type of electronic paper display technology 
@@ -75,45 +59,386 @@ enabling developers to create innovative applications that leverage the
 unique properties of electronic paper technology.
 """
 
-        self.paginate_text()
 
-    def paginate_text(self):
-        wrapper = textwrap.TextWrapper(width=self.text_width // 6)
-        lines = []
+class Paginator:
+    """Lays a book out into pages lazily, straight from a mapped file.
+
+    A page is recorded as the byte offset of the paragraph it starts in and
+    the number of that paragraph's wrapped lines that belong to the page
+    before. Only the pages asked for are laid out, plus whatever the
+    background pass started by index() has reached. Once that pass has
+    seen the whole book the index is saved in $XDG_CACHE_HOME/eink_reader,
+    and later opens of the same file with the same layout load it instead,
+    so any page is found without laying out the ones before it.
+    """
+
+    INDEX_MAGIC = b"EINKPIDX"
+    INDEX_VERSION = 1
+    _INDEX_HEADER = struct.Struct("<8sHHHHQQI")
+
+    # Pages laid out per turn of the background pass, between which
+    # page() gets the lock
+    INDEX_CHUNK = 64
+
+    def __init__(self, data, chars_per_line, lines_per_page, stat=None):
+        self._data = data
+        self._size = len(data)
+        self._stat = stat
+        self._map = None
+        self._file = None
+        self._wrapper = textwrap.TextWrapper(width=chars_per_line)
+        self.chars_per_line = chars_per_line
+        self.lines_per_page = lines_per_page
+
+        self._offsets = array.array("Q")
+        self._skips = array.array("I")
+        self._pos = 0
+        self._line = 0
+        self._complete = False
+
+        self._lock = threading.Lock()
+        self._thread = None
+        self._stop = False
+        self._wrap = functools.lru_cache(maxsize=16)(self._wrap_paragraph)
+
+    @classmethod
+    def from_text(cls, text, chars_per_line, lines_per_page):
+        return cls(text.encode("utf-8"), chars_per_line, lines_per_page)
+
+    @classmethod
+    def from_file(cls, path, chars_per_line, lines_per_page):
+        f = open(path, "rb")
+        st = os.fstat(f.fileno())
+        if st.st_size == 0:
+            f.close()
+            return cls(b"", chars_per_line, lines_per_page)
+
+        m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        book = cls(m, chars_per_line, lines_per_page, st)
+        book._file = f
+        book._map = m
+        book._load_index()
+        return book
+
+    @property
+    def count(self):
+        """Number of pages, or None until the whole book was laid out."""
+        return len(self._offsets) if self._complete else None
+
+    def progress(self, page):
+        """How far into the book a page starts, from 0 to 1."""
+        if not self._size:
+            return 1.0
+        return self._offsets[page] / self._size
+
+    def has_page(self, n):
+        with self._lock:
+            return self._reach(n)
+
+    def page(self, n):
+        """Return the lines of page n, or None if the book is shorter."""
+        with self._lock:
+            if not self._reach(n):
+                return None
+            pos = self._offsets[n]
+            skip = self._skips[n]
+
+            lines = []
+            while len(lines) < self.lines_per_page and pos < self._size:
+                wrapped = self._wrap(pos)
+                lines.extend(wrapped[skip : skip + self.lines_per_page - len(lines)])
+                pos = self._next_paragraph(pos)
+                skip = 0
+            return lines
+
+    def index(self, on_done=None):
+        """Lay out the rest of the book in the background.
+
+        on_done is called from the indexing thread once the page count is
+        known.
+        """
+        if self._complete:
+            if on_done:
+                on_done()
+            return
+        self._thread = threading.Thread(
+            target=self._index_all, args=(on_done,), daemon=True
+        )
+        self._thread.start()
+
+    def close(self):
+        self._stop = True
+        if self._thread is not None:
+            self._thread.join()
+            self._thread = None
+        self._wrap.cache_clear()
+        self._data = b""
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def _index_all(self, on_done):
+        while not self._stop:
+            with self._lock:
+                for _ in range(self.INDEX_CHUNK):
+                    if self._complete:
+                        break
+                    self._extend()
+                if not self._complete:
+                    continue
+            self._save_index()
+            if on_done:
+                on_done()
+            return
 
-        for paragraph in self.book_text.split("\n"):
-            if paragraph.strip():
-                wrapped = wrapper.wrap(paragraph)
-                lines.extend(wrapped)
-            else:
-                lines.append("")
+    def _reach(self, n):
+        while len(self._offsets) <= n and not self._complete:
+            self._extend()
+        return 0 <= n < len(self._offsets)
+
+    def _next_paragraph(self, pos):
+        end = self._data.find(b"\n", pos)
+        return self._size if end < 0 else end + 1
+
+    def _wrap_paragraph(self, pos):
+        end = self._data.find(b"\n", pos)
+        if end < 0:
+            end = self._size
+        # A newline never occurs inside a UTF-8 sequence, so a paragraph
+        # always decodes on its own
+        paragraph = self._data[pos:end].decode("utf-8", "replace").rstrip("\r")
+        if not paragraph.strip():
+            return [""]
+        return self._wrapper.wrap(paragraph)
+
+    def _extend(self):
+        """Lay out the page after the last one indexed."""
+        if self._pos >= self._size:
+            self._complete = True
+            return
 
-        self.pages = []
-        for i in range(0, len(lines), self.lines_per_page):
-            page_lines = lines[i : i + self.lines_per_page]
-            self.pages.append(page_lines)
+        self._offsets.append(self._pos)
+        self._skips.append(self._line)
+
+        lines = 0
+        while lines < self.lines_per_page and self._pos < self._size:
+            wrapped = len(self._wrap(self._pos))
+            take = min(wrapped - self._line, self.lines_per_page - lines)
+            lines += take
+            self._line += take
+            if self._line == wrapped:
+                self._pos = self._next_paragraph(self._pos)
+                self._line = 0
+
+        if self._pos >= self._size:
+            self._complete = True
+
+    def _index_path(self):
+        cache = os.environ.get("XDG_CACHE_HOME") or os.path.expanduser("~/.cache")
+        name = f"{self._stat.st_dev:x}-{self._stat.st_ino:x}.idx"
+        return os.path.join(cache, "eink_reader", name)
+
+    def _index_header(self, count):
+        return self._INDEX_HEADER.pack(
+            self.INDEX_MAGIC,
+            self.INDEX_VERSION,
+            self.chars_per_line,
+            self.lines_per_page,
+            0,
+            self._stat.st_size,
+            self._stat.st_mtime_ns,
+            count,
+        )
+
+    def _load_index(self):
+        """Use a saved index if it matches the file and the layout."""
+        try:
+            with open(self._index_path(), "rb") as f:
+                header = f.read(self._INDEX_HEADER.size)
+                if len(header) != self._INDEX_HEADER.size:
+                    return
+                count = self._INDEX_HEADER.unpack(header)[-1]
+                if header != self._index_header(count):
+                    return
+                offsets = array.array("Q")
+                skips = array.array("I")
+                offsets.fromfile(f, count)
+                skips.fromfile(f, count)
+        except (OSError, EOFError):
+            return
 
-        print(f"Loaded {len(self.pages)} pages")
+        self._offsets = offsets
+        self._skips = skips
+        self._pos = self._size
+        self._complete = True
 
-    def render_page(self, page_num):
-        if page_num < 0 or page_num >= len(self.pages):
+    def _save_index(self):
+        if self._stat is None:
             return
+        path = self._index_path()
+        tmp = f"{path}.{os.getpid()}"
+        try:
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(tmp, "wb") as f:
+                f.write(self._index_header(len(self._offsets)))
+                self._offsets.tofile(f)
+                self._skips.tofile(f)
+            os.replace(tmp, path)
+        except OSError as e:
+            print(f"Could not save page index: {e}")
+
+
+class PageCache:
+    """Pages rendered to packed framebuffer rows, kept in an LRU.
+
+    A background thread renders the pages named by prefetch() so that a
+    page turn usually finds its page ready and only has to copy it.
+    """
+
+    def __init__(self, render, capacity=8):
+        self._render = render
+        self._capacity = capacity
+        self._pages = OrderedDict()
+        self._wanted = []
+        self._busy = None
+        self._stop = False
+        self._cond = threading.Condition()
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def get(self, page):
+        """Return the rows of a page, rendering it now if it is not ready."""
+        with self._cond:
+            # Let a render already under way finish rather than repeat it
+            while self._busy == page:
+                self._cond.wait()
+            rows = self._pages.get(page)
+            if rows is not None:
+                self._pages.move_to_end(page)
+                return rows
+
+        rows = self._render(page)
+        with self._cond:
+            self._store(page, rows)
+        return rows
+
+    def prefetch(self, pages):
+        """Render these pages in the background, replacing older requests."""
+        with self._cond:
+            self._wanted = [p for p in pages if p not in self._pages]
+            self._cond.notify_all()
+
+    def clear(self):
+        """Drop every page, e.g. after the text was paginated again."""
+        with self._cond:
+            while self._busy is not None:
+                self._cond.wait()
+            self._pages.clear()
+            self._wanted = []
+
+    def close(self):
+        with self._cond:
+            self._stop = True
+            self._cond.notify_all()
+        self._thread.join()
+
+    def _store(self, page, rows):
+        self._pages[page] = rows
+        self._pages.move_to_end(page)
+        while len(self._pages) > self._capacity:
+            self._pages.popitem(last=False)
+
+    def _run(self):
+        while True:
+            with self._cond:
+                while not self._stop and not self._wanted:
+                    self._cond.wait()
+                if self._stop:
+                    return
+                page = self._wanted.pop(0)
+                if page in self._pages:
+                    continue
+                self._busy = page
+
+            # A page that fails here is rendered again, and reported, by get()
+            try:
+                rows = self._render(page)
+            except Exception:
+                rows = None
+
+            with self._cond:
+                self._busy = None
+                if rows is not None:
+                    self._store(page, rows)
+                self._cond.notify_all()
+
+
+class EInkReader:
+    def __init__(self, fb_device="/dev/fb0", cache_pages=8):
+        self.display = EInkDisplay(fb_device)
+
+        self.font_size = 12
+        self.line_height = 14
+        self.margin = 5
+        self.text_width = self.display.width - (2 * self.margin)
+        self.text_height = self.display.height - (2 * self.margin) - 20
+        self.lines_per_page = self.text_height // self.line_height
+
+        self.chars_per_line = self.text_width // 6
+
+        self.book = None
+        self.current_page = 0
+        self.cache = PageCache(self.render_page_rows, cache_pages)
+
+        print(f"E-book reader initialized: {self.display.width}x{self.display.height}")
+
+    def load_text(self, text_file):
+        if self.book is not None:
+            self.book.close()
+        self.cache.clear()
+
+        if text_file and os.path.exists(text_file):
+            self.book = Paginator.from_file(
+                text_file, self.chars_per_line, self.lines_per_page
+            )
+        else:
+            self.book = Paginator.from_text(
+                SAMPLE_TEXT, self.chars_per_line, self.lines_per_page
+            )
+
+        # Page one can be shown right away, the count follows when known
+        self.book.index(on_done=self._indexed)
 
+    def _indexed(self):
+        # Cached pages were rendered without the page count
+        self.cache.clear()
+        print(f"\nLoaded {self.book.count} pages")
+
+    def render_page_rows(self, page_num):
+        """Render a page to packed rows in the framebuffer layout."""
         img = Image.new("1", (self.display.width, self.display.height), 1)
         draw = ImageDraw.Draw(img)
 
         y_pos = self.margin
-        for line in self.pages[page_num]:
+        for line in self.book.page(page_num):
             draw.text((self.margin, y_pos), line, fill=0)
             y_pos += self.line_height
 
         status_y = self.display.height - 18
         draw.line([(0, status_y - 2), (self.display.width - 1, status_y - 2)], fill=0)
 
-        page_info = f"Page {page_num + 1}/{len(self.pages)}"
+        count = self.book.count
+        if count:
+            page_info = f"Page {page_num + 1}/{count}"
+            progress = (page_num + 1) / count
+        else:
+            page_info = f"Page {page_num + 1}"
+            progress = self.book.progress(page_num)
         draw.text((self.margin, status_y), page_info, fill=0)
 
-        progress = (page_num + 1) / len(self.pages)
         bar_width = self.display.width - 2 * self.margin
         bar_x = self.margin
         bar_y = status_y + 10
@@ -122,12 +447,28 @@ unique properties of electronic paper technology.
         if fill_width > 0:
             draw.rectangle([(bar_x, bar_y), (bar_x + fill_width, bar_y + 3)], fill=0)
 
-        self.display.draw_image(img)
+        # Mode "1" packs MSB first with 1 = white, as the framebuffer does
+        height, stride = self.display.buffer.shape
+        packed = np.frombuffer(img.tobytes(), dtype=np.uint8)
+        rows = np.zeros((height, stride), dtype=np.uint8)
+        rows[:, : (self.display.width + 7) // 8] = packed.reshape(height, -1)
+        return rows
+
+    def render_page(self, page_num):
+        """Copy a page into the framebuffer and render its neighbours ahead."""
+        if not self.book.has_page(page_num):
+            return False
+
+        self.display.buffer[:] = self.cache.get(page_num)
+        self.display.add_damage(0, 0, self.display.width, self.display.height)
+
+        ahead = (page_num + 1, page_num - 1, page_num + 2)
+        self.cache.prefetch([p for p in ahead if self.book.has_page(p)])
+        return True
 
     def next_page(self):
-        if self.current_page < len(self.pages) - 1:
+        if self.render_page(self.current_page + 1):
             self.current_page += 1
-            self.render_page(self.current_page)
             self.display.set_partial_area(
                 0, 0, self.display.width, self.display.height - 20
             )
@@ -164,7 +505,7 @@ unique properties of electronic paper technology.
         try:
             while True:
                 cmd = (
-                    input(f"[Page {self.current_page + 1}/{len(self.pages)}] > ")
+                    input(f"[Page {self.current_page + 1}/{self.book.count or '?'}] > ")
                     .strip()
                     .lower()
                 )
@@ -180,12 +521,13 @@ unique properties of electronic paper technology.
                 elif cmd.startswith("g "):
                     try:
                         page = int(cmd[2:]) - 1
-                        if 0 <= page < len(self.pages):
+                        if page >= 0 and self.render_page(page):
                             self.current_page = page
-                            self.render_page(self.current_page)
                             self.display.update_display()
+                        elif self.book.count:
+                            print(f"Invalid page (1-{self.book.count})")
                         else:
-                            print(f"Invalid page (1-{len(self.pages)})")
+                            print("Invalid page")
                     except ValueError:
                         print("Invalid page number")
 
@@ -195,6 +537,8 @@ unique properties of electronic paper technology.
             self.cleanup()
 
     def cleanup(self):
+        self.cache.close()
+        self.book.close()
         self.display.set_update_mode(EPD_MODE_FULL)
         self.display.clear(255)
         self.display.update_display()
@@ -4,6 +4,7 @@ import os
 import argparse
 from PIL import Image, ImageDraw
 from eink_common import EInkDisplay, EPD_MODE_FULL, EPD_MODE_PARTIAL
+from eink_anim import Animation, compile_frames, play
 
 try:
     import imageio.v3 as iio
@@ -110,15 +111,23 @@ def load_gif_frames(gif_path, max_width=128, max_height=250):
 
 
 def display_gif(display, gif_path=None, loops=3, use_partial=True):
-    if gif_path and os.path.exists(gif_path):
-        print(f"Loading GIF from: {gif_path}")
-        frames, durations = load_gif_frames(gif_path, display.width, display.height)
+    if gif_path and gif_path.endswith(".eanim") and os.path.exists(gif_path):
+        print(f"Loading animation from: {gif_path}")
+        anim = Animation(gif_path)
     else:
-        print("Creating demo animation...")
-        frames = create_simple_gif_frames()
-        durations = [200] * len(frames)
+        if gif_path and os.path.exists(gif_path):
+            print(f"Loading GIF from: {gif_path}")
+            frames, durations = load_gif_frames(gif_path, display.width, display.height)
+        else:
+            print("Creating demo animation...")
+            frames = create_simple_gif_frames()
+            durations = [200] * len(frames)
 
-    print(f"Loaded {len(frames)} frames")
+        # Convert once up front instead of on every loop
+        anim = Animation(compile_frames(frames, durations))
+
+    count = len(anim.frames)
+    print(f"Loaded {count} frames")
 
     print("Clearing display...")
     display.set_update_mode(EPD_MODE_FULL)
@@ -126,63 +135,36 @@ def display_gif(display, gif_path=None, loops=3, use_partial=True):
     display.update_display()
     time.sleep(1)
 
-    if frames:
-        frame_width, frame_height = frames[0].size
-        x_pos = (display.width - frame_width) // 2
-        y_pos = (display.height - frame_height) // 2
-
-        x_pos = (x_pos // 8) * 8
-        x_pos = max(0, x_pos)
-        y_pos = max(0, y_pos)
+    print(f"Animation size: {anim.width}x{anim.height}")
 
-        frame_width = min(frame_width, display.width - x_pos)
-        frame_height = min(frame_height, display.height - y_pos)
-
-        print(f"Animation size: {frame_width}x{frame_height}")
-        print(f"Display position: ({x_pos}, {y_pos})")
-
-        if use_partial and len(frames) > 1:
-            print("Using partial update mode for animation")
-            display.set_update_mode(EPD_MODE_PARTIAL)
-            display.set_partial_area(x_pos, y_pos, frame_width, frame_height)
-        else:
-            print("Using full update mode")
-            display.set_update_mode(EPD_MODE_FULL)
-
-        loop_count = 0
-        try:
-            while loops == 0 or loop_count < loops:
-                for i, (frame, duration) in enumerate(zip(frames, durations)):
-                    mono_frame = frame.convert("1")
-
-                    if (
-                        mono_frame.size[0] > display.width
-                        or mono_frame.size[1] > display.height
-                    ):
-                        print(f"Warning: Frame {i + 1} needs additional resizing")
-                        continue
-
-                    if use_partial and len(frames) > 1:
-                        clear_img = Image.new("1", (frame_width, frame_height), 1)
-                        display.draw_image(clear_img, x_pos, y_pos)
-
-                    display.draw_image(mono_frame, x_pos, y_pos)
-                    display.update_display()
-
-                    print(
-                        f"Frame {i + 1}/{len(frames)} (loop {loop_count + 1}/{loops if loops > 0 else '∞'})",
-                        end="\r",
-                    )
-                    time.sleep(duration / 1000.0)
-
-                loop_count += 1
+    if use_partial and count > 1:
+        print("Using partial update mode for animation")
+        mode = EPD_MODE_PARTIAL
+    else:
+        print("Using full update mode")
+        mode = EPD_MODE_FULL
 
-        except KeyboardInterrupt:
-            print("\nAnimation interrupted")
+    try:
+        play(
+            display,
+            anim,
+            loops=loops,
+            mode=mode,
+            on_frame=lambda i, loop: print(
+                f"Frame {i + 1}/{count} (loop {loop + 1}/{loops if loops > 0 else '∞'})",
+                end="\r",
+            ),
+        )
+    except KeyboardInterrupt:
+        print("\nAnimation interrupted")
+    except ValueError as e:
+        print(f"\nError: {e}")
+    finally:
+        anim.close()
 
     print("\nAnimation complete")
 
-    if use_partial and len(frames) > 1:
+    if use_partial and count > 1:
         print("Performing final full refresh...")
         display.set_update_mode(EPD_MODE_FULL)
         display.clear(255)
@@ -199,7 +181,7 @@ def main():
     parser.add_argument(
         "gif_file",
         nargs="?",
-        help="Path to GIF file (optional, uses demo if not provided)",
+        help="Path to GIF or compiled .eanim file (optional, uses demo if not provided)",
     )
     parser.add_argument(
         "--loops", type=int, default=3, help="Number of loops (0 for infinite)"
@@ -0,0 +1,680 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * libeink.c - 1bpp drawing library for the Pamir AI e-ink framebuffer
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Spans are written a byte at a time with edge masks, and the solid
+ * middle of a span goes through memset. Bitmaps are shifted into place a
+ * byte at a time instead of being walked pixel by pixel.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "pamir-ai-eink.h"
+#include "libeink.h"
+
+/* Widest row eink_blit_scaled() expands in one go */
+#define EINK_SCALED_MAX_BYTES 64
+
+static inline int eink_min(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static inline int eink_max(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/* Apply mask to one byte; a black pixel is a cleared bit */
+static inline void eink_put(uint8_t *p, uint8_t mask, int color)
+{
+	if (color == EINK_BLACK)
+		*p &= ~mask;
+	else if (color == EINK_WHITE)
+		*p |= mask;
+	else
+		*p ^= mask;
+}
+
+/* Set the pixels selected by pattern in [x0, x1) of a row, x0 < x1 */
+static void eink_span(uint8_t *row, int x0, int x1, uint8_t pattern,
+		      int color)
+{
+	int first = x0 >> 3;
+	int last = (x1 - 1) >> 3;
+	uint8_t head = 0xFF >> (x0 & 7);
+	uint8_t tail = 0xFF << (7 - ((x1 - 1) & 7));
+	int i;
+
+	if (first == last) {
+		eink_put(row + first, head & tail & pattern, color);
+		return;
+	}
+
+	eink_put(row + first, head & pattern, color);
+	if (pattern == 0xFF && color != EINK_INVERT) {
+		memset(row + first + 1, color == EINK_BLACK ? 0x00 : 0xFF,
+		       last - first - 1);
+	} else {
+		for (i = first + 1; i < last; i++)
+			eink_put(row + i, pattern, color);
+	}
+	eink_put(row + last, tail & pattern, color);
+}
+
+/* Clip a rectangle to the surface, false when nothing is left */
+static int eink_clip(const struct eink_surface *s, int *x, int *y, int *width,
+		     int *height)
+{
+	int x0 = eink_max(*x, 0);
+	int y0 = eink_max(*y, 0);
+	int x1 = eink_min(*x + *width, s->width);
+	int y1 = eink_min(*y + *height, s->height);
+
+	if (x0 >= x1 || y0 >= y1)
+		return 0;
+
+	*x = x0;
+	*y = y0;
+	*width = x1 - x0;
+	*height = y1 - y0;
+	return 1;
+}
+
+void eink_surface_init(struct eink_surface *s, uint8_t *buf, int width,
+		       int height, int stride)
+{
+	s->buf = buf;
+	s->width = width;
+	s->height = height;
+	s->stride = stride;
+	eink_damage_clear(s);
+}
+
+void eink_damage_clear(struct eink_surface *s)
+{
+	memset(&s->damage, 0, sizeof(s->damage));
+}
+
+void eink_damage(struct eink_surface *s, int x, int y, int width, int height)
+{
+	struct eink_rect *d = &s->damage;
+	int x1, y1;
+
+	if (!eink_clip(s, &x, &y, &width, &height))
+		return;
+
+	if (!d->width) {
+		d->x = x;
+		d->y = y;
+		d->width = width;
+		d->height = height;
+		return;
+	}
+
+	x1 = eink_max(d->x + d->width, x + width);
+	y1 = eink_max(d->y + d->height, y + height);
+	d->x = eink_min(d->x, x);
+	d->y = eink_min(d->y, y);
+	d->width = x1 - d->x;
+	d->height = y1 - d->y;
+}
+
+void eink_fill(struct eink_surface *s, int color)
+{
+	eink_fill_rect(s, 0, 0, s->width, s->height, color);
+}
+
+void eink_pixel(struct eink_surface *s, int x, int y, int color)
+{
+	if (x < 0 || x >= s->width || y < 0 || y >= s->height)
+		return;
+
+	eink_put(s->buf + y * s->stride + (x >> 3), 0x80 >> (x & 7), color);
+	eink_damage(s, x, y, 1, 1);
+}
+
+int eink_get_pixel(const struct eink_surface *s, int x, int y)
+{
+	if (x < 0 || x >= s->width || y < 0 || y >= s->height)
+		return EINK_WHITE;
+
+	return s->buf[y * s->stride + (x >> 3)] & (0x80 >> (x & 7)) ?
+		       EINK_WHITE :
+		       EINK_BLACK;
+}
+
+void eink_fill_rect(struct eink_surface *s, int x, int y, int width,
+		    int height, int color)
+{
+	uint8_t *row;
+	int i;
+
+	if (!eink_clip(s, &x, &y, &width, &height))
+		return;
+
+	row = s->buf + y * s->stride;
+	for (i = 0; i < height; i++, row += s->stride)
+		eink_span(row, x, x + width, 0xFF, color);
+
+	eink_damage(s, x, y, width, height);
+}
+
+/*
+ * Fill with a repeating 8 x rows pattern. The pattern is anchored to the
+ * surface, not the rectangle, so neighbouring fills line up.
+ */
+void eink_fill_pattern(struct eink_surface *s, int x, int y, int width,
+		       int height, const uint8_t *pattern, int rows, int color)
+{
+	uint8_t *row;
+	int i;
+
+	if (rows <= 0 || !eink_clip(s, &x, &y, &width, &height))
+		return;
+
+	row = s->buf + y * s->stride;
+	for (i = 0; i < height; i++, row += s->stride)
+		eink_span(row, x, x + width, pattern[(y + i) % rows], color);
+
+	eink_damage(s, x, y, width, height);
+}
+
+/* pattern repeats every 8 pixels from x, 0xFF draws a solid line */
+void eink_hline(struct eink_surface *s, int x, int y, int width,
+		uint8_t pattern, int color)
+{
+	int shift = x & 7;
+
+	/* Rotate so the pattern starts at x rather than at the byte */
+	if (shift)
+		pattern = (pattern >> shift) | (pattern << (8 - shift));
+
+	if (y < 0 || y >= s->height)
+		return;
+
+	eink_fill_pattern(s, x, y, width, 1, &pattern, 1, color);
+}
+
+void eink_vline(struct eink_surface *s, int x, int y, int height,
+		uint8_t pattern, int color)
+{
+	int h = height;
+	int y0 = y;
+	int w = 1;
+	uint8_t *p;
+	uint8_t mask;
+	int i;
+
+	if (!eink_clip(s, &x, &y0, &w, &h))
+		return;
+
+	p = s->buf + y0 * s->stride + (x >> 3);
+	mask = 0x80 >> (x & 7);
+	for (i = 0; i < h; i++, p += s->stride) {
+		if (pattern & (0x80 >> ((y0 - y + i) & 7)))
+			eink_put(p, mask, color);
+	}
+
+	eink_damage(s, x, y0, 1, h);
+}
+
+void eink_rect(struct eink_surface *s, int x, int y, int width, int height,
+	       int color)
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	eink_hline(s, x, y, width, 0xFF, color);
+	if (height > 1)
+		eink_hline(s, x, y + height - 1, width, 0xFF, color);
+	if (height > 2) {
+		eink_vline(s, x, y + 1, height - 2, 0xFF, color);
+		if (width > 1)
+			eink_vline(s, x + width - 1, y + 1, height - 2, 0xFF,
+				   color);
+	}
+}
+
+void eink_line(struct eink_surface *s, int x0, int y0, int x1, int y1,
+	       int color)
+{
+	int dx = abs(x1 - x0);
+	int dy = -abs(y1 - y0);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+	int bx = eink_min(x0, x1), by = eink_min(y0, y1);
+
+	if (y0 == y1) {
+		eink_hline(s, bx, y0, dx + 1, 0xFF, color);
+		return;
+	}
+	if (x0 == x1) {
+		eink_vline(s, x0, by, -dy + 1, 0xFF, color);
+		return;
+	}
+
+	for (;;) {
+		int e2 = 2 * err;
+
+		if (x0 >= 0 && x0 < s->width && y0 >= 0 && y0 < s->height)
+			eink_put(s->buf + y0 * s->stride + (x0 >> 3),
+				 0x80 >> (x0 & 7), color);
+		if (x0 == x1 && y0 == y1)
+			break;
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+
+	eink_damage(s, bx, by, dx + 1, -dy + 1);
+}
+
+/* Eight source bits starting at bit, which may be negative */
+static inline uint8_t eink_src_bits(const uint8_t *src, int bit, int bytes)
+{
+	int i, shift;
+
+	if (bit < 0)
+		return src[0] >> -bit;
+
+	i = bit >> 3;
+	shift = bit & 7;
+	if (!shift)
+		return src[i];
+
+	return (src[i] << shift) |
+	       (i + 1 < bytes ? src[i + 1] >> (8 - shift) : 0);
+}
+
+/* Blit one clipped source row: destination pixels [x0, x1) of row */
+static void eink_blit_row(uint8_t *row, int x, int x0, int x1,
+			  const uint8_t *src, int src_bytes, int color,
+			  unsigned int flags)
+{
+	int first = x0 >> 3;
+	int last = (x1 - 1) >> 3;
+	int i;
+
+	for (i = first; i <= last; i++) {
+		uint8_t mask = 0xFF;
+		uint8_t bits;
+
+		if (i == first)
+			mask &= 0xFF >> (x0 & 7);
+		if (i == last)
+			mask &= 0xFF << (7 - ((x1 - 1) & 7));
+
+		bits = eink_src_bits(src, i * 8 - x, src_bytes);
+		if ((flags & EINK_BLIT_OPAQUE) && color != EINK_INVERT) {
+			if (color == EINK_BLACK)
+				bits = ~bits;
+			row[i] = (row[i] & ~mask) | (bits & mask);
+		} else {
+			eink_put(row + i, bits & mask, color);
+		}
+	}
+}
+
+/*
+ * Draw a 1bpp MSB-first bitmap. Set bits are painted in color; with
+ * EINK_BLIT_OPAQUE clear bits are painted in the opposite colour too.
+ */
+void eink_blit(struct eink_surface *s, int x, int y, const uint8_t *bits,
+	       int width, int height, int src_stride, int color,
+	       unsigned int flags)
+{
+	int cx = x, cy = y, cw = width, ch = height;
+	const uint8_t *src;
+	uint8_t *row;
+	int i;
+
+	if (!eink_clip(s, &cx, &cy, &cw, &ch))
+		return;
+
+	src = bits + (cy - y) * src_stride;
+	row = s->buf + cy * s->stride;
+	for (i = 0; i < ch; i++, src += src_stride, row += s->stride)
+		eink_blit_row(row, x, cx, cx + cw, src, src_stride, color,
+			      flags);
+
+	eink_damage(s, cx, cy, cw, ch);
+}
+
+/* As eink_blit(), with every source pixel drawn as a scale x scale block */
+void eink_blit_scaled(struct eink_surface *s, int x, int y,
+		      const uint8_t *bits, int width, int height,
+		      int src_stride, int scale, int color, unsigned int flags)
+{
+	uint8_t wide[EINK_SCALED_MAX_BYTES];
+	int wide_width, wide_bytes;
+	int i, j;
+
+	if (scale <= 1) {
+		eink_blit(s, x, y, bits, width, height, src_stride, color,
+			  flags);
+		return;
+	}
+
+	wide_width = eink_min(width * scale, EINK_SCALED_MAX_BYTES * 8);
+	wide_bytes = (wide_width + 7) / 8;
+
+	for (i = 0; i < height; i++, bits += src_stride) {
+		int wy = y + i * scale;
+
+		if (wy >= s->height)
+			break;
+		if (wy + scale <= 0)
+			continue;
+
+		memset(wide, 0, wide_bytes);
+		for (j = 0; j * scale < wide_width; j++) {
+			if (bits[j >> 3] & (0x80 >> (j & 7)))
+				eink_span(wide, j * scale,
+					  eink_min((j + 1) * scale, wide_width),
+					  0xFF, EINK_INVERT);
+		}
+
+		for (j = 0; j < scale; j++)
+			eink_blit(s, x, wy + j, wide, wide_width, 1,
+				  wide_bytes, color, flags);
+	}
+}
+
+static const uint8_t *eink_font_glyph(const struct eink_font *font, char c)
+{
+	int stride = (font->width + 7) / 8;
+	unsigned char uc = c;
+	const char *pos;
+	int index;
+
+	if (font->chars) {
+		pos = c ? strchr(font->chars, c) : NULL;
+		if (!pos)
+			return NULL;
+		index = pos - font->chars;
+	} else {
+		if (uc < font->first || uc > font->last)
+			return NULL;
+		index = uc - font->first;
+	}
+
+	return font->glyphs + index * font->height * stride;
+}
+
+/* Draw one glyph and return how far to advance */
+int eink_glyph(struct eink_surface *s, const struct eink_font *font, int x,
+	       int y, int scale, char c, int color)
+{
+	const uint8_t *glyph = eink_font_glyph(font, c);
+
+	if (scale < 1)
+		scale = 1;
+
+	if (glyph)
+		eink_blit_scaled(s, x, y, glyph, font->width, font->height,
+				 (font->width + 7) / 8, scale, color, 0);
+
+	return font->advance * scale;
+}
+
+/* Draw a string on one line and return its width */
+int eink_text(struct eink_surface *s, const struct eink_font *font, int x,
+	      int y, int scale, const char *str, int color)
+{
+	int start = x;
+
+	while (*str)
+		x += eink_glyph(s, font, x, y, scale, *str++, color);
+
+	return x - start;
+}
+
+int eink_atlas_init(struct eink_atlas *atlas, const struct eink_font *font,
+		    int scale)
+{
+	int src_stride = (font->width + 7) / 8;
+	int count, i, row, j, k;
+	uint8_t *dst;
+
+	if (scale < 1)
+		scale = 1;
+
+	count = font->chars ? (int)strlen(font->chars) :
+			      font->last - font->first + 1;
+	if (count <= 0 || font->width <= 0 || font->height <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	atlas->width = font->width * scale;
+	atlas->height = font->height * scale;
+	atlas->advance = font->advance * scale;
+	atlas->stride = (atlas->width + 7) / 8;
+	atlas->bits = calloc((size_t)count * atlas->height, atlas->stride);
+	if (!atlas->bits)
+		return -1;
+
+	memset(atlas->index, 0xFF, sizeof(atlas->index));
+	for (i = 0; i < count; i++) {
+		unsigned char c = font->chars ? font->chars[i] : font->first + i;
+		const uint8_t *src = font->glyphs + i * font->height * src_stride;
+
+		/* The first match wins, as with strchr() in eink_glyph() */
+		if (atlas->index[c] < 0)
+			atlas->index[c] = i;
+
+		dst = atlas->bits + (size_t)i * atlas->height * atlas->stride;
+		for (row = 0; row < font->height; row++, src += src_stride) {
+			for (j = 0; j < font->width; j++) {
+				if (src[j >> 3] & (0x80 >> (j & 7)))
+					eink_span(dst, j * scale,
+						  (j + 1) * scale, 0xFF,
+						  EINK_INVERT);
+			}
+			for (k = 1; k < scale; k++)
+				memcpy(dst + k * atlas->stride, dst,
+				       atlas->stride);
+			dst += scale * atlas->stride;
+		}
+	}
+
+	return 0;
+}
+
+void eink_atlas_free(struct eink_atlas *atlas)
+{
+	free(atlas->bits);
+	atlas->bits = NULL;
+}
+
+/*
+ * Draw rows of a glyph that lies wholly inside the surface. Source bytes
+ * are shifted into place, with the bits pushed out of one byte carried
+ * into the next; at a byte-aligned x there is nothing to carry. Called
+ * with a constant color, so each colour gets its own loop.
+ */
+static inline void eink_atlas_rows(uint8_t *row, int stride, int rows,
+				   const uint8_t *src, int src_stride,
+				   int bytes, int shift, int color)
+{
+	int i, j;
+
+	for (i = 0; i < rows; i++, src += src_stride, row += stride) {
+		uint8_t prev = 0;
+
+		if (!shift) {
+			for (j = 0; j < bytes; j++)
+				eink_put(row + j, src[j], color);
+			continue;
+		}
+
+		for (j = 0; j < bytes; j++) {
+			uint8_t cur = j < src_stride ? src[j] : 0;
+
+			eink_put(row + j, (prev << (8 - shift)) | (cur >> shift),
+				 color);
+			prev = cur;
+		}
+	}
+}
+
+static void eink_atlas_glyph(struct eink_surface *s, int x, int y, int rows,
+			     const uint8_t *src, const struct eink_atlas *atlas,
+			     int color)
+{
+	int first = x >> 3;
+	int bytes = ((x + atlas->width - 1) >> 3) - first + 1;
+	uint8_t *row = s->buf + y * s->stride + first;
+
+	if (color == EINK_BLACK)
+		eink_atlas_rows(row, s->stride, rows, src, atlas->stride,
+				bytes, x & 7, EINK_BLACK);
+	else if (color == EINK_WHITE)
+		eink_atlas_rows(row, s->stride, rows, src, atlas->stride,
+				bytes, x & 7, EINK_WHITE);
+	else
+		eink_atlas_rows(row, s->stride, rows, src, atlas->stride,
+				bytes, x & 7, EINK_INVERT);
+}
+
+/* As eink_text(), from an atlas */
+int eink_atlas_text(struct eink_surface *s, const struct eink_atlas *atlas,
+		    int x, int y, const char *str, int color)
+{
+	int y0 = eink_max(y, 0);
+	int y1 = eink_min(y + atlas->height, s->height);
+	int start = x, end = x;
+
+	for (; *str; str++, x += atlas->advance) {
+		int index = atlas->index[(unsigned char)*str];
+		const uint8_t *src;
+
+		if (index < 0 || y0 >= y1)
+			continue;
+
+		src = atlas->bits + (size_t)index * atlas->height * atlas->stride;
+		if (x < 0 || x + atlas->width > s->width) {
+			/* Cut off at a side, the general path clips it */
+			eink_blit(s, x, y, src, atlas->width, atlas->height,
+				  atlas->stride, color, 0);
+			continue;
+		}
+
+		eink_atlas_glyph(s, x, y0, y1 - y0,
+				 src + (y0 - y) * atlas->stride, atlas, color);
+		end = x + atlas->width;
+	}
+
+	if (end > start)
+		eink_damage(s, start, y, end - start, atlas->height);
+
+	return x - start;
+}
+
+int eink_open(struct eink_display *disp, const char *device)
+{
+	int saved;
+
+	memset(disp, 0, sizeof(*disp));
+
+	disp->fd = open(device, O_RDWR);
+	if (disp->fd < 0)
+		return -1;
+
+	if (ioctl(disp->fd, FBIOGET_VSCREENINFO, &disp->vinfo) < 0 ||
+	    ioctl(disp->fd, FBIOGET_FSCREENINFO, &disp->finfo) < 0)
+		goto err_close;
+
+	if (disp->vinfo.bits_per_pixel != 1) {
+		errno = EINVAL;
+		goto err_close;
+	}
+
+	disp->size = disp->finfo.smem_len;
+	disp->surface.buf = mmap(NULL, disp->size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, disp->fd, 0);
+	if (disp->surface.buf == MAP_FAILED)
+		goto err_close;
+
+	eink_surface_init(&disp->surface, disp->surface.buf, disp->vinfo.xres,
+			  disp->vinfo.yres, disp->finfo.line_length);
+	return 0;
+
+err_close:
+	saved = errno;
+	close(disp->fd);
+	disp->fd = -1;
+	errno = saved;
+	return -1;
+}
+
+void eink_close(struct eink_display *disp)
+{
+	if (disp->surface.buf && disp->surface.buf != MAP_FAILED)
+		munmap(disp->surface.buf, disp->size);
+	if (disp->fd >= 0)
+		close(disp->fd);
+
+	disp->surface.buf = NULL;
+	disp->fd = -1;
+}
+
+int eink_set_mode(struct eink_display *disp, int mode)
+{
+	return ioctl(disp->fd, EPD_IOC_SET_UPDATE_MODE, &mode) < 0 ? -1 : 0;
+}
+
+/* Refresh the whole panel in the current mode */
+int eink_update(struct eink_display *disp)
+{
+	eink_damage_clear(&disp->surface);
+	return ioctl(disp->fd, EPD_IOC_UPDATE_DISPLAY) < 0 ? -1 : 0;
+}
+
+/*
+ * Refresh only what was drawn since the last update. The damage is
+ * widened to whole bytes because the driver only takes byte-aligned
+ * partial areas. Nothing is sent when the surface is clean.
+ */
+int eink_flush(struct eink_display *disp)
+{
+	struct eink_surface *s = &disp->surface;
+	struct epd_update_area area;
+	int x0, x1;
+
+	if (!s->damage.width)
+		return 0;
+
+	x0 = s->damage.x & ~7;
+	x1 = eink_min((s->damage.x + s->damage.width + 7) & ~7,
+		      s->width & ~7);
+	if (x1 <= x0) {
+		/* Damage only in the pixels past the last whole byte */
+		x1 = s->width & ~7;
+		x0 = eink_max(x1 - 8, 0);
+	}
+
+	area.x = x0;
+	area.y = s->damage.y;
+	area.width = x1 - x0;
+	area.height = s->damage.height;
+
+	if (ioctl(disp->fd, EPD_IOC_SET_PARTIAL_AREA, &area) < 0)
+		return -1;
+
+	return eink_update(disp);
+}
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * libeink.h - 1bpp drawing library for the Pamir AI e-ink framebuffer
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Draws into the MSB-first, 1 = white layout that /dev/fbN exposes. All
+ * calls clip to the surface and grow its damage rectangle, which
+ * eink_flush() turns into one EPD_IOC_SET_PARTIAL_AREA and refresh.
+ */
+
+#ifndef _LIBEINK_H
+#define _LIBEINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/fb.h>
+
+/* Colours; INVERT flips whatever is already there */
+#define EINK_WHITE 0
+#define EINK_BLACK 1
+#define EINK_INVERT 2
+
+/* Blit flags */
+#define EINK_BLIT_OPAQUE 0x1 /* clear source bits paint the opposite colour */
+
+struct eink_rect {
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+struct eink_surface {
+	uint8_t *buf;
+	int width;
+	int height;
+	int stride;
+	struct eink_rect damage; /* width == 0 when nothing was drawn */
+};
+
+/*
+ * Fixed-cell bitmap font. Each glyph is height rows of (width + 7) / 8
+ * bytes, MSB first. Glyphs are indexed from first, or by position in
+ * chars when that is set; unknown characters only advance.
+ */
+struct eink_font {
+	int width;
+	int height;
+	int advance;
+	unsigned char first;
+	unsigned char last;
+	const char *chars;
+	const uint8_t *glyphs;
+};
+
+/*
+ * A font expanded once to one scale, with a table from character to
+ * glyph. Text drawn from an atlas skips the glyph lookup and scaling, and
+ * glyphs that fit on the surface are written a whole byte at a time.
+ */
+struct eink_atlas {
+	int width;	/* glyph cell after scaling */
+	int height;
+	int advance;
+	int stride;	/* bytes per glyph row */
+	uint8_t *bits;
+	int16_t index[256];	/* -1 for characters the font lacks */
+};
+
+struct eink_display {
+	int fd;
+	size_t size;
+	struct fb_var_screeninfo vinfo;
+	struct fb_fix_screeninfo finfo;
+	struct eink_surface surface;
+};
+
+/* Display, these return -1 and leave errno set on failure */
+int eink_open(struct eink_display *disp, const char *device);
+void eink_close(struct eink_display *disp);
+int eink_set_mode(struct eink_display *disp, int mode);
+int eink_update(struct eink_display *disp);
+int eink_flush(struct eink_display *disp);
+
+/* Surfaces */
+void eink_surface_init(struct eink_surface *s, uint8_t *buf, int width,
+		       int height, int stride);
+void eink_damage(struct eink_surface *s, int x, int y, int width, int height);
+void eink_damage_clear(struct eink_surface *s);
+
+/* Primitives */
+void eink_fill(struct eink_surface *s, int color);
+void eink_pixel(struct eink_surface *s, int x, int y, int color);
+int eink_get_pixel(const struct eink_surface *s, int x, int y);
+void eink_fill_rect(struct eink_surface *s, int x, int y, int width,
+		    int height, int color);
+void eink_fill_pattern(struct eink_surface *s, int x, int y, int width,
+		       int height, const uint8_t *pattern, int rows, int color);
+void eink_hline(struct eink_surface *s, int x, int y, int width,
+		uint8_t pattern, int color);
+void eink_vline(struct eink_surface *s, int x, int y, int height,
+		uint8_t pattern, int color);
+void eink_rect(struct eink_surface *s, int x, int y, int width, int height,
+	       int color);
+void eink_line(struct eink_surface *s, int x0, int y0, int x1, int y1,
+	       int color);
+
+/* Bitmaps and text */
+void eink_blit(struct eink_surface *s, int x, int y, const uint8_t *bits,
+	       int width, int height, int src_stride, int color,
+	       unsigned int flags);
+void eink_blit_scaled(struct eink_surface *s, int x, int y,
+		      const uint8_t *bits, int width, int height,
+		      int src_stride, int scale, int color, unsigned int flags);
+int eink_glyph(struct eink_surface *s, const struct eink_font *font, int x,
+	       int y, int scale, char c, int color);
+int eink_text(struct eink_surface *s, const struct eink_font *font, int x,
+	      int y, int scale, const char *str, int color);
+
+/* Glyph atlases; init returns -1 and sets errno on failure */
+int eink_atlas_init(struct eink_atlas *atlas, const struct eink_font *font,
+		    int scale);
+void eink_atlas_free(struct eink_atlas *atlas);
+int eink_atlas_text(struct eink_surface *s, const struct eink_atlas *atlas,
+		    int x, int y, const char *str, int color);
+
+#endif /* _LIBEINK_H */
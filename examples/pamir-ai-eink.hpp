@@ -0,0 +1,576 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * pamir-ai-eink.hpp - Header-only C++ API for the Pamir AI e-ink framebuffer
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Panel<Width, Height, Rotation> fixes the framebuffer geometry at compile
+ * time. Width and Height are the panel as the driver reports it; Rotation
+ * turns the drawing coordinates, so Panel<128, 250, Rotation::R90> is a
+ * 250x128 landscape surface. With the stride and rotation known to the
+ * compiler, pixel addressing folds to constants inside drawing loops.
+ *
+ * Opening, mapping and the update ioctls throw std::system_error. Drawing
+ * never fails: it clips to the panel and grows a damage rectangle that
+ * update(DamageUpdate{}) refreshes as one byte-aligned partial area.
+ */
+
+#ifndef _PAMIR_AI_EINK_HPP
+#define _PAMIR_AI_EINK_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+#include "pamir-ai-eink.h"
+
+namespace pamir {
+namespace eink {
+
+/* Clockwise rotation of the drawing coordinates relative to the panel */
+enum class Rotation { R0, R90, R180, R270 };
+
+/* Black is a cleared bit in the framebuffer; Invert flips the pixel */
+enum class Color { White, Black, Invert };
+
+struct Rect {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+
+	constexpr bool empty() const noexcept
+	{
+		return width <= 0 || height <= 0;
+	}
+};
+
+/* Update requests, one per driver mode */
+struct FullUpdate {};
+struct FastUpdate {};
+struct BaseMapUpdate {};
+struct PartialUpdate {
+	Rect area; /* drawing coordinates, widened to whole bytes */
+};
+struct DamageUpdate {}; /* partial update of everything drawn since */
+
+namespace detail {
+
+inline void put(std::uint8_t *p, std::uint8_t mask, Color c) noexcept
+{
+	if (c == Color::Black)
+		*p &= static_cast<std::uint8_t>(~mask);
+	else if (c == Color::White)
+		*p |= mask;
+	else
+		*p ^= mask;
+}
+
+/*
+ * Pattern-fill n whole bytes. The pattern is the same in every byte, so
+ * working on 64-bit words is endian-neutral and the loop vectorizes.
+ */
+inline void fill_bytes(std::uint8_t *p, std::size_t n, std::uint8_t pattern,
+		       Color c) noexcept
+{
+	const std::uint64_t pat = 0x0101010101010101ull * pattern;
+
+	if (pattern == 0xFF && c != Color::Invert) {
+		std::memset(p, c == Color::Black ? 0x00 : 0xFF, n);
+		return;
+	}
+
+	for (; n >= 8; n -= 8, p += 8) {
+		std::uint64_t w;
+
+		std::memcpy(&w, p, 8);
+		if (c == Color::Black)
+			w &= ~pat;
+		else if (c == Color::White)
+			w |= pat;
+		else
+			w ^= pat;
+		std::memcpy(p, &w, 8);
+	}
+	for (; n; n--, p++)
+		put(p, pattern, c);
+}
+
+/* Pixels [x0, x1) of one framebuffer row, x0 < x1 */
+inline void span(std::uint8_t *row, int x0, int x1, std::uint8_t pattern,
+		 Color c) noexcept
+{
+	const int first = x0 >> 3;
+	const int last = (x1 - 1) >> 3;
+	const std::uint8_t head = 0xFF >> (x0 & 7);
+	const std::uint8_t tail = 0xFF << (7 - ((x1 - 1) & 7));
+
+	if (first == last) {
+		put(row + first, head & tail & pattern, c);
+		return;
+	}
+
+	put(row + first, head & pattern, c);
+	fill_bytes(row + first + 1, last - first - 1, pattern, c);
+	put(row + last, tail & pattern, c);
+}
+
+/* Eight bitmap bits starting at bit, which may be down to -7 */
+inline std::uint8_t bits_at(const std::uint8_t *src, int bit,
+			    int bytes) noexcept
+{
+	if (bit < 0)
+		return src[0] >> -bit;
+
+	const int i = bit >> 3;
+	const int shift = bit & 7;
+
+	if (!shift)
+		return src[i];
+
+	return static_cast<std::uint8_t>(
+		(src[i] << shift) |
+		(i + 1 < bytes ? src[i + 1] >> (8 - shift) : 0));
+}
+
+[[noreturn]] inline void throw_errno(const char *what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+} /* namespace detail */
+
+template <int Width, int Height, Rotation Rot = Rotation::R0>
+class Panel {
+	static_assert(Width > 0 && Height > 0, "panel needs a size");
+
+public:
+	/* Framebuffer geometry as the driver reports it */
+	static constexpr int panel_width = Width;
+	static constexpr int panel_height = Height;
+	static constexpr int stride = (Width + 7) / 8;
+	static constexpr std::size_t size = std::size_t(stride) * Height;
+
+	/* Drawing coordinates after rotation */
+	static constexpr bool swapped =
+		Rot == Rotation::R90 || Rot == Rotation::R270;
+	static constexpr int width = swapped ? Height : Width;
+	static constexpr int height = swapped ? Width : Height;
+
+	struct Point {
+		int x;
+		int y;
+	};
+
+	/* Drawing coordinates to framebuffer coordinates */
+	static constexpr Point to_panel(int x, int y) noexcept
+	{
+		switch (Rot) {
+		case Rotation::R90:
+			return { Width - 1 - y, x };
+		case Rotation::R180:
+			return { Width - 1 - x, Height - 1 - y };
+		case Rotation::R270:
+			return { y, Height - 1 - x };
+		default:
+			return { x, y };
+		}
+	}
+
+	static constexpr Rect to_panel(const Rect &r) noexcept
+	{
+		const Point a = to_panel(r.x, r.y);
+		const Point b = to_panel(r.x + r.width - 1, r.y + r.height - 1);
+		const int x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+
+		return { x0, y0, std::max(a.x, b.x) - x0 + 1,
+			 std::max(a.y, b.y) - y0 + 1 };
+	}
+
+	static constexpr std::size_t offset(int x, int y) noexcept
+	{
+		const Point p = to_panel(x, y);
+
+		return std::size_t(p.y) * stride + (p.x >> 3);
+	}
+
+	static constexpr std::uint8_t mask(int x, int y) noexcept
+	{
+		return 0x80 >> (to_panel(x, y).x & 7);
+	}
+
+	static constexpr bool contains(int x, int y) noexcept
+	{
+		return x >= 0 && x < width && y >= 0 && y < height;
+	}
+
+	explicit Panel(const char *device = "/dev/fb0")
+	{
+		struct fb_var_screeninfo vinfo;
+		struct fb_fix_screeninfo finfo;
+
+		fd_ = ::open(device, O_RDWR | O_CLOEXEC);
+		if (fd_ < 0)
+			detail::throw_errno(device);
+
+		if (::ioctl(fd_, FBIOGET_VSCREENINFO, &vinfo) < 0 ||
+		    ::ioctl(fd_, FBIOGET_FSCREENINFO, &finfo) < 0) {
+			close_fd();
+			detail::throw_errno("FBIOGET_SCREENINFO");
+		}
+
+		if (vinfo.xres != unsigned(Width) ||
+		    vinfo.yres != unsigned(Height) ||
+		    vinfo.bits_per_pixel != 1 ||
+		    finfo.line_length != unsigned(stride) ||
+		    finfo.smem_len < size) {
+			close_fd();
+			throw std::runtime_error(
+				std::string(device) + " is " +
+				std::to_string(vinfo.xres) + "x" +
+				std::to_string(vinfo.yres) + ", expected " +
+				std::to_string(Width) + "x" +
+				std::to_string(Height));
+		}
+
+		map_len_ = finfo.smem_len;
+		void *mem = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, fd_, 0);
+		if (mem == MAP_FAILED) {
+			close_fd();
+			detail::throw_errno("mmap");
+		}
+		mem_ = static_cast<std::uint8_t *>(mem);
+	}
+
+	~Panel()
+	{
+		release();
+	}
+
+	Panel(const Panel &) = delete;
+	Panel &operator=(const Panel &) = delete;
+
+	Panel(Panel &&other) noexcept
+		: fd_(std::exchange(other.fd_, -1)),
+		  mem_(std::exchange(other.mem_, nullptr)),
+		  map_len_(std::exchange(other.map_len_, 0)),
+		  damage_(std::exchange(other.damage_, Rect{}))
+	{
+	}
+
+	Panel &operator=(Panel &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			fd_ = std::exchange(other.fd_, -1);
+			mem_ = std::exchange(other.mem_, nullptr);
+			map_len_ = std::exchange(other.map_len_, 0);
+			damage_ = std::exchange(other.damage_, Rect{});
+		}
+		return *this;
+	}
+
+	int fd() const noexcept
+	{
+		return fd_;
+	}
+
+	std::uint8_t *data() noexcept
+	{
+		return mem_;
+	}
+
+	const std::uint8_t *data() const noexcept
+	{
+		return mem_;
+	}
+
+	/* Damage in framebuffer coordinates */
+	const Rect &damage() const noexcept
+	{
+		return damage_;
+	}
+
+	void clear_damage() noexcept
+	{
+		damage_ = Rect{};
+	}
+
+	/* Mark an area as changed, for callers writing to data() directly */
+	void add_damage(Rect r) noexcept
+	{
+		if (clip(r))
+			add_panel_damage(to_panel(r));
+	}
+
+	void pixel(int x, int y, Color c) noexcept
+	{
+		if (!contains(x, y))
+			return;
+
+		detail::put(mem_ + offset(x, y), mask(x, y), c);
+		const Point p = to_panel(x, y);
+		add_panel_damage({ p.x, p.y, 1, 1 });
+	}
+
+	Color pixel(int x, int y) const noexcept
+	{
+		if (!contains(x, y))
+			return Color::White;
+
+		return mem_[offset(x, y)] & mask(x, y) ? Color::White :
+							  Color::Black;
+	}
+
+	void fill(Color c) noexcept
+	{
+		fill_rect({ 0, 0, width, height }, c);
+	}
+
+	/*
+	 * Any rotation of a rectangle is a rectangle, so this is always a run
+	 * of row spans. pattern is anchored to framebuffer columns.
+	 */
+	void fill_rect(Rect r, Color c, std::uint8_t pattern = 0xFF) noexcept
+	{
+		if (!clip(r))
+			return;
+
+		const Rect p = to_panel(r);
+		std::uint8_t *row = mem_ + std::size_t(p.y) * stride;
+
+		for (int i = 0; i < p.height; i++, row += stride)
+			detail::span(row, p.x, p.x + p.width, pattern, c);
+
+		add_panel_damage(p);
+	}
+
+	void hline(int x, int y, int w, Color c) noexcept
+	{
+		fill_rect({ x, y, w, 1 }, c);
+	}
+
+	void vline(int x, int y, int h, Color c) noexcept
+	{
+		fill_rect({ x, y, 1, h }, c);
+	}
+
+	void rect(Rect r, Color c) noexcept
+	{
+		if (r.empty())
+			return;
+
+		hline(r.x, r.y, r.width, c);
+		if (r.height > 1)
+			hline(r.x, r.y + r.height - 1, r.width, c);
+		if (r.height > 2) {
+			vline(r.x, r.y + 1, r.height - 2, c);
+			if (r.width > 1)
+				vline(r.x + r.width - 1, r.y + 1, r.height - 2,
+				      c);
+		}
+	}
+
+	/*
+	 * Draw the set bits of a 1bpp MSB-first bitmap. Unrotated panels
+	 * shift whole bytes into place; rotated ones go pixel by pixel with
+	 * the constant-folded addressing.
+	 */
+	void blit(int x, int y, const std::uint8_t *bits, int w, int h,
+		  int src_stride, Color c) noexcept
+	{
+		Rect r{ x, y, w, h };
+
+		if (!clip(r))
+			return;
+
+		const std::uint8_t *src =
+			bits + std::size_t(r.y - y) * src_stride;
+
+		if constexpr (Rot == Rotation::R0) {
+			std::uint8_t *row = mem_ + std::size_t(r.y) * stride;
+			const int first = r.x >> 3;
+			const int last = (r.x + r.width - 1) >> 3;
+
+			for (int j = 0; j < r.height;
+			     j++, src += src_stride, row += stride) {
+				for (int i = first; i <= last; i++) {
+					std::uint8_t m = 0xFF;
+
+					if (i == first)
+						m &= 0xFF >> (r.x & 7);
+					if (i == last)
+						m &= 0xFF << (7 - ((r.x + r.width -
+								    1) & 7));
+					m &= detail::bits_at(src, i * 8 - x,
+							     src_stride);
+					detail::put(row + i, m, c);
+				}
+			}
+		} else {
+			for (int j = 0; j < r.height; j++, src += src_stride) {
+				for (int i = r.x - x; i < r.x - x + r.width;
+				     i++) {
+					if (src[i >> 3] & (0x80 >> (i & 7)))
+						detail::put(
+							mem_ + offset(x + i,
+								      r.y + j),
+							mask(x + i, r.y + j),
+							c);
+				}
+			}
+		}
+
+		add_panel_damage(to_panel(r));
+	}
+
+	void update(FullUpdate)
+	{
+		set_mode(EPD_MODE_FULL);
+		refresh();
+	}
+
+	void update(FastUpdate)
+	{
+		set_mode(EPD_MODE_FAST);
+		refresh();
+	}
+
+	void update(BaseMapUpdate)
+	{
+		if (::ioctl(fd_, EPD_IOC_SET_BASE_MAP, nullptr) < 0)
+			detail::throw_errno("EPD_IOC_SET_BASE_MAP");
+		clear_damage();
+	}
+
+	void update(PartialUpdate req)
+	{
+		if (!clip(req.area))
+			return;
+		partial(to_panel(req.area));
+	}
+
+	/* Nothing is sent when nothing was drawn */
+	void update(DamageUpdate)
+	{
+		if (!damage_.empty())
+			partial(damage_);
+	}
+
+	void clear_display()
+	{
+		if (::ioctl(fd_, EPD_IOC_CLEAR_DISPLAY) < 0)
+			detail::throw_errno("EPD_IOC_CLEAR_DISPLAY");
+	}
+
+	void deep_sleep()
+	{
+		if (::ioctl(fd_, EPD_IOC_DEEP_SLEEP) < 0)
+			detail::throw_errno("EPD_IOC_DEEP_SLEEP");
+	}
+
+private:
+	static bool clip(Rect &r) noexcept
+	{
+		const int x0 = std::max(r.x, 0), y0 = std::max(r.y, 0);
+		const int x1 = std::min(r.x + r.width, width);
+		const int y1 = std::min(r.y + r.height, height);
+
+		if (x0 >= x1 || y0 >= y1)
+			return false;
+
+		r = { x0, y0, x1 - x0, y1 - y0 };
+		return true;
+	}
+
+	void add_panel_damage(const Rect &p) noexcept
+	{
+		if (damage_.empty()) {
+			damage_ = p;
+			return;
+		}
+
+		const int x1 = std::max(damage_.x + damage_.width, p.x + p.width);
+		const int y1 =
+			std::max(damage_.y + damage_.height, p.y + p.height);
+
+		damage_.x = std::min(damage_.x, p.x);
+		damage_.y = std::min(damage_.y, p.y);
+		damage_.width = x1 - damage_.x;
+		damage_.height = y1 - damage_.y;
+	}
+
+	void set_mode(int mode)
+	{
+		if (::ioctl(fd_, EPD_IOC_SET_UPDATE_MODE, &mode) < 0)
+			detail::throw_errno("EPD_IOC_SET_UPDATE_MODE");
+	}
+
+	void refresh()
+	{
+		if (::ioctl(fd_, EPD_IOC_UPDATE_DISPLAY) < 0)
+			detail::throw_errno("EPD_IOC_UPDATE_DISPLAY");
+		clear_damage();
+	}
+
+	/* The driver only takes partial areas on whole bytes */
+	void partial(const Rect &p)
+	{
+		constexpr int aligned_width = Width & ~7;
+		struct epd_update_area area;
+		int x0 = p.x & ~7;
+		int x1 = std::min((p.x + p.width + 7) & ~7, aligned_width);
+
+		if (x1 <= x0) {
+			x1 = aligned_width;
+			x0 = std::max(x1 - 8, 0);
+		}
+
+		area.x = x0;
+		area.y = p.y;
+		area.width = x1 - x0;
+		area.height = p.height;
+
+		set_mode(EPD_MODE_PARTIAL);
+		if (::ioctl(fd_, EPD_IOC_SET_PARTIAL_AREA, &area) < 0)
+			detail::throw_errno("EPD_IOC_SET_PARTIAL_AREA");
+		refresh();
+	}
+
+	void close_fd() noexcept
+	{
+		if (fd_ >= 0)
+			::close(fd_);
+		fd_ = -1;
+	}
+
+	void release() noexcept
+	{
+		if (mem_)
+			::munmap(mem_, map_len_);
+		mem_ = nullptr;
+		close_fd();
+	}
+
+	int fd_ = -1;
+	std::uint8_t *mem_ = nullptr;
+	std::size_t map_len_ = 0;
+	Rect damage_;
+};
+
+} /* namespace eink */
+} /* namespace pamir */
+
+#endif /* _PAMIR_AI_EINK_HPP */
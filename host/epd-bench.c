@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay update traces against the userspace build of the driver core
+ *
+ * Each "flush" in the trace runs the same epd_display_update() path as
+ * the kernel module and reports the SPI traffic it generated, the
+ * simulated time on a real bus and the host CPU time it took. With -S the
+ * SSD168x model drives BUSY and the table also shows how many pixels are
+ * ghosted after each operation.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "epd-host.h"
+
+struct bench {
+	struct epd_host *host;
+	unsigned int frame;
+	struct epd_host_stats total;
+	u64 total_cpu_ns;
+	unsigned int line;
+};
+
+static u64 bench_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_set_pixel(struct epd_dev *epd, u8 *fb, u32 x, u32 y,
+			    int black)
+{
+	u8 *byte;
+
+	if (x >= epd->width || y >= epd->height)
+		return;
+
+	byte = &fb[y * epd->bytes_per_line + x / 8];
+	if (black)
+		*byte &= ~(0x80 >> (x % 8));
+	else
+		*byte |= 0x80 >> (x % 8);
+}
+
+static void bench_rect(struct bench *b, u32 x, u32 y, u32 w, u32 h,
+		       int black)
+{
+	struct epd_dev *epd = &b->host->epd;
+	u8 *fb = epd_host_fb(b->host);
+	u32 i, j;
+
+	for (j = y; j < y + h; j++)
+		for (i = x; i < x + w; i++)
+			bench_set_pixel(epd, fb, i, j, black);
+
+	epd_damage_add(epd, x, y, w, h);
+}
+
+static void bench_noise(struct bench *b, unsigned int seed)
+{
+	struct epd_dev *epd = &b->host->epd;
+	u8 *fb = epd_host_fb(b->host);
+	size_t i;
+
+	srand(seed);
+	for (i = 0; i < epd->screensize; i++)
+		fb[i] = rand() & 0xff;
+
+	epd_damage_add(epd, 0, 0, epd->width, epd->height);
+}
+
+static void bench_account(struct bench *b, const char *what, int ret,
+			  u64 cpu_ns)
+{
+	struct epd_host_stats *s = &b->host->stats;
+	char ghost[16] = "-";
+
+	if (b->host->sim)
+		snprintf(ghost, sizeof(ghost), "%u",
+			 epd_sim_ghosted(b->host->sim, NULL));
+
+	printf("%5u %-10s %4llu %5llu %9llu %6llu %10.2f %9.1f %7s%s\n",
+	       b->frame, what, (unsigned long long)s->cmd_xfers,
+	       (unsigned long long)s->data_xfers,
+	       (unsigned long long)s->data_bytes,
+	       (unsigned long long)s->busy_polls, s->sim_ns / 1e6,
+	       cpu_ns / 1e3, ghost, ret ? "  FAILED" : "");
+
+	b->total.cmd_xfers += s->cmd_xfers;
+	b->total.data_xfers += s->data_xfers;
+	b->total.data_bytes += s->data_bytes;
+	b->total.busy_polls += s->busy_polls;
+	b->total.sim_ns += s->sim_ns;
+	b->total_cpu_ns += cpu_ns;
+	b->frame++;
+}
+
+static const char *const bench_mode_names[] = {
+	[EPD_MODE_FULL] = "full",
+	[EPD_MODE_PARTIAL] = "partial",
+	[EPD_MODE_BASE_MAP] = "base_map",
+	[EPD_MODE_FAST] = "fast",
+};
+
+/* A trace flush stands for the refresh write() or fbcon would trigger */
+static int bench_flush(struct epd_dev *epd)
+{
+	return epd_display_update(epd, true);
+}
+
+static int bench_run(struct bench *b, const char *op,
+		     int (*fn)(struct epd_dev *))
+{
+	u64 start;
+	int ret;
+
+	epd_host_reset_stats(b->host);
+	start = bench_cpu_ns();
+	ret = fn(&b->host->epd);
+	bench_account(b, op, ret, bench_cpu_ns() - start);
+	return ret;
+}
+
+static int bench_png(struct bench *b, const char *path)
+{
+	struct epd_sim *sim = b->host->sim;
+	int ret;
+
+	if (!sim) {
+		fprintf(stderr, "%s: needs the panel model (-S)\n", path);
+		return -ENODEV;
+	}
+
+	ret = epd_png_write(path, sim->panel, sim->width, sim->height);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", path, strerror(-ret));
+	return ret;
+}
+
+static int bench_line(struct bench *b, char *line)
+{
+	struct epd_dev *epd = &b->host->epd;
+	unsigned int x, y, w, h, v;
+	char word[256];
+	size_t i;
+
+	line[strcspn(line, "#\n")] = '\0';
+	if (sscanf(line, "%255s", word) != 1)
+		return 0;
+
+	if (!strcmp(word, "init")) {
+		if (!bench_run(b, "init", epd_hw_init))
+			epd->initialized = true;
+		return 0;
+	}
+
+	/* Failed operations are reported in the table, not as trace errors */
+	if (!strcmp(word, "clear")) {
+		bench_run(b, "clear", epd_clear_display);
+		return 0;
+	}
+
+	if (!strcmp(word, "flush")) {
+		bench_run(b, bench_mode_names[epd->update_mode],
+			  bench_flush);
+		return 0;
+	}
+
+	if (!strcmp(word, "sleep")) {
+		bench_run(b, "sleep", epd_deep_sleep);
+		return 0;
+	}
+
+	if (!strcmp(word, "mode")) {
+		if (sscanf(line, "%*s %31s", word) != 1)
+			return -EINVAL;
+		for (i = 0; i < ARRAY_SIZE(bench_mode_names); i++) {
+			if (!strcmp(word, bench_mode_names[i])) {
+				epd->update_mode = i;
+				return 0;
+			}
+		}
+		return -EINVAL;
+	}
+
+	if (!strcmp(word, "area")) {
+		if (sscanf(line, "%*s %u %u %u %u", &x, &y, &w, &h) != 4) {
+			epd->partial_area_set = false;
+			return 0;
+		}
+		epd->partial_area.x = x;
+		epd->partial_area.y = y;
+		epd->partial_area.width = w;
+		epd->partial_area.height = h;
+		epd->partial_area_set = true;
+		return 0;
+	}
+
+	if (!strcmp(word, "fill")) {
+		if (sscanf(line, "%*s %u", &v) != 1)
+			return -EINVAL;
+		bench_rect(b, 0, 0, epd->width, epd->height, v);
+		return 0;
+	}
+
+	if (!strcmp(word, "rect")) {
+		if (sscanf(line, "%*s %u %u %u %u %u", &x, &y, &w, &h, &v) != 5)
+			return -EINVAL;
+		bench_rect(b, x, y, w, h, v);
+		return 0;
+	}
+
+	if (!strcmp(word, "noise")) {
+		if (sscanf(line, "%*s %u", &v) != 1)
+			v = b->frame;
+		bench_noise(b, v);
+		return 0;
+	}
+
+	if (!strcmp(word, "png")) {
+		if (sscanf(line, "%*s %255s", word) != 1)
+			return -EINVAL;
+		bench_png(b, word);
+		return 0;
+	}
+
+	if (!strcmp(word, "spi_hz")) {
+		if (sscanf(line, "%*s %u", &v) != 1 || !v)
+			return -EINVAL;
+		b->host->spi_hz = v;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] TRACE\n"
+		"  -c NAME   controller: ssd1680 (default), ssd1683, uc8179\n"
+		"  -W PIXELS panel width (default 128)\n"
+		"  -H PIXELS panel height (default 250)\n"
+		"  -s HZ     SPI clock (default 20000000)\n"
+		"  -b MODE   SPI bus mode: queued, shared, exclusive\n"
+		"  -t BYTES  controller max transfer size\n"
+		"  -S        simulate an SSD168x panel, which drives BUSY\n"
+		"  -T DEGC   ambient temperature for -S (default 25)\n"
+		"  -p FILE   write the final panel state as PNG (needs -S)\n"
+		"  -r FILE   record the command stream for epd-replay\n"
+		"  -v        print driver messages\n"
+		"\n"
+		"Trace lines: init, clear, sleep, flush, mode NAME,\n"
+		"area X Y W H | area, fill 0|1, rect X Y W H 0|1, noise [SEED],\n"
+		"spi_hz HZ, png FILE. Everything after # is a comment.\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *ctrl_name = "ssd1680";
+	const struct epd_controller *ctrl;
+	unsigned long width = 128, height = 250, spi_hz = 0, max_xfer = 0;
+	int bus_mode = EPD_BUS_QUEUED;
+	const char *png = NULL, *record = NULL;
+	bool simulate = false;
+	int ambient = 25;
+	struct bench b = { 0 };
+	char line[256];
+	FILE *trace;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "c:W:H:s:b:t:ST:p:r:vh")) != -1) {
+		switch (opt) {
+		case 'c':
+			ctrl_name = optarg;
+			break;
+		case 'W':
+			width = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			height = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			spi_hz = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			for (bus_mode = 0; epd_bus_mode_names[bus_mode];
+			     bus_mode++) {
+				if (!strcmp(epd_bus_mode_names[bus_mode],
+					    optarg))
+					break;
+			}
+			if (!epd_bus_mode_names[bus_mode]) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 't':
+			max_xfer = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			simulate = true;
+			break;
+		case 'T':
+			ambient = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			png = optarg;
+			break;
+		case 'r':
+			record = optarg;
+			break;
+		case 'v':
+			epd_host_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1 || !width || !height || (png && !simulate)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ctrl = epd_host_controller(ctrl_name);
+	if (!ctrl) {
+		fprintf(stderr, "Unknown controller '%s'\n", ctrl_name);
+		return 1;
+	}
+
+	trace = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+	if (!trace) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	b.host = epd_host_create(ctrl, width, height);
+	if (!b.host) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	b.host->epd.bus_mode = bus_mode;
+	if (spi_hz)
+		b.host->spi_hz = spi_hz;
+	if (max_xfer)
+		b.host->spi.max_transfer_size = max_xfer;
+	if (simulate) {
+		ret = epd_host_attach_sim(b.host, ambient);
+		if (ret == -EOPNOTSUPP)
+			fprintf(stderr, "-S does not model the %s\n", ctrl->name);
+		else if (ret)
+			fprintf(stderr, "Out of memory\n");
+		if (ret) {
+			epd_host_destroy(b.host);
+			return 1;
+		}
+	}
+	if (record && epd_host_record(b.host, record)) {
+		perror(record);
+		epd_host_destroy(b.host);
+		return 1;
+	}
+
+	printf("# %s %lux%lu, SPI %u Hz, %s bus\n", ctrl->name, width, height,
+	       b.host->spi_hz, epd_bus_mode_names[bus_mode]);
+	printf("%5s %-10s %4s %5s %9s %6s %10s %9s %7s\n", "frame", "op", "cmds",
+	       "xfers", "bytes", "polls", "sim_ms", "cpu_us", "ghost");
+
+	while (fgets(line, sizeof(line), trace)) {
+		b.line++;
+		if (bench_line(&b, line) == -EINVAL) {
+			fprintf(stderr, "%s:%u: bad trace line\n", argv[optind],
+				b.line);
+			ret = 1;
+			break;
+		}
+	}
+
+	printf("total: %u ops, %llu cmds, %llu xfers, %llu bytes, %.2f ms simulated, %.1f us cpu\n",
+	       b.frame, (unsigned long long)b.total.cmd_xfers,
+	       (unsigned long long)b.total.data_xfers,
+	       (unsigned long long)b.total.data_bytes, b.total.sim_ns / 1e6,
+	       b.total_cpu_ns / 1e3);
+	if (b.frame)
+		printf("per op: %.1f bytes, %.2f ms simulated, %.1f us cpu\n",
+		       (double)b.total.data_bytes / b.frame,
+		       b.total.sim_ns / 1e6 / b.frame,
+		       b.total_cpu_ns / 1e3 / b.frame);
+
+	if (b.host->sim) {
+		struct epd_sim *sim = b.host->sim;
+		u32 ghosted, max_error;
+
+		ghosted = epd_sim_ghosted(sim, &max_error);
+		printf("panel: %u refreshes (%u full, %u fast, %u partial), %.2f ms busy, %u busy violations\n",
+		       sim->stats.refreshes, sim->stats.full, sim->stats.fast,
+		       sim->stats.partial, sim->stats.busy_ns / 1e6,
+		       sim->stats.busy_violations);
+		printf("ghosting: %u of %u pixels, max error %u\n", ghosted,
+		       sim->width * sim->height, max_error);
+		if (png && bench_png(&b, png))
+			ret = 1;
+	}
+
+	epd_host_destroy(b.host);
+	if (trace != stdin)
+		fclose(trace);
+	return ret;
+}
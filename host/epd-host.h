@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Userspace build of the Pamir AI E-Ink driver core
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#ifndef _EPD_HOST_H
+#define _EPD_HOST_H
+
+#include "pamir-ai-eink-internal.h"
+#include "pamir-ai-eink-sim.h"
+
+struct epd_host_stats {
+	u64 cmd_xfers;
+	u64 data_xfers;
+	u64 data_bytes;
+	u64 busy_polls;
+	u64 sim_ns;	/* SPI clocking, sleeps and BUSY waits */
+};
+
+/*
+ * Optional panel model fed with the command stream. Without one, BUSY is
+ * never asserted.
+ */
+struct epd_host_model {
+	void (*reset)(void *ctx);
+	void (*cmd)(void *ctx, u8 cmd, u64 now_ns);
+	void (*data)(void *ctx, const u8 *buf, size_t len, u64 now_ns);
+	bool (*busy)(void *ctx, u64 now_ns);
+	void *ctx;
+};
+
+struct epd_host {
+	struct epd_dev epd;
+	struct spi_device spi;
+	struct spi_controller ctlr;
+	struct fb_info info;
+	u32 spi_hz;
+	u32 xfer_overhead_ns;	/* Per transfer setup cost */
+	bool dc;
+	bool reset;
+	u64 now_ns;		/* Simulated clock, never reset */
+	struct epd_host_stats stats;
+	struct epd_host_model model;
+	struct epd_sim *sim;	/* Set by epd_host_attach_sim() */
+	FILE *record;		/* Capture in the debugfs trace format */
+	u64 record_start_ns;
+	u64 wait_start_ns;
+	bool waiting;
+};
+
+const struct epd_controller *epd_host_controller(const char *name);
+struct epd_host *epd_host_create(const struct epd_controller *ctrl,
+				 u32 width, u32 height);
+void epd_host_destroy(struct epd_host *host);
+void epd_host_reset_stats(struct epd_host *host);
+int epd_host_attach_sim(struct epd_host *host, int ambient_temp);
+int epd_host_record(struct epd_host *host, const char *path);
+
+int epd_png_write(const char *path, const u8 *grey, u32 width, u32 height);
+
+static inline u8 *epd_host_fb(struct epd_host *host)
+{
+	return (u8 *)host->info.screen_base;
+}
+
+#endif /* _EPD_HOST_H */
@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay a debugfs command stream capture against the SSD168x model
+ *
+ * Events are fed at their recorded times. At each BUSY wait the time the
+ * panel actually took is compared with the model's estimate; when the
+ * model is slower, the rest of the capture is shifted so later commands
+ * do not land while it is still busy.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <getopt.h>
+
+#include "epd-host.h"
+
+struct replay {
+	struct epd_sim *sim;
+	s64 skew_ns;
+	unsigned int line;
+	bool no_payload;
+	bool verbose;
+	u8 *data;
+	size_t data_max;
+
+	unsigned long cmds;
+	unsigned long datas;
+	unsigned long long bytes;
+	unsigned long waits;
+	unsigned long resets;
+	unsigned long long recorded_ms;
+	unsigned long long model_ms;
+};
+
+static int replay_hex(u8 *dst, const char *hex, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		unsigned int v;
+
+		if (sscanf(hex + 2 * i, "%2x", &v) != 1)
+			return -EINVAL;
+		dst[i] = v;
+	}
+
+	return 0;
+}
+
+static int replay_line(struct replay *r, char *line)
+{
+	unsigned long long time_us;
+	unsigned int v;
+	int code;
+	char event[8];
+	u64 now;
+	int n = 0;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	if (!*line || *line == '#')
+		return 0;
+
+	if (sscanf(line, "%llu %7s %n", &time_us, event, &n) != 2 || !n)
+		return -EINVAL;
+	line += n;
+	now = time_us * 1000 + r->skew_ns;
+
+	if (!strcmp(event, "cmd")) {
+		if (sscanf(line, "%x", &v) != 1)
+			return -EINVAL;
+		epd_sim_cmd(r->sim, v, now);
+		r->cmds++;
+		return 0;
+	}
+
+	if (!strcmp(event, "data")) {
+		n = 0;
+		if (sscanf(line, "%u %n", &v, &n) != 1)
+			return -EINVAL;
+		if (v > r->data_max) {
+			u8 *data = realloc(r->data, v);
+
+			if (!data)
+				return -ENOMEM;
+			r->data = data;
+			r->data_max = v;
+		}
+
+		if (strlen(line + n) == 2 * (size_t)v) {
+			if (replay_hex(r->data, line + n, v))
+				return -EINVAL;
+		} else {
+			/* RAM contents are lost, timing still replays */
+			memset(r->data, 0xFF, v);
+			r->no_payload = true;
+		}
+
+		epd_sim_data(r->sim, r->data, v, now);
+		r->datas++;
+		r->bytes += v;
+		return 0;
+	}
+
+	if (!strcmp(event, "busy")) {
+		u64 wait_start, model_end;
+
+		if (sscanf(line, "%u %d", &v, &code) != 2)
+			return -EINVAL;
+
+		wait_start = now - min(now, (u64)v * 1000000);
+		model_end = max(r->sim->busy_until_ns, wait_start);
+		if (model_end > now)
+			r->skew_ns += model_end - now;
+
+		r->waits++;
+		r->recorded_ms += v;
+		r->model_ms += (model_end - wait_start) / 1000000;
+		if (r->verbose)
+			printf("%6u %12u %10llu%s\n", r->line, v,
+			       (unsigned long long)(model_end - wait_start) /
+				       1000000,
+			       code ? "  TIMEOUT" : "");
+		return 0;
+	}
+
+	if (!strcmp(event, "reset")) {
+		epd_sim_reset(r->sim);
+		r->resets++;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] CAPTURE\n"
+		"  -W PIXELS panel width (default: from the capture header)\n"
+		"  -H PIXELS panel height (default: from the capture header)\n"
+		"  -T DEGC   ambient temperature (default 25)\n"
+		"  -p FILE   write the final panel state as PNG\n"
+		"  -v        compare every BUSY wait\n"
+		"\n"
+		"CAPTURE is the trace file from debugfs, see README.md.\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long width = 0, height = 0;
+	struct replay r = { 0 };
+	const char *png = NULL;
+	char ctrl[32] = "";
+	int ambient = 25;
+	char *line = NULL;
+	size_t line_cap = 0;
+	FILE *capture;
+	int opt, ret = 0;
+	u32 ghosted, max_error;
+
+	while ((opt = getopt(argc, argv, "W:H:T:p:vh")) != -1) {
+		switch (opt) {
+		case 'W':
+			width = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			height = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			ambient = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			png = optarg;
+			break;
+		case 'v':
+			r.verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	capture = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+	if (!capture) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	/* "# pamir-ai-eink <controller> <width>x<height>" */
+	if (getline(&line, &line_cap, capture) > 0) {
+		unsigned int w, h;
+
+		if (sscanf(line, "# pamir-ai-eink %31s %ux%u", ctrl, &w,
+			   &h) == 3) {
+			if (!width)
+				width = w;
+			if (!height)
+				height = h;
+		}
+		r.line++;
+	}
+
+	if (ctrl[0] && strncmp(ctrl, "ssd168", 6)) {
+		fprintf(stderr, "%s: only SSD168x captures can be modelled\n",
+			ctrl);
+		ret = 1;
+		goto out_close;
+	}
+
+	if (!width || !height) {
+		fprintf(stderr, "No panel size in the capture, use -W and -H\n");
+		ret = 1;
+		goto out_close;
+	}
+
+	r.sim = calloc(1, sizeof(*r.sim) + epd_sim_mem_size(width, height));
+	if (!r.sim) {
+		fprintf(stderr, "Out of memory\n");
+		ret = 1;
+		goto out_close;
+	}
+	epd_sim_init(r.sim, width, height, r.sim + 1);
+	r.sim->ambient_temp = ambient;
+	epd_sim_reset(r.sim);
+
+	printf("# %s %lux%lu, %d C\n", ctrl[0] ? ctrl : "ssd168x", width,
+	       height, ambient);
+	if (r.verbose)
+		printf("%6s %12s %10s\n", "line", "recorded_ms", "model_ms");
+
+	/* The header line may also be a plain event */
+	if (line && !ctrl[0] && replay_line(&r, line) == -EINVAL) {
+		fprintf(stderr, "%s:%u: bad capture line\n", argv[optind],
+			r.line);
+		ret = 1;
+		goto out_free;
+	}
+
+	while (getline(&line, &line_cap, capture) > 0) {
+		r.line++;
+		ret = replay_line(&r, line);
+		if (ret) {
+			fprintf(stderr, "%s:%u: %s\n", argv[optind], r.line,
+				ret == -ENOMEM ? "out of memory" :
+						 "bad capture line");
+			ret = 1;
+			goto out_free;
+		}
+	}
+
+	printf("events: %lu cmds, %lu data (%llu bytes), %lu busy waits, %lu resets\n",
+	       r.cmds, r.datas, r.bytes, r.waits, r.resets);
+	printf("busy: %llu ms recorded, %llu ms modelled\n", r.recorded_ms,
+	       r.model_ms);
+	printf("panel: %u refreshes (%u full, %u fast, %u partial), %u busy violations\n",
+	       r.sim->stats.refreshes, r.sim->stats.full, r.sim->stats.fast,
+	       r.sim->stats.partial, r.sim->stats.busy_violations);
+
+	if (r.no_payload) {
+		printf("capture has no payload, panel contents not reproduced\n");
+	} else {
+		ghosted = epd_sim_ghosted(r.sim, &max_error);
+		printf("ghosting: %u of %lu pixels, max error %u\n", ghosted,
+		       width * height, max_error);
+		if (png) {
+			ret = epd_png_write(png, r.sim->panel, width, height);
+			if (ret) {
+				fprintf(stderr, "%s: %s\n", png,
+					strerror(-ret));
+				ret = 1;
+			}
+		}
+	}
+
+out_free:
+	free(r.data);
+	free(r.sim);
+out_close:
+	free(line);
+	if (capture != stdin)
+		fclose(capture);
+	return ret;
+}
@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Kernel API shims for the userspace build of the Pamir AI E-Ink driver
+ *
+ * Just enough of the kernel for pamir-ai-eink-display.c, -hw.c and the
+ * controller files to compile unchanged. SPI, GPIO and sleeps are routed
+ * to shim.c, which records the traffic and keeps a simulated clock.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#ifndef _EPD_HOST_SHIM_H
+#define _EPD_HOST_SHIM_H
+
+#include <linux/types.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef __s8 s8;
+typedef __u8 u8;
+typedef __u16 u16;
+typedef __u32 u32;
+typedef __u64 u64;
+typedef __s32 s32;
+typedef __s64 s64;
+typedef s64 ktime_t;
+
+#define BIT(n) (1UL << (n))
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define round_up(x, y) ((((x) - 1) | ((__typeof__(x))((y) - 1))) + 1)
+#define round_down(x, y) ((x) & ~((__typeof__(x))((y) - 1)))
+#define PAGE_SIZE 4096UL
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+#define min(a, b)                                                   \
+	({                                                          \
+		__typeof__(a) _a = (a);                             \
+		__typeof__(b) _b = (b);                             \
+		_a < _b ? _a : _b;                                  \
+	})
+#define max(a, b)                                                   \
+	({                                                          \
+		__typeof__(a) _a = (a);                             \
+		__typeof__(b) _b = (b);                             \
+		_a > _b ? _a : _b;                                  \
+	})
+#define clamp(v, lo, hi) min(max(v, lo), hi)
+#define min_t(t, a, b) min((t)(a), (t)(b))
+#define max_t(t, a, b) max((t)(a), (t)(b))
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define READ_ONCE(x) (*(volatile __typeof__(x) *)&(x))
+#define cmpxchg(ptr, old, new) __sync_val_compare_and_swap(ptr, old, new)
+
+typedef struct {
+	int counter;
+} atomic_t;
+
+static inline void atomic_set(atomic_t *v, int i)
+{
+	__atomic_store_n(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline bool atomic_sub_and_test(int i, atomic_t *v)
+{
+	return __atomic_sub_fetch(&v->counter, i, __ATOMIC_SEQ_CST) == 0;
+}
+
+static inline bool atomic_dec_and_test(atomic_t *v)
+{
+	return atomic_sub_and_test(1, v);
+}
+
+/* Logging */
+
+struct device {
+	const char *name;
+};
+
+extern int epd_host_verbose;
+
+#define dev_err(dev, fmt, ...) \
+	fprintf(stderr, "%s: " fmt, (dev)->name, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...) \
+	fprintf(stderr, "%s: " fmt, (dev)->name, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)                                          \
+	do {                                                             \
+		if (epd_host_verbose)                                    \
+			fprintf(stderr, "%s: " fmt, (dev)->name,         \
+				##__VA_ARGS__);                          \
+	} while (0)
+#define dev_dbg(dev, fmt, ...) do { } while (0)
+#define pr_err(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+
+/* Memory */
+
+#define GFP_KERNEL 0
+#define kmalloc(size, gfp) malloc(size)
+#define kzalloc(size, gfp) calloc(1, size)
+#define kvcalloc(n, size, gfp) calloc(n, size)
+#define kfree(p) free(p)
+#define kvfree(p) free(p)
+
+/* Locking */
+
+struct mutex {
+	pthread_mutex_t m;
+};
+
+#define mutex_init(l) pthread_mutex_init(&(l)->m, NULL)
+#define mutex_lock(l) pthread_mutex_lock(&(l)->m)
+#define mutex_unlock(l) pthread_mutex_unlock(&(l)->m)
+
+typedef struct {
+	pthread_mutex_t m;
+} spinlock_t;
+
+#define spin_lock_init(l) pthread_mutex_init(&(l)->m, NULL)
+#define spin_lock(l) pthread_mutex_lock(&(l)->m)
+#define spin_unlock(l) pthread_mutex_unlock(&(l)->m)
+#define spin_lock_irqsave(l, flags) \
+	do { (flags) = 0; spin_lock(l); } while (0)
+#define spin_unlock_irqrestore(l, flags) \
+	do { (void)(flags); spin_unlock(l); } while (0)
+
+struct completion {
+	pthread_mutex_t m;
+	pthread_cond_t c;
+	bool done;
+};
+
+static inline void init_completion(struct completion *x)
+{
+	pthread_mutex_init(&x->m, NULL);
+	pthread_cond_init(&x->c, NULL);
+	x->done = false;
+}
+
+static inline void complete(struct completion *x)
+{
+	pthread_mutex_lock(&x->m);
+	x->done = true;
+	pthread_cond_broadcast(&x->c);
+	pthread_mutex_unlock(&x->m);
+}
+
+static inline void wait_for_completion(struct completion *x)
+{
+	pthread_mutex_lock(&x->m);
+	while (!x->done)
+		pthread_cond_wait(&x->c, &x->m);
+	pthread_mutex_unlock(&x->m);
+}
+
+/* Only embedded in struct epd_dev; the flush worker is not built here */
+
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+struct kthread_worker;
+
+struct kthread_work {
+	void (*func)(struct kthread_work *work);
+};
+
+struct kthread_delayed_work {
+	struct kthread_work work;
+};
+
+struct delayed_work {
+	int unused;
+};
+
+typedef struct {
+	int unused;
+} wait_queue_head_t;
+
+struct fb_info {
+	char *screen_base;
+};
+
+struct fb_ops;
+struct attribute_group;
+
+/* Time, advanced by the simulated clock rather than slept */
+
+void epd_host_delay_us(unsigned long us);
+
+#define usleep_range(min, max) epd_host_delay_us(min)
+#define udelay(us) epd_host_delay_us(us)
+#define msleep(ms) epd_host_delay_us((ms) * 1000UL)
+#define cond_resched() do { } while (0)
+
+/* GPIO */
+
+struct gpio_desc;
+
+void gpiod_set_value_cansleep(struct gpio_desc *desc, int value);
+int gpiod_get_value_cansleep(struct gpio_desc *desc);
+
+/* SPI, completed synchronously */
+
+struct spi_controller {
+	int unused;
+};
+
+struct spi_device {
+	struct device dev;
+	struct spi_controller *controller;
+	size_t max_transfer_size;
+};
+
+struct spi_transfer {
+	const void *tx_buf;
+	void *rx_buf;
+	unsigned int len;
+};
+
+struct spi_message {
+	struct spi_transfer *xfers;
+	unsigned int nr_xfers;
+	void (*complete)(void *context);
+	void *context;
+	int status;
+};
+
+static inline void spi_message_init_with_transfers(struct spi_message *m,
+						   struct spi_transfer *xfers,
+						   unsigned int num_xfers)
+{
+	memset(m, 0, sizeof(*m));
+	m->xfers = xfers;
+	m->nr_xfers = num_xfers;
+}
+
+static inline size_t spi_max_transfer_size(struct spi_device *spi)
+{
+	return spi->max_transfer_size;
+}
+
+int spi_sync(struct spi_device *spi, struct spi_message *message);
+int spi_async(struct spi_device *spi, struct spi_message *message);
+
+#define spi_sync_locked(spi, message) spi_sync(spi, message)
+#define spi_bus_lock(ctlr) do { (void)(ctlr); } while (0)
+#define spi_bus_unlock(ctlr) do { (void)(ctlr); } while (0)
+
+#endif /* _EPD_HOST_SHIM_H */
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Minimal 8-bit greyscale PNG writer for panel snapshots
+ *
+ * Image data goes into uncompressed deflate blocks, which keeps this free
+ * of a zlib dependency at the cost of file size.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include "epd-host.h"
+
+#define PNG_STORED_MAX 65535
+
+struct png_out {
+	FILE *f;
+	u32 crc;
+	u32 adler_a;
+	u32 adler_b;
+};
+
+static u32 png_crc_table[256];
+
+static void png_crc_init(void)
+{
+	u32 c, n, k;
+
+	if (png_crc_table[1])
+		return;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		png_crc_table[n] = c;
+	}
+}
+
+static void png_put(struct png_out *out, const void *buf, size_t len)
+{
+	const u8 *p = buf;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		out->crc = png_crc_table[(out->crc ^ p[i]) & 0xff] ^
+			   (out->crc >> 8);
+	fwrite(buf, 1, len, out->f);
+}
+
+static void png_put_u32(struct png_out *out, u32 v)
+{
+	u8 b[4] = { v >> 24, v >> 16, v >> 8, v };
+
+	png_put(out, b, sizeof(b));
+}
+
+/* The length is outside the CRC, the type is inside it */
+static void png_chunk_begin(struct png_out *out, const char *type, u32 len)
+{
+	u8 b[4] = { len >> 24, len >> 16, len >> 8, len };
+
+	fwrite(b, 1, sizeof(b), out->f);
+	out->crc = 0xFFFFFFFF;
+	png_put(out, type, 4);
+}
+
+static void png_chunk_end(struct png_out *out)
+{
+	png_put_u32(out, out->crc ^ 0xFFFFFFFF);
+}
+
+static void png_put_image(struct png_out *out, const u8 *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		out->adler_a = (out->adler_a + buf[i]) % 65521;
+		out->adler_b = (out->adler_b + out->adler_a) % 65521;
+	}
+	png_put(out, buf, len);
+}
+
+int epd_png_write(const char *path, const u8 *grey, u32 width, u32 height)
+{
+	static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n',
+					 0x1A, '\n' };
+	/* Each row is prefixed with filter type 0 */
+	size_t raw = (size_t)(width + 1) * height;
+	size_t blocks = DIV_ROUND_UP(raw, PNG_STORED_MAX);
+	struct png_out out = { .adler_a = 1 };
+	size_t left = raw, row_off = 0;
+	u32 y = 0;
+	u8 hdr[13];
+
+	if (!width || !height || !blocks)
+		return -EINVAL;
+
+	out.f = fopen(path, "wb");
+	if (!out.f)
+		return -errno;
+
+	png_crc_init();
+	fwrite(signature, 1, sizeof(signature), out.f);
+
+	png_chunk_begin(&out, "IHDR", sizeof(hdr));
+	png_put_u32(&out, width);
+	png_put_u32(&out, height);
+	hdr[0] = 8;	/* Bit depth */
+	hdr[1] = 0;	/* Greyscale */
+	hdr[2] = 0;	/* Deflate */
+	hdr[3] = 0;	/* Adaptive filtering */
+	hdr[4] = 0;	/* No interlace */
+	png_put(&out, hdr, 5);
+	png_chunk_end(&out);
+
+	/* zlib header, stored blocks of up to 64K, Adler-32 trailer */
+	png_chunk_begin(&out, "IDAT", 2 + blocks * 5 + raw + 4);
+	hdr[0] = 0x78;
+	hdr[1] = 0x01;
+	png_put(&out, hdr, 2);
+
+	while (left) {
+		u16 len = min_t(size_t, left, PNG_STORED_MAX);
+		u16 block_left = len;
+
+		left -= len;
+		hdr[0] = !left;
+		hdr[1] = len & 0xff;
+		hdr[2] = len >> 8;
+		hdr[3] = ~len & 0xff;
+		hdr[4] = (u16)~len >> 8;
+		png_put(&out, hdr, 5);
+
+		/* Rows may straddle block boundaries */
+		while (block_left) {
+			size_t n;
+
+			if (!row_off) {
+				hdr[0] = 0;
+				png_put_image(&out, hdr, 1);
+				block_left--;
+				row_off = 1;
+				continue;
+			}
+
+			n = min_t(size_t, block_left, width + 1 - row_off);
+			png_put_image(&out, grey + (size_t)y * width +
+						    row_off - 1, n);
+			block_left -= n;
+			row_off += n;
+			if (row_off == width + 1) {
+				row_off = 0;
+				y++;
+			}
+		}
+	}
+
+	png_put_u32(&out, out.adler_b << 16 | out.adler_a);
+	png_chunk_end(&out);
+
+	png_chunk_begin(&out, "IEND", 0);
+	png_chunk_end(&out);
+
+	if (fclose(out.f))
+		return -errno;
+	return 0;
+}
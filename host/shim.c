@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Kernel API shims for the userspace build of the Pamir AI E-Ink driver
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <stdarg.h>
+
+#include "epd-host.h"
+
+#define EPD_HOST_SPI_HZ_DEFAULT 20000000
+#define EPD_HOST_XFER_OVERHEAD_NS_DEFAULT 10000
+
+enum {
+	EPD_HOST_GPIO_RESET,
+	EPD_HOST_GPIO_DC,
+	EPD_HOST_GPIO_BUSY,
+};
+
+struct gpio_desc {
+	int line;
+};
+
+static struct gpio_desc epd_host_gpios[] = {
+	[EPD_HOST_GPIO_RESET] = { EPD_HOST_GPIO_RESET },
+	[EPD_HOST_GPIO_DC] = { EPD_HOST_GPIO_DC },
+	[EPD_HOST_GPIO_BUSY] = { EPD_HOST_GPIO_BUSY },
+};
+
+int epd_host_verbose;
+
+/* GPIOs and sleeps are not tied to a device, so one panel at a time */
+static struct epd_host *epd_host_current;
+
+static void epd_host_advance(struct epd_host *host, u64 ns)
+{
+	host->now_ns += ns;
+	host->stats.sim_ns += ns;
+}
+
+static void epd_host_record_event(struct epd_host *host, const char *fmt,
+				  ...)
+{
+	va_list args;
+
+	if (!host->record)
+		return;
+
+	fprintf(host->record, "%llu ",
+		(unsigned long long)(host->now_ns - host->record_start_ns) /
+			1000);
+	va_start(args, fmt);
+	vfprintf(host->record, fmt, args);
+	va_end(args);
+}
+
+static void epd_host_record_data(struct epd_host *host, const u8 *buf,
+				 size_t len)
+{
+	size_t i;
+
+	if (!host->record)
+		return;
+
+	epd_host_record_event(host, "data %zu ", len);
+	for (i = 0; i < len; i++)
+		fprintf(host->record, "%02x", buf[i]);
+	fputc('\n', host->record);
+}
+
+void epd_host_delay_us(unsigned long us)
+{
+	if (epd_host_current)
+		epd_host_advance(epd_host_current, (u64)us * 1000);
+}
+
+void gpiod_set_value_cansleep(struct gpio_desc *desc, int value)
+{
+	struct epd_host *host = epd_host_current;
+
+	if (!desc || !host)
+		return;
+
+	switch (desc->line) {
+	case EPD_HOST_GPIO_DC:
+		host->dc = value;
+		break;
+	case EPD_HOST_GPIO_RESET:
+		if (!value && host->reset)
+			epd_host_record_event(host, "reset\n");
+		/* Rising edge ends the reset pulse */
+		if (value && !host->reset && host->model.reset)
+			host->model.reset(host->model.ctx);
+		host->reset = value;
+		break;
+	}
+}
+
+int gpiod_get_value_cansleep(struct gpio_desc *desc)
+{
+	struct epd_host *host = epd_host_current;
+	int busy;
+
+	if (!desc || !host || desc->line != EPD_HOST_GPIO_BUSY)
+		return 0;
+
+	host->stats.busy_polls++;
+	if (!host->waiting) {
+		host->waiting = true;
+		host->wait_start_ns = host->now_ns;
+	}
+
+	busy = host->model.busy ? host->model.busy(host->model.ctx,
+						    host->now_ns) : 0;
+	if (!busy) {
+		/* Same granularity as the elapsed time epd_wait_busy() keeps */
+		epd_host_record_event(host, "busy %llu 0\n",
+				      (unsigned long long)(host->now_ns -
+							   host->wait_start_ns) /
+					      1000000);
+		host->waiting = false;
+	}
+
+	return busy;
+}
+
+int spi_sync(struct spi_device *spi, struct spi_message *message)
+{
+	struct epd_host *host = container_of(spi, struct epd_host, spi);
+	unsigned int i;
+
+	for (i = 0; i < message->nr_xfers; i++) {
+		struct spi_transfer *xfer = &message->xfers[i];
+		const u8 *tx = xfer->tx_buf;
+
+		epd_host_advance(host, host->xfer_overhead_ns +
+				 (u64)xfer->len * 8 * 1000000000ULL /
+					 host->spi_hz);
+
+		if (host->dc) {
+			epd_host_record_data(host, tx, xfer->len);
+			host->stats.data_xfers++;
+			host->stats.data_bytes += xfer->len;
+			if (host->model.data)
+				host->model.data(host->model.ctx, tx, xfer->len,
+						 host->now_ns);
+		} else {
+			if (xfer->len)
+				epd_host_record_event(host, "cmd 0x%02x\n",
+						      tx[xfer->len - 1]);
+			host->stats.cmd_xfers++;
+			if (host->model.cmd && xfer->len)
+				host->model.cmd(host->model.ctx,
+						tx[xfer->len - 1],
+						host->now_ns);
+		}
+	}
+
+	message->status = 0;
+	return 0;
+}
+
+int spi_async(struct spi_device *spi, struct spi_message *message)
+{
+	int ret = spi_sync(spi, message);
+
+	if (!ret && message->complete)
+		message->complete(message->context);
+
+	return ret;
+}
+
+const struct epd_controller *epd_host_controller(const char *name)
+{
+	static const struct epd_controller *const controllers[] = {
+		&epd_ssd1680_controller,
+		&epd_ssd1683_controller,
+		&epd_uc8179_controller,
+	};
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(controllers); i++) {
+		if (!strcmp(controllers[i]->name, name))
+			return controllers[i];
+	}
+
+	return NULL;
+}
+
+struct epd_host *epd_host_create(const struct epd_controller *ctrl,
+				 u32 width, u32 height)
+{
+	struct epd_host *host;
+	struct epd_dev *epd;
+
+	host = calloc(1, sizeof(*host));
+	if (!host)
+		return NULL;
+
+	epd = &host->epd;
+	epd->width = width;
+	epd->height = height;
+	epd->bytes_per_line = DIV_ROUND_UP(width, 8);
+	epd->screensize = epd->bytes_per_line * height;
+	epd->alloc_size = PAGE_ALIGN(epd->screensize);
+
+	host->info.screen_base = malloc(epd->alloc_size);
+	if (!host->info.screen_base) {
+		free(host);
+		return NULL;
+	}
+	memset(host->info.screen_base, 0xFF, epd->alloc_size);
+
+	host->spi.dev.name = "epd-host";
+	host->spi.controller = &host->ctlr;
+	host->spi.max_transfer_size = SIZE_MAX;
+	host->spi_hz = EPD_HOST_SPI_HZ_DEFAULT;
+	host->xfer_overhead_ns = EPD_HOST_XFER_OVERHEAD_NS_DEFAULT;
+	host->reset = true;
+
+	epd->spi = &host->spi;
+	epd->info = &host->info;
+	epd->ctrl = ctrl;
+	mutex_init(&epd->lock);
+	spin_lock_init(&epd->damage_lock);
+	epd->update_mode = EPD_MODE_FULL;
+	epd->bus_mode = EPD_BUS_QUEUED;
+	epd->spi_chunk_size = EPD_SPI_CHUNK_SIZE_DEFAULT;
+	epd->spi_yield_us = EPD_SPI_YIELD_US_DEFAULT;
+	epd->reset_gpio = &epd_host_gpios[EPD_HOST_GPIO_RESET];
+	epd->dc_gpio = &epd_host_gpios[EPD_HOST_GPIO_DC];
+	epd->busy_gpio = &epd_host_gpios[EPD_HOST_GPIO_BUSY];
+
+	epd_host_current = host;
+	return host;
+}
+
+void epd_host_destroy(struct epd_host *host)
+{
+	if (!host)
+		return;
+
+	if (epd_host_current == host)
+		epd_host_current = NULL;
+
+	if (host->record)
+		fclose(host->record);
+	free(host->sim);
+	free(host->info.screen_base);
+	free(host);
+}
+
+void epd_host_reset_stats(struct epd_host *host)
+{
+	memset(&host->stats, 0, sizeof(host->stats));
+}
+
+static void epd_host_sim_reset(void *ctx)
+{
+	epd_sim_reset(ctx);
+}
+
+static void epd_host_sim_cmd(void *ctx, u8 cmd, u64 now_ns)
+{
+	epd_sim_cmd(ctx, cmd, now_ns);
+}
+
+static void epd_host_sim_data(void *ctx, const u8 *buf, size_t len,
+			      u64 now_ns)
+{
+	epd_sim_data(ctx, buf, len, now_ns);
+}
+
+static bool epd_host_sim_busy(void *ctx, u64 now_ns)
+{
+	return epd_sim_busy(ctx, now_ns);
+}
+
+/*
+ * Feed the command stream to an SSD168x model, which then drives BUSY.
+ * Other controllers speak a different command set and are refused.
+ */
+int epd_host_attach_sim(struct epd_host *host, int ambient_temp)
+{
+	struct epd_dev *epd = &host->epd;
+	struct epd_sim *sim;
+
+	if (epd->ctrl != &epd_ssd1680_controller &&
+	    epd->ctrl != &epd_ssd1683_controller)
+		return -EOPNOTSUPP;
+
+	sim = calloc(1, sizeof(*sim) +
+			     epd_sim_mem_size(epd->width, epd->height));
+	if (!sim)
+		return -ENOMEM;
+
+	epd_sim_init(sim, epd->width, epd->height, sim + 1);
+	sim->ambient_temp = ambient_temp;
+	epd_sim_reset(sim);
+
+	free(host->sim);
+	host->sim = sim;
+	host->model.reset = epd_host_sim_reset;
+	host->model.cmd = epd_host_sim_cmd;
+	host->model.data = epd_host_sim_data;
+	host->model.busy = epd_host_sim_busy;
+	host->model.ctx = sim;
+	return 0;
+}
+
+/* Write the command stream to @path the way the debugfs capture does */
+int epd_host_record(struct epd_host *host, const char *path)
+{
+	struct epd_dev *epd = &host->epd;
+
+	host->record = fopen(path, "w");
+	if (!host->record)
+		return -errno;
+
+	host->record_start_ns = host->now_ns;
+	fprintf(host->record, "# pamir-ai-eink %s %ux%u\n", epd->ctrl->name,
+		epd->width, epd->height);
+	return 0;
+}
@@ -9,6 +9,7 @@
 #include <linux/kernel.h>
 #include <linux/spi/spi.h>
 #include <linux/of.h>
+#include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <linux/gpio/consumer.h>
 #include <linux/fb.h>
@@ -23,6 +24,7 @@ static int epd_probe(struct spi_device *spi)
 	struct device_node *np = spi->dev.of_node;
 	struct epd_dev *epd;
 	struct fb_info *info;
+	const char *bus_mode;
 	u32 width = 0, height = 0;
 	int ret;
 
@@ -47,6 +49,15 @@ static int epd_probe(struct spi_device *spi)
 	if (!epd)
 		return -ENOMEM;
 
+	epd->ctrl = of_device_get_match_data(&spi->dev);
+	if (!epd->ctrl)
+		return -ENODEV;
+
+	if (width > epd->ctrl->max_width || height > epd->ctrl->max_height)
+		dev_warn(&spi->dev, "%ux%u exceeds %s RAM of %ux%u pixels\n",
+			 width, height, epd->ctrl->name, epd->ctrl->max_width,
+			 epd->ctrl->max_height);
+
 	epd->spi = spi;
 	epd->width = width;
 	epd->height = height;
@@ -54,11 +65,25 @@ static int epd_probe(struct spi_device *spi)
 	epd->screensize = epd->bytes_per_line * epd->height;
 	epd->alloc_size = PAGE_ALIGN(epd->screensize);
 	mutex_init(&epd->lock);
+	spin_lock_init(&epd->damage_lock);
+	epd_stream_init(epd);
 
 	epd->update_mode = EPD_MODE_FULL;
 	epd->partial_area_set = false;
 	epd->initialized = false;
 
+	epd->bus_mode = EPD_BUS_QUEUED;
+	epd->spi_chunk_size = EPD_SPI_CHUNK_SIZE_DEFAULT;
+	epd->spi_yield_us = EPD_SPI_YIELD_US_DEFAULT;
+	if (!of_property_read_string(np, "pamir-ai,spi-bus-mode", &bus_mode)) {
+		ret = __sysfs_match_string(epd_bus_mode_names, -1, bus_mode);
+		if (ret < 0) {
+			dev_err(&spi->dev, "Invalid 'pamir-ai,spi-bus-mode'\n");
+			return ret;
+		}
+		epd->bus_mode = ret;
+	}
+
 	epd->reset_gpio =
 		devm_gpiod_get_optional(&spi->dev, "reset", GPIOD_OUT_HIGH);
 	if (IS_ERR(epd->reset_gpio))
@@ -102,12 +127,23 @@ static int epd_probe(struct spi_device *spi)
 	}
 	memset(info->screen_base, 0, epd->alloc_size);
 
+	/*
+	 * fbcon may start drawing as soon as the framebuffer is registered,
+	 * and deferred flushes read the framebuffer, so the worker lives
+	 * strictly inside the framebuffer's lifetime.
+	 */
+	ret = epd_flush_init(epd);
+	if (ret) {
+		dev_err(&spi->dev, "Failed to start flush worker: %d\n", ret);
+		goto err_free_screen;
+	}
+
 	info->fix.smem_start = 0;
 	info->fix.smem_len = epd->alloc_size;
 	ret = register_framebuffer(info);
 	if (ret < 0) {
 		dev_err(&spi->dev, "Failed to register framebuffer: %d\n", ret);
-		goto err_free_screen;
+		goto err_flush_destroy;
 	}
 
 	spi_set_drvdata(spi, epd);
@@ -130,13 +166,27 @@ static int epd_probe(struct spi_device *spi)
 		goto err_unregister_fb;
 	}
 
-	dev_info(&spi->dev, "Pamir AI E-Ink display registered: %ux%u pixels\n",
-		 epd->width, epd->height);
+	ret = epd_group_join(epd);
+	if (ret) {
+		dev_err(&spi->dev, "Failed to join panel group: %d\n", ret);
+		goto err_remove_sysfs;
+	}
+
+	epd_trace_init(epd);
+
+	dev_info(&spi->dev,
+		 "Pamir AI E-Ink display registered: %ux%u pixels, %s\n",
+		 epd->width, epd->height, epd->ctrl->name);
 
 	return 0;
 
+err_remove_sysfs:
+	sysfs_remove_group(&spi->dev.kobj, &epd_attr_group);
 err_unregister_fb:
 	unregister_framebuffer(info);
+err_flush_destroy:
+	epd_stream_destroy(epd);
+	epd_flush_destroy(epd);
 err_free_screen:
 	vfree(info->screen_base);
 err_fb_release:
@@ -150,7 +200,16 @@ static void epd_remove(struct spi_device *spi)
 	struct fb_info *info = epd->info;
 	int ret;
 
+	epd_stream_stop(epd);
+	epd_trace_destroy(epd);
 	sysfs_remove_group(&spi->dev.kobj, &epd_attr_group);
+	epd_group_leave(epd);
+
+	/* Nothing may queue or run a flush once the panel is cleared */
+	if (info)
+		unregister_framebuffer(info);
+	epd_stream_destroy(epd);
+	epd_flush_destroy(epd);
 
 	if (epd->initialized) {
 		ret = epd_clear_display(epd);
@@ -165,14 +224,17 @@ static void epd_remove(struct spi_device *spi)
 	}
 
 	if (info) {
-		unregister_framebuffer(info);
 		vfree(info->screen_base);
 		framebuffer_release(info);
 	}
 }
 
 static const struct of_device_id epd_of_match[] = {
-	{ .compatible = "pamir-ai,eink-display" },
+	{ .compatible = "pamir-ai,eink-display",
+	  .data = &epd_ssd1680_controller },
+	{ .compatible = "solomon,ssd1680", .data = &epd_ssd1680_controller },
+	{ .compatible = "solomon,ssd1683", .data = &epd_ssd1683_controller },
+	{ .compatible = "ultrachip,uc8179", .data = &epd_uc8179_controller },
 	{}
 };
 MODULE_DEVICE_TABLE(of, epd_of_match);
@@ -12,80 +12,33 @@
 
 #include "pamir-ai-eink-internal.h"
 
-static int epd_trigger_update(struct epd_dev *epd, u8 mode)
+int epd_full_update(struct epd_dev *epd)
 {
-	u8 data;
-	int ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_DISPLAY_UPDATE_CTRL2);
-	if (ret)
-		return ret;
+	const u8 *buf = epd_frame(epd);
 
-	data = mode;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_ACTIVATE);
-	if (ret)
-		return ret;
+	if (!buf)
+		return -ENOMEM;
 
-	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
+	return epd->ctrl->full_update(epd, buf);
 }
 
-int epd_full_update(struct epd_dev *epd)
+int epd_fast_update(struct epd_dev *epd)
 {
-	struct fb_info *info = epd->info;
-	u8 *buf = info->screen_base;
-	size_t len = epd->screensize;
-	u8 data;
-	int ret;
+	const u8 *buf = epd_frame(epd);
 
 	if (!buf)
 		return -ENOMEM;
 
-	/* Y-increment mode */
-	ret = epd_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_BW);
-	if (ret)
-		return ret;
-
-	ret = epd_send_data_buf(epd, buf, len);
-	if (ret)
-		return ret;
+	if (!(epd->ctrl->caps & EPD_CAP_FAST))
+		return epd->ctrl->full_update(epd, buf);
 
-	/* Clear residual data in red RAM */
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_RED);
-	if (ret)
-		return ret;
-
-	ret = epd_send_data_buf(epd, buf, len);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_BORDER_WAVEFORM);
-	if (ret)
-		return ret;
-
-	data = EPD_BORDER_NORMAL;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		return ret;
-
-	return epd_trigger_update(epd, EPD_UPDATE_MODE_FULL);
+	return epd->ctrl->fast_update(epd, buf);
 }
 
-int epd_partial_update(struct epd_dev *epd)
+static int epd_partial_update_area(struct epd_dev *epd,
+				   const struct epd_update_area *area)
 {
-	struct fb_info *info = epd->info;
-	struct epd_update_area *area = &epd->partial_area;
-	u8 *buf;
-	u8 data;
-	u32 x_bytes, y;
-	int ret;
+	const u8 *buf = epd_frame(epd);
 
 	if (!epd->initialized) {
 		dev_err(&epd->spi->dev,
@@ -93,12 +46,11 @@ int epd_partial_update(struct epd_dev *epd)
 		return -ENODEV;
 	}
 
-	if (!epd->partial_area_set) {
-		area->x = 0;
-		area->y = 0;
-		area->width = epd->width;
-		area->height = epd->height;
-	}
+	if (!buf)
+		return -ENOMEM;
+
+	if (!(epd->ctrl->caps & EPD_CAP_PARTIAL))
+		return epd->ctrl->full_update(epd, buf);
 
 	if (area->x % 8 != 0 || area->width % 8 != 0) {
 		dev_err(&epd->spi->dev,
@@ -113,196 +65,203 @@ int epd_partial_update(struct epd_dev *epd)
 		return -EINVAL;
 	}
 
-	ret = epd_send_cmd(epd, EPD_CMD_BORDER_WAVEFORM);
-	if (ret)
-		return ret;
-
-	data = EPD_BORDER_PARTIAL;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_set_ram_area(epd, area->x, area->y, area->x + area->width - 1,
-			       area->y + area->height - 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_BW);
-	if (ret)
-		return ret;
-
-	x_bytes = area->width / 8;
-	buf = info->screen_base;
+	return epd->ctrl->partial_update(epd, buf, area);
+}
 
-	for (y = area->y; y < area->y + area->height; y++) {
-		size_t offset = y * epd->bytes_per_line + (area->x / 8);
+int epd_partial_update(struct epd_dev *epd)
+{
+	struct epd_update_area *area = &epd->partial_area;
 
-		ret = epd_send_data_buf(epd, buf + offset, x_bytes);
-		if (ret)
-			return ret;
+	if (!epd->partial_area_set) {
+		area->x = 0;
+		area->y = 0;
+		area->width = epd->width;
+		area->height = epd->height;
 	}
 
-	ret = epd_trigger_update(epd, EPD_UPDATE_MODE_PARTIAL);
-
-	return ret;
+	return epd_partial_update_area(epd, area);
 }
 
 int epd_base_map_update(struct epd_dev *epd)
 {
-	struct fb_info *info = epd->info;
-	u8 *buf = info->screen_base;
-	size_t len = epd->screensize;
-	u8 data;
-	int ret;
+	const u8 *buf = epd_frame(epd);
 
 	if (!buf)
 		return -ENOMEM;
 
-	ret = epd_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
-	if (ret)
-		return ret;
+	if (!(epd->ctrl->caps & EPD_CAP_BASE_MAP))
+		return epd->ctrl->full_update(epd, buf);
+
+	return epd->ctrl->base_map_update(epd, buf);
+}
+
+/*
+ * Grow a rectangle, empty unless area_set, to cover another one clipped to
+ * max_width x max_height. X is rounded out to whole bytes. The caller
+ * serializes access to the rectangle.
+ */
+void epd_area_grow(struct epd_update_area *area, bool *area_set, u32 x,
+		   u32 y, u32 width, u32 height, u32 max_width, u32 max_height)
+{
+	u32 x1, y1;
+
+	if (!width || !height || x >= max_width || y >= max_height)
+		return;
+
+	x1 = min_t(u32, round_up(x + width, 8), max_width);
+	y1 = min_t(u32, y + height, max_height);
+	x = round_down(x, 8);
 
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_BW);
-	if (ret)
-		return ret;
+	if (*area_set) {
+		x1 = max_t(u32, x1, area->x + area->width);
+		y1 = max_t(u32, y1, area->y + area->height);
+		x = min_t(u32, x, area->x);
+		y = min_t(u32, y, area->y);
+	}
+
+	area->x = x;
+	area->y = y;
+	area->width = x1 - x;
+	area->height = y1 - y;
+	*area_set = true;
+}
 
-	ret = epd_send_data_buf(epd, buf, len);
-	if (ret)
-		return ret;
+/*
+ * Grow the damage rectangle by an area that changed in the framebuffer.
+ * Safe to call from atomic context.
+ */
+void epd_damage_add(struct epd_dev *epd, u32 x, u32 y, u32 width,
+		    u32 height)
+{
+	unsigned long flags;
 
-	ret = epd_send_cmd(epd, EPD_CMD_DISPLAY_UPDATE_CTRL2);
-	if (ret)
-		return ret;
+	spin_lock_irqsave(&epd->damage_lock, flags);
+	epd_area_grow(&epd->damage, &epd->damage_set, x, y, width, height,
+		      epd->width, epd->height);
+	spin_unlock_irqrestore(&epd->damage_lock, flags);
+}
 
-	data = EPD_UPDATE_MODE_FULL;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		return ret;
+/* Anything damaged after this point goes into the next refresh */
+static bool epd_damage_take(struct epd_dev *epd, struct epd_update_area *area)
+{
+	unsigned long flags;
+	bool damaged;
 
-	ret = epd_send_cmd(epd, EPD_CMD_ACTIVATE);
-	if (ret)
-		return ret;
+	spin_lock_irqsave(&epd->damage_lock, flags);
+	damaged = epd->damage_set;
+	*area = epd->damage;
+	epd->damage_set = false;
+	spin_unlock_irqrestore(&epd->damage_lock, flags);
 
-	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
+	return damaged;
 }
 
-int epd_display_flush(struct epd_dev *epd)
+/*
+ * damage_only is set when the refresh was only asked for by write() or
+ * fbcon drawing. Without an explicit area a partial refresh then covers
+ * just the damage; explicit requests refresh the whole panel.
+ */
+int epd_display_update(struct epd_dev *epd, bool damage_only)
 {
+	struct epd_group_req *req = &epd->group_req;
+	enum epd_update_mode mode;
+	struct epd_update_area damage;
+	const struct epd_update_area *area = NULL;
+	bool damaged, group;
 	int ret;
 
 	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
+
+	damaged = epd_damage_take(epd, &damage);
+
+	mode = epd->update_mode;
+	group = req->pending;
+	if (group) {
+		/* Covers whatever this panel had asked for itself */
+		mode = req->mode;
+		if (req->area_set)
+			area = &req->area;
+		epd->frame = req->frame;
+		req->pending = false;
+	} else if (damage_only && !epd->partial_area_set && damaged) {
+		/* Without an explicit area only what was written is refreshed */
+		area = &damage;
+	}
 
-	switch (epd->update_mode) {
+	switch (mode) {
 	case EPD_MODE_FULL:
 		ret = epd_full_update(epd);
 		break;
 	case EPD_MODE_PARTIAL:
-		ret = epd_partial_update(epd);
+		if (area)
+			ret = epd_partial_update_area(epd, area);
+		else
+			ret = epd_partial_update(epd);
 		break;
 	case EPD_MODE_BASE_MAP:
 		ret = epd_base_map_update(epd);
 		break;
+	case EPD_MODE_FAST:
+		ret = epd_fast_update(epd);
+		break;
 	default:
-		dev_err(&epd->spi->dev, "Invalid update mode %d\n",
-			epd->update_mode);
+		dev_err(&epd->spi->dev, "Invalid update mode %d\n", mode);
 		ret = -EINVAL;
 		break;
 	}
 
+	if (group)
+		epd->frame = NULL;
+	epd_bus_end(epd);
+	mutex_unlock(&epd->lock);
+	return ret;
+}
+
+/* Refresh a streamed frame, independent of the mode and area set by ioctl */
+int epd_stream_update(struct epd_dev *epd, const struct epd_update_area *area,
+		      bool full)
+{
+	int ret;
+
+	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
+
+	if (full)
+		ret = epd_full_update(epd);
+	else
+		ret = epd_partial_update_area(epd, area);
+
+	epd_bus_end(epd);
 	mutex_unlock(&epd->lock);
 	return ret;
 }
 
 int epd_clear_display(struct epd_dev *epd)
 {
-	size_t len = epd->screensize;
-	u8 *clear_buf;
-	u8 data;
 	int ret;
 
-	// ret = epd_hw_init(epd);
-	// if (ret) {
-	//	dev_warn(&epd->spi->dev, "Failed to reinit hardware: %d\n", ret);
-	// }
-
-	/* Y-decrement mode needed for proper clear */
-	data = 0x01; /* X-increment, Y-decrement - matches height-1 to 0 coords */
-	ret = epd_send_cmd(epd, EPD_CMD_DATA_ENTRY_MODE);
-	if (ret)
-		return ret;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		return ret;
-
-	clear_buf = kmalloc(len, GFP_KERNEL);
-	if (!clear_buf)
-		return -ENOMEM;
-	memset(clear_buf, 0xFF, len);
-
-	/* Y-increment mode */
-	ret = epd_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
-	if (ret)
-		goto out_free;
-
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_BW);
-	if (ret)
-		goto out_free;
-
-	ret = epd_send_data_buf(epd, clear_buf, len);
-	if (ret)
-		goto out_free;
-
-	/* Prevent ghosting */
-	ret = epd_send_cmd(epd, EPD_CMD_WRITE_RAM_RED);
-	if (ret)
-		goto out_free;
-
-	ret = epd_send_data_buf(epd, clear_buf, len);
-	if (ret)
-		goto out_free;
-
-	ret = epd_send_cmd(epd, EPD_CMD_DISPLAY_UPDATE_CTRL2);
-	if (ret)
-		goto out_free;
-
-	data = EPD_UPDATE_MODE_FULL;
-	ret = epd_send_data_buf(epd, &data, 1);
-	if (ret)
-		goto out_free;
-
-	ret = epd_send_cmd(epd, EPD_CMD_ACTIVATE);
-	if (ret)
-		goto out_free;
-
-	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
-	if (ret)
-		goto out_free;
-
-	data = 0x03; /* X-increment, Y-increment for text display */
-	ret = epd_send_cmd(epd, EPD_CMD_DATA_ENTRY_MODE);
-	if (ret)
-		goto out_free;
-	ret = epd_send_data_buf(epd, &data, 1);
-
-out_free:
-	kfree(clear_buf);
+	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
+	ret = epd->ctrl->clear(epd);
+	epd_bus_end(epd);
+	mutex_unlock(&epd->lock);
+
 	return ret;
 }
 
 int epd_deep_sleep(struct epd_dev *epd)
 {
-	u8 data = 0x11; /* Mode 2: Deep Sleep without RAM retention */
 	int ret;
 
 	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
 
-	ret = epd_send_cmd(epd, EPD_CMD_DEEP_SLEEP_MODE);
-	if (!ret)
-		ret = epd_send_data_buf(epd, &data, 1);
-
+	ret = epd->ctrl->deep_sleep(epd);
 	if (!ret)
 		epd->initialized = false;
 
+	epd_bus_end(epd);
 	mutex_unlock(&epd->lock);
 
 	if (!ret)
@@ -13,30 +13,97 @@
 
 #include "pamir-ai-eink-internal.h"
 
+/*
+ * Writes only record the rows they touched. The refresh follows once the
+ * writer has been idle for EPD_WRITE_IDLE_MS or closes the device, so an
+ * image written in several chunks is shown in one go.
+ */
 static ssize_t epd_fb_write(struct fb_info *info, const char __user *buf,
 			    size_t count, loff_t *ppos)
 {
 	struct epd_dev *epd = info->par;
+	u32 start, end, y0, y1;
 	ssize_t rc;
 
 	rc = fb_sys_write(info, buf, count, ppos);
-	if (rc > 0) {
-		int ret = epd_display_flush(epd);
+	if (rc <= 0)
+		return rc;
 
-		if (ret)
-			dev_err(&epd->spi->dev, "Display flush failed: %d\n",
-				ret);
-	}
+	start = *ppos - rc;
+	end = *ppos - 1;
+	y0 = start / epd->bytes_per_line;
+	y1 = end / epd->bytes_per_line;
+
+	if (y0 == y1)
+		epd_damage_add(epd, (start % epd->bytes_per_line) * 8, y0,
+			       rc * 8, 1);
+	else
+		epd_damage_add(epd, 0, y0, epd->width, y1 - y0 + 1);
 
+	epd_flush_defer(epd, EPD_WRITE_IDLE_MS);
 	return rc;
 }
 
+static int epd_fb_release(struct fb_info *info, int user)
+{
+	struct epd_dev *epd = info->par;
+	int ret;
+
+	if (!user)
+		return 0;
+
+	ret = epd_flush_deferred_sync(epd);
+	if (ret && ret != -EINTR)
+		dev_err(&epd->spi->dev, "Display flush failed: %d\n", ret);
+
+	return 0;
+}
+
+/*
+ * fbcon draws through these. Each call only records damage; the panel is
+ * refreshed at most EPD_CONSOLE_FLUSH_MS later, and the governor bounds
+ * how often that can happen. That refresh is damage-only, so a blinking
+ * cursor never narrows an update userspace asked for explicitly.
+ */
+static void epd_fb_fillrect(struct fb_info *info,
+			    const struct fb_fillrect *rect)
+{
+	struct epd_dev *epd = info->par;
+
+	sys_fillrect(info, rect);
+	epd_damage_add(epd, rect->dx, rect->dy, rect->width, rect->height);
+	epd_flush_coalesce(epd, EPD_CONSOLE_FLUSH_MS);
+}
+
+static void epd_fb_copyarea(struct fb_info *info,
+			    const struct fb_copyarea *area)
+{
+	struct epd_dev *epd = info->par;
+
+	sys_copyarea(info, area);
+	epd_damage_add(epd, area->dx, area->dy, area->width, area->height);
+	epd_flush_coalesce(epd, EPD_CONSOLE_FLUSH_MS);
+}
+
+static void epd_fb_imageblit(struct fb_info *info,
+			     const struct fb_image *image)
+{
+	struct epd_dev *epd = info->par;
+
+	sys_imageblit(info, image);
+	epd_damage_add(epd, image->dx, image->dy, image->width,
+		       image->height);
+	epd_flush_coalesce(epd, EPD_CONSOLE_FLUSH_MS);
+}
+
 static int epd_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			unsigned long arg)
 {
 	struct epd_dev *epd = info->par;
 	struct epd_update_area area;
+	struct epd_stream_info stream_info;
 	void __user *argp = (void __user *)arg;
+	u32 free;
 	int mode;
 	int ret = 0;
 
@@ -45,7 +112,7 @@ static int epd_fb_ioctl(struct fb_info *info, unsigned int cmd,
 		if (get_user(mode, (int __user *)argp))
 			return -EFAULT;
 
-		if (mode < EPD_MODE_FULL || mode > EPD_MODE_BASE_MAP)
+		if (mode < EPD_MODE_FULL || mode > EPD_MODE_FAST)
 			return -EINVAL;
 
 		mutex_lock(&epd->lock);
@@ -87,6 +154,10 @@ static int epd_fb_ioctl(struct fb_info *info, unsigned int cmd,
 		ret = epd_display_flush(epd);
 		break;
 
+	case EPD_IOC_GROUP_UPDATE:
+		ret = epd_group_flush(epd);
+		break;
+
 	case EPD_IOC_DEEP_SLEEP:
 		ret = epd_deep_sleep(epd);
 		break;
@@ -118,6 +189,30 @@ static int epd_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			dev_info(&epd->spi->dev, "Display cleared\n");
 		break;
 
+	case EPD_IOC_STREAM_START:
+		ret = epd_stream_start(epd, &stream_info);
+		if (!ret && copy_to_user(argp, &stream_info,
+					 sizeof(stream_info))) {
+			epd_stream_stop(epd);
+			return -EFAULT;
+		}
+		break;
+
+	case EPD_IOC_STREAM_KICK:
+		ret = epd_stream_kick(epd);
+		break;
+
+	case EPD_IOC_STREAM_WAIT:
+		if (get_user(free, (__u32 __user *)argp))
+			return -EFAULT;
+
+		ret = epd_stream_wait(epd, free);
+		break;
+
+	case EPD_IOC_STREAM_STOP:
+		epd_stream_stop(epd);
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -130,6 +225,9 @@ static int epd_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
 	struct epd_dev *epd = info->par;
 	unsigned long vma_size = vma->vm_end - vma->vm_start;
 
+	if (vma->vm_pgoff == epd->alloc_size >> PAGE_SHIFT)
+		return epd_stream_mmap(epd, vma);
+
 	if (vma_size > info->fix.smem_len) {
 		dev_err(&epd->spi->dev,
 			"mmap size %lu exceeds framebuffer size %u\n", vma_size,
@@ -143,10 +241,165 @@ static int epd_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
 const struct fb_ops epd_fb_ops = {
 	.owner = THIS_MODULE,
 	.fb_read = fb_sys_read,
+	.fb_release = epd_fb_release,
 	.fb_write = epd_fb_write,
-	.fb_fillrect = sys_fillrect,
-	.fb_copyarea = sys_copyarea,
-	.fb_imageblit = sys_imageblit,
+	.fb_fillrect = epd_fb_fillrect,
+	.fb_copyarea = epd_fb_copyarea,
+	.fb_imageblit = epd_fb_imageblit,
 	.fb_ioctl = epd_fb_ioctl,
 	.fb_mmap = epd_fb_mmap,
 };
+
+/* The group framebuffer defers its refreshes the same way as a panel's */
+static ssize_t epd_group_fb_write(struct fb_info *info,
+				  const char __user *buf, size_t count,
+				  loff_t *ppos)
+{
+	struct epd_group *group = info->par;
+	u32 start, end, y0, y1;
+	ssize_t rc;
+
+	rc = fb_sys_write(info, buf, count, ppos);
+	if (rc <= 0)
+		return rc;
+
+	start = *ppos - rc;
+	end = *ppos - 1;
+	y0 = start / group->bytes_per_line;
+	y1 = end / group->bytes_per_line;
+
+	if (y0 == y1)
+		epd_group_damage_add(group,
+				     (start % group->bytes_per_line) * 8, y0,
+				     rc * 8, 1);
+	else
+		epd_group_damage_add(group, 0, y0, group->width, y1 - y0 + 1);
+
+	epd_group_flush_defer(group, EPD_WRITE_IDLE_MS);
+	return rc;
+}
+
+static int epd_group_fb_release(struct fb_info *info, int user)
+{
+	struct epd_group *group = info->par;
+	int ret;
+
+	if (!user)
+		return 0;
+
+	ret = epd_group_flush_deferred_sync(group);
+	if (ret && ret != -EINTR)
+		pr_err(DRIVER_NAME ": group flush of '%s' failed: %d\n",
+		       group->name, ret);
+
+	return 0;
+}
+
+static void epd_group_fb_fillrect(struct fb_info *info,
+				  const struct fb_fillrect *rect)
+{
+	struct epd_group *group = info->par;
+
+	sys_fillrect(info, rect);
+	epd_group_damage_add(group, rect->dx, rect->dy, rect->width,
+			     rect->height);
+	epd_group_flush_coalesce(group, EPD_CONSOLE_FLUSH_MS);
+}
+
+static void epd_group_fb_copyarea(struct fb_info *info,
+				  const struct fb_copyarea *area)
+{
+	struct epd_group *group = info->par;
+
+	sys_copyarea(info, area);
+	epd_group_damage_add(group, area->dx, area->dy, area->width,
+			     area->height);
+	epd_group_flush_coalesce(group, EPD_CONSOLE_FLUSH_MS);
+}
+
+static void epd_group_fb_imageblit(struct fb_info *info,
+				   const struct fb_image *image)
+{
+	struct epd_group *group = info->par;
+
+	sys_imageblit(info, image);
+	epd_group_damage_add(group, image->dx, image->dy, image->width,
+			     image->height);
+	epd_group_flush_coalesce(group, EPD_CONSOLE_FLUSH_MS);
+}
+
+static int epd_group_fb_ioctl(struct fb_info *info, unsigned int cmd,
+			      unsigned long arg)
+{
+	struct epd_group *group = info->par;
+	struct epd_update_area area;
+	void __user *argp = (void __user *)arg;
+	int mode;
+
+	switch (cmd) {
+	case EPD_IOC_SET_UPDATE_MODE:
+		if (get_user(mode, (int __user *)argp))
+			return -EFAULT;
+
+		if (mode < EPD_MODE_FULL || mode > EPD_MODE_FAST)
+			return -EINVAL;
+
+		mutex_lock(&group->lock);
+		group->update_mode = mode;
+		if (mode == EPD_MODE_FULL)
+			group->partial_area_set = false;
+		mutex_unlock(&group->lock);
+		return 0;
+
+	case EPD_IOC_GET_UPDATE_MODE:
+		if (put_user(group->update_mode, (int __user *)argp))
+			return -EFAULT;
+		return 0;
+
+	case EPD_IOC_SET_PARTIAL_AREA:
+		if (copy_from_user(&area, argp, sizeof(area)))
+			return -EFAULT;
+
+		if (area.x % 8 != 0 || area.width % 8 != 0)
+			return -EINVAL;
+
+		if (area.x + area.width > group->width ||
+		    area.y + area.height > group->height)
+			return -EINVAL;
+
+		mutex_lock(&group->lock);
+		group->partial_area = area;
+		group->partial_area_set = true;
+		mutex_unlock(&group->lock);
+		return 0;
+
+	case EPD_IOC_UPDATE_DISPLAY:
+	case EPD_IOC_GROUP_UPDATE:
+		return epd_group_fb_flush(group, false);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int epd_group_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
+{
+	unsigned long vma_size = vma->vm_end - vma->vm_start;
+
+	if (vma_size > info->fix.smem_len)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, info->screen_base, 0);
+}
+
+const struct fb_ops epd_group_fb_ops = {
+	.owner = THIS_MODULE,
+	.fb_read = fb_sys_read,
+	.fb_release = epd_group_fb_release,
+	.fb_write = epd_group_fb_write,
+	.fb_fillrect = epd_group_fb_fillrect,
+	.fb_copyarea = epd_group_fb_copyarea,
+	.fb_imageblit = epd_group_fb_imageblit,
+	.fb_ioctl = epd_group_fb_ioctl,
+	.fb_mmap = epd_group_fb_mmap,
+};
@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Flush worker for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/of.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <uapi/linux/sched/types.h>
+
+#include "pamir-ai-eink-internal.h"
+
+const char * const epd_governor_names[] = {
+	[EPD_GOV_LATENCY] = "latency",
+	[EPD_GOV_THROUGHPUT] = "throughput",
+	[EPD_GOV_POWER] = "power",
+	[EPD_GOV_CUSTOM] = "custom",
+	NULL,
+};
+
+static const struct epd_governor_params epd_governor_profiles[] = {
+	/* Start right away, but never faster than 10 refreshes per second */
+	[EPD_GOV_LATENCY] = {
+		.min_interval_ms = 100,
+		.batch_delay_ms = 0,
+		.full_interval_ms = 500,
+	},
+	/* Batch bursts of small updates into fewer, larger refreshes */
+	[EPD_GOV_THROUGHPUT] = {
+		.min_interval_ms = 250,
+		.batch_delay_ms = 50,
+		.full_interval_ms = 2000,
+	},
+	/* At most one refresh per second and one full refresh per 30 s */
+	[EPD_GOV_POWER] = {
+		.min_interval_ms = 1000,
+		.batch_delay_ms = 2000,
+		.full_interval_ms = 30000,
+	},
+};
+
+static bool epd_flush_is_full(struct epd_dev *epd)
+{
+	enum epd_update_mode mode = READ_ONCE(epd->update_mode);
+
+	if (READ_ONCE(epd->group_req.pending))
+		mode = READ_ONCE(epd->group_req.mode);
+
+	return mode == EPD_MODE_FULL || mode == EPD_MODE_BASE_MAP;
+}
+
+/* Earliest start the governor allows for the next refresh. Needs flush_slock */
+static ktime_t epd_flush_earliest(struct epd_dev *epd)
+{
+	ktime_t next = ktime_add_ms(epd->flush_last, epd->gov.min_interval_ms);
+
+	if (epd_flush_is_full(epd))
+		next = max(next, ktime_add_ms(epd->flush_last_full,
+					      epd->gov.full_interval_ms));
+
+	return next;
+}
+
+static unsigned long epd_flush_delay(ktime_t now, ktime_t when)
+{
+	if (!ktime_after(when, now))
+		return 0;
+
+	return usecs_to_jiffies(ktime_us_delta(when, now));
+}
+
+/*
+ * Every refresh runs on the panel's own kthread, so its start time depends
+ * on the worker's priority and CPU rather than on whoever asked for it.
+ * Requests that arrive while a refresh is pending or running are covered by
+ * the next one.
+ */
+static void epd_flush_work_fn(struct kthread_work *work)
+{
+	struct epd_dev *epd = container_of(work, struct epd_dev,
+					   flush_work.work);
+	unsigned long delay;
+	bool damage_only;
+	ktime_t now;
+	u64 seq;
+	int ret;
+
+	spin_lock(&epd->flush_slock);
+
+	/* The update mode may have changed since the request was queued */
+	now = ktime_get();
+	delay = epd_flush_delay(now, epd_flush_earliest(epd));
+	if (delay) {
+		spin_unlock(&epd->flush_slock);
+		kthread_queue_delayed_work(epd->flush_worker, &epd->flush_work,
+					   delay);
+		return;
+	}
+
+	seq = epd->flush_req_seq;
+	damage_only = epd->flush_panel_seq <= epd->flush_done_seq;
+	epd->flush_last = now;
+	if (epd_flush_is_full(epd))
+		epd->flush_last_full = now;
+
+	spin_unlock(&epd->flush_slock);
+
+	ret = epd_display_update(epd, damage_only);
+
+	spin_lock(&epd->flush_slock);
+	epd->flush_done_seq = seq;
+	epd->flush_ret = ret;
+	spin_unlock(&epd->flush_slock);
+
+	wake_up_all(&epd->flush_done_wq);
+}
+
+/*
+ * Queue a refresh. damage_only requests come from deferred writes and fbcon
+ * drawing; a refresh covering any other request shows the whole panel.
+ */
+static u64 epd_flush_queue(struct epd_dev *epd, bool damage_only)
+{
+	unsigned long delay;
+	ktime_t now, when;
+	u64 seq;
+
+	spin_lock(&epd->flush_slock);
+	seq = ++epd->flush_req_seq;
+	if (!damage_only)
+		epd->flush_panel_seq = seq;
+	now = ktime_get();
+	when = max(ktime_add_ms(now, epd->gov.batch_delay_ms),
+		   epd_flush_earliest(epd));
+	delay = epd_flush_delay(now, when);
+	spin_unlock(&epd->flush_slock);
+
+	kthread_queue_delayed_work(epd->flush_worker, &epd->flush_work, delay);
+	return seq;
+}
+
+static void epd_defer_work_fn(struct kthread_work *work)
+{
+	struct epd_dev *epd = container_of(work, struct epd_dev,
+					   defer_work.work);
+	u64 seq = epd_flush_queue(epd, true);
+
+	spin_lock(&epd->flush_slock);
+	epd->defer_seq = seq;
+	spin_unlock(&epd->flush_slock);
+}
+
+int epd_flush_set_sched(struct epd_dev *epd, int priority, int cpu)
+{
+	struct task_struct *task = epd->flush_worker->task;
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = priority ? SCHED_FIFO : SCHED_NORMAL,
+		.sched_priority = priority,
+	};
+	int ret;
+
+	if (priority < 0 || priority >= MAX_RT_PRIO)
+		return -EINVAL;
+
+	if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu)))
+		return -EINVAL;
+
+	ret = sched_setattr_nocheck(task, &attr);
+	if (ret)
+		return ret;
+
+	ret = set_cpus_allowed_ptr(task, cpu >= 0 ? cpumask_of(cpu) :
+						    cpu_possible_mask);
+	if (ret)
+		return ret;
+
+	epd->flush_priority = priority;
+	epd->flush_cpu = cpu;
+	return 0;
+}
+
+/* Switching to "custom" keeps the current parameters */
+void epd_flush_set_governor(struct epd_dev *epd, enum epd_governor governor)
+{
+	spin_lock(&epd->flush_slock);
+	epd->governor = governor;
+	if (governor != EPD_GOV_CUSTOM)
+		epd->gov = epd_governor_profiles[governor];
+	spin_unlock(&epd->flush_slock);
+}
+
+int epd_flush_init(struct epd_dev *epd)
+{
+	struct device_node *np = epd->spi->dev.of_node;
+	u32 priority = EPD_FLUSH_PRIORITY_DEFAULT;
+	enum epd_governor governor = EPD_GOV_LATENCY;
+	const char *name;
+	s32 cpu = -1;
+	int ret;
+
+	of_property_read_u32(np, "pamir-ai,flush-priority", &priority);
+	of_property_read_s32(np, "pamir-ai,flush-cpu", &cpu);
+
+	if (!of_property_read_string(np, "pamir-ai,flush-governor", &name)) {
+		ret = __sysfs_match_string(epd_governor_names, EPD_GOV_CUSTOM,
+					   name);
+		if (ret < 0) {
+			dev_err(&epd->spi->dev,
+				"Invalid 'pamir-ai,flush-governor'\n");
+			return ret;
+		}
+		governor = ret;
+	}
+
+	spin_lock_init(&epd->flush_slock);
+	init_waitqueue_head(&epd->flush_done_wq);
+	kthread_init_delayed_work(&epd->flush_work, epd_flush_work_fn);
+	kthread_init_delayed_work(&epd->defer_work, epd_defer_work_fn);
+	epd_flush_set_governor(epd, governor);
+
+	/* Since 6.14 kthread_create_worker() leaves the thread asleep */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	epd->flush_worker = kthread_run_worker(0, "epd-%s",
+					       dev_name(&epd->spi->dev));
+#else
+	epd->flush_worker = kthread_create_worker(0, "epd-%s",
+						  dev_name(&epd->spi->dev));
+#endif
+	if (IS_ERR(epd->flush_worker)) {
+		ret = PTR_ERR(epd->flush_worker);
+		epd->flush_worker = NULL;
+		return ret;
+	}
+
+	ret = epd_flush_set_sched(epd, priority, cpu);
+	if (ret) {
+		dev_err(&epd->spi->dev,
+			"Invalid flush priority %u or CPU %d\n", priority, cpu);
+		kthread_destroy_worker(epd->flush_worker);
+		epd->flush_worker = NULL;
+	}
+
+	return ret;
+}
+
+void epd_flush_destroy(struct epd_dev *epd)
+{
+	if (!epd->flush_worker)
+		return;
+
+	kthread_cancel_delayed_work_sync(&epd->defer_work);
+	kthread_cancel_delayed_work_sync(&epd->flush_work);
+	kthread_destroy_worker(epd->flush_worker);
+	epd->flush_worker = NULL;
+}
+
+/*
+ * For refreshes that bypass the flush queue, such as streamed frames.
+ * Returns 0 and records the refresh as started now, or how many ms the
+ * governor still holds a full refresh back.
+ */
+unsigned int epd_flush_claim(struct epd_dev *epd, bool full)
+{
+	unsigned int wait_ms = 0;
+	ktime_t now, when;
+
+	spin_lock(&epd->flush_slock);
+	now = ktime_get();
+	when = ktime_add_ms(epd->flush_last_full, epd->gov.full_interval_ms);
+	if (full && ktime_after(when, now)) {
+		wait_ms = DIV_ROUND_UP(ktime_us_delta(when, now), 1000);
+	} else {
+		epd->flush_last = now;
+		if (full)
+			epd->flush_last_full = now;
+	}
+	spin_unlock(&epd->flush_slock);
+
+	return wait_ms;
+}
+
+/*
+ * Returns the sequence number to pass to epd_flush_wait(). The first
+ * request after an idle period starts the batching window; later ones
+ * join the refresh already scheduled.
+ */
+u64 epd_flush_request(struct epd_dev *epd)
+{
+	return epd_flush_queue(epd, false);
+}
+
+static bool epd_flush_done(struct epd_dev *epd, u64 seq)
+{
+	bool done;
+
+	spin_lock(&epd->flush_slock);
+	done = epd->flush_done_seq >= seq;
+	spin_unlock(&epd->flush_slock);
+
+	return done;
+}
+
+/*
+ * A refresh may be held back for seconds by the governor, so the wait can
+ * be killed. The refresh still happens; only the caller stops waiting.
+ */
+int epd_flush_wait(struct epd_dev *epd, u64 seq)
+{
+	int ret;
+
+	if (wait_event_killable(epd->flush_done_wq, epd_flush_done(epd, seq)))
+		return -EINTR;
+
+	spin_lock(&epd->flush_slock);
+	ret = epd->flush_ret;
+	spin_unlock(&epd->flush_slock);
+
+	return ret;
+}
+
+int epd_display_flush(struct epd_dev *epd)
+{
+	return epd_flush_wait(epd, epd_flush_request(epd));
+}
+
+/*
+ * Request a flush once nothing has called this for idle_ms, so a burst of
+ * small writes ends in a single refresh. Safe to call from atomic context.
+ */
+void epd_flush_defer(struct epd_dev *epd, unsigned int idle_ms)
+{
+	kthread_mod_delayed_work(epd->flush_worker, &epd->defer_work,
+				 msecs_to_jiffies(idle_ms));
+}
+
+/*
+ * Request a flush at most delay_ms from now. Unlike epd_flush_defer() the
+ * timer is not pushed back by later calls, so a steady stream of drawing
+ * still reaches the panel. Safe to call from atomic context.
+ */
+void epd_flush_coalesce(struct epd_dev *epd, unsigned int delay_ms)
+{
+	kthread_queue_delayed_work(epd->flush_worker, &epd->defer_work,
+				   msecs_to_jiffies(delay_ms));
+}
+
+/* Start a deferred flush right away and wait for it */
+int epd_flush_deferred_sync(struct epd_dev *epd)
+{
+	u64 seq;
+
+	if (kthread_cancel_delayed_work_sync(&epd->defer_work))
+		return epd_display_flush(epd);
+
+	spin_lock(&epd->flush_slock);
+	seq = epd->defer_seq;
+	spin_unlock(&epd->flush_slock);
+
+	return seq ? epd_flush_wait(epd, seq) : 0;
+}
@@ -0,0 +1,625 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Multi-panel grouping for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/fb.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "pamir-ai-eink-internal.h"
+
+static LIST_HEAD(epd_groups);
+static DEFINE_MUTEX(epd_groups_lock);
+
+static struct epd_group *epd_group_find(const char *name)
+{
+	struct epd_group *group;
+
+	list_for_each_entry(group, &epd_groups, node) {
+		if (!strcmp(group->name, name))
+			return group;
+	}
+
+	return NULL;
+}
+
+static void epd_group_queue(struct epd_dev *member)
+{
+	member->group_seq = epd_flush_request(member);
+}
+
+/* Caller holds group->lock and has queued the members to wait for */
+static int epd_group_wait(struct epd_group *group)
+{
+	struct epd_dev *member;
+	int ret = 0;
+
+	list_for_each_entry(member, &group->members, group_node) {
+		int err;
+
+		if (!member->group_seq)
+			continue;
+
+		err = epd_flush_wait(member, member->group_seq);
+		member->group_seq = 0;
+
+		if (err == -EINTR) {
+			ret = err;
+			continue;
+		}
+
+		if (err) {
+			dev_err(&member->spi->dev, "Group flush failed: %d\n",
+				err);
+			if (!ret)
+				ret = err;
+		}
+	}
+
+	return ret;
+}
+
+static int epd_group_parse_mode(struct device_node *np,
+				enum epd_group_mode *mode)
+{
+	const char *str;
+
+	*mode = EPD_GROUP_SYNC;
+
+	if (of_property_read_string(np, "pamir-ai,group-mode", &str))
+		return 0;
+
+	if (!strcmp(str, "sync"))
+		*mode = EPD_GROUP_SYNC;
+	else if (!strcmp(str, "tiled"))
+		*mode = EPD_GROUP_TILED;
+	else if (!strcmp(str, "mirror"))
+		*mode = EPD_GROUP_MIRROR;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+static int epd_group_check_tile(struct epd_group *group, struct epd_dev *epd)
+{
+	struct device_node *np = epd->spi->dev.of_node;
+	struct epd_dev *member;
+	u32 layout[2], tile[2];
+
+	if (of_property_read_u32_array(np, "pamir-ai,group-layout", layout, 2) ||
+	    of_property_read_u32_array(np, "pamir-ai,tile", tile, 2)) {
+		dev_err(&epd->spi->dev,
+			"Tiled group needs 'pamir-ai,group-layout' and 'pamir-ai,tile'\n");
+		return -EINVAL;
+	}
+
+	if (epd->width % 8 != 0) {
+		dev_err(&epd->spi->dev, "Tile width must be byte-aligned\n");
+		return -EINVAL;
+	}
+
+	if (!group->nr_members) {
+		if (!layout[0] || !layout[1])
+			return -EINVAL;
+		group->cols = layout[0];
+		group->rows = layout[1];
+		group->nr_expected = layout[0] * layout[1];
+		group->tile_width = epd->width;
+		group->tile_height = epd->height;
+	} else if (group->cols != layout[0] || group->rows != layout[1] ||
+		   group->tile_width != epd->width ||
+		   group->tile_height != epd->height) {
+		dev_err(&epd->spi->dev,
+			"Tile geometry does not match group '%s'\n",
+			group->name);
+		return -EINVAL;
+	}
+
+	if (tile[0] >= group->cols || tile[1] >= group->rows) {
+		dev_err(&epd->spi->dev, "Tile %u,%u outside %ux%u layout\n",
+			tile[0], tile[1], group->cols, group->rows);
+		return -EINVAL;
+	}
+
+	list_for_each_entry(member, &group->members, group_node) {
+		if (member->tile_col == tile[0] && member->tile_row == tile[1]) {
+			dev_err(&epd->spi->dev, "Tile %u,%u already taken\n",
+				tile[0], tile[1]);
+			return -EBUSY;
+		}
+	}
+
+	epd->tile_col = tile[0];
+	epd->tile_row = tile[1];
+	return 0;
+}
+
+static int epd_group_check_mirror(struct epd_group *group,
+				  struct epd_dev *epd)
+{
+	struct device_node *np = epd->spi->dev.of_node;
+	u32 expected;
+
+	if (of_property_read_u32(np, "pamir-ai,group-members", &expected) ||
+	    !expected) {
+		dev_err(&epd->spi->dev,
+			"Mirror group needs 'pamir-ai,group-members'\n");
+		return -EINVAL;
+	}
+
+	if (!group->nr_members) {
+		group->cols = 1;
+		group->rows = 1;
+		group->tile_width = epd->width;
+		group->tile_height = epd->height;
+		group->nr_expected = expected;
+	} else if (group->nr_expected != expected ||
+		   group->tile_width != epd->width ||
+		   group->tile_height != epd->height) {
+		dev_err(&epd->spi->dev,
+			"Panel geometry does not match mirror group '%s'\n",
+			group->name);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int epd_group_fb_register(struct epd_group *group, struct epd_dev *epd)
+{
+	struct fb_info *info;
+	int ret;
+
+	group->width = group->cols * group->tile_width;
+	group->height = group->rows * group->tile_height;
+	group->bytes_per_line = DIV_ROUND_UP(group->width, 8);
+	group->screensize = group->bytes_per_line * group->height;
+	group->alloc_size = PAGE_ALIGN(group->screensize);
+	group->update_mode = EPD_MODE_FULL;
+	group->partial_area_set = false;
+
+	info = framebuffer_alloc(0, &epd->spi->dev);
+	if (!info)
+		return -ENOMEM;
+
+	info->par = group;
+	strscpy(info->fix.id,
+		group->mode == EPD_GROUP_MIRROR ? "PamirAI-mirror" :
+						  "PamirAI-tiled",
+		sizeof(info->fix.id));
+	info->fix.type = FB_TYPE_PACKED_PIXELS;
+	info->fix.visual = FB_VISUAL_MONO01;
+	info->fix.line_length = group->bytes_per_line;
+
+	info->var.xres = group->width;
+	info->var.yres = group->height;
+	info->var.xres_virtual = group->width;
+	info->var.yres_virtual = group->height;
+	info->var.bits_per_pixel = 1;
+	info->var.activate = FB_ACTIVATE_NOW;
+
+	info->fbops = &epd_group_fb_ops;
+
+	info->screen_base = vmalloc_user(group->alloc_size);
+	if (!info->screen_base) {
+		ret = -ENOMEM;
+		goto err_fb_release;
+	}
+
+	if (group->mode == EPD_GROUP_MIRROR) {
+		group->staging = vmalloc(group->screensize);
+		if (!group->staging) {
+			ret = -ENOMEM;
+			goto err_free_screen;
+		}
+	}
+
+	info->fix.smem_start = 0;
+	info->fix.smem_len = group->alloc_size;
+	ret = register_framebuffer(info);
+	if (ret < 0)
+		goto err_free_screen;
+
+	group->info = info;
+	dev_info(&epd->spi->dev,
+		 "Framebuffer for group '%s' registered: %ux%u pixels\n",
+		 group->name, group->width, group->height);
+	return 0;
+
+err_free_screen:
+	vfree(group->staging);
+	group->staging = NULL;
+	vfree(info->screen_base);
+err_fb_release:
+	framebuffer_release(info);
+	return ret;
+}
+
+static void epd_group_fb_unregister(struct epd_group *group)
+{
+	struct fb_info *info;
+	u8 *staging;
+
+	mutex_lock(&group->lock);
+	info = group->info;
+	staging = group->staging;
+	group->info = NULL;
+	group->staging = NULL;
+	mutex_unlock(&group->lock);
+
+	if (!info)
+		return;
+
+	unregister_framebuffer(info);
+	cancel_delayed_work_sync(&group->flush_work);
+	vfree(staging);
+	vfree(info->screen_base);
+	framebuffer_release(info);
+}
+
+static void epd_group_flush_work_fn(struct work_struct *work)
+{
+	struct epd_group *group = container_of(to_delayed_work(work),
+					       struct epd_group, flush_work);
+	int ret;
+
+	ret = epd_group_fb_flush(group, true);
+	if (ret && ret != -ENODEV)
+		pr_err(DRIVER_NAME ": group flush of '%s' failed: %d\n",
+		       group->name, ret);
+}
+
+/*
+ * Grow the group framebuffer's damage rectangle. Safe to call from atomic
+ * context.
+ */
+void epd_group_damage_add(struct epd_group *group, u32 x, u32 y, u32 width,
+			  u32 height)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&group->damage_lock, flags);
+	epd_area_grow(&group->damage, &group->damage_set, x, y, width, height,
+		      group->width, group->height);
+	spin_unlock_irqrestore(&group->damage_lock, flags);
+}
+
+/* Group counterparts of epd_flush_defer() and epd_flush_coalesce() */
+void epd_group_flush_defer(struct epd_group *group, unsigned int idle_ms)
+{
+	mod_delayed_work(system_wq, &group->flush_work,
+			 msecs_to_jiffies(idle_ms));
+}
+
+void epd_group_flush_coalesce(struct epd_group *group, unsigned int delay_ms)
+{
+	queue_delayed_work(system_wq, &group->flush_work,
+			   msecs_to_jiffies(delay_ms));
+}
+
+/* Run a pending deferred group flush right away */
+int epd_group_flush_deferred_sync(struct epd_group *group)
+{
+	if (cancel_delayed_work_sync(&group->flush_work))
+		return epd_group_fb_flush(group, true);
+
+	return 0;
+}
+
+int epd_group_join(struct epd_dev *epd)
+{
+	struct device_node *np = epd->spi->dev.of_node;
+	enum epd_group_mode mode;
+	struct epd_group *group;
+	const char *name;
+	bool created = false;
+	int ret;
+
+	INIT_LIST_HEAD(&epd->group_node);
+
+	if (of_property_read_string(np, "pamir-ai,group", &name))
+		return 0;
+
+	ret = epd_group_parse_mode(np, &mode);
+	if (ret) {
+		dev_err(&epd->spi->dev, "Invalid 'pamir-ai,group-mode'\n");
+		return ret;
+	}
+
+	mutex_lock(&epd_groups_lock);
+
+	group = epd_group_find(name);
+	if (!group) {
+		group = kzalloc(sizeof(*group), GFP_KERNEL);
+		if (!group) {
+			ret = -ENOMEM;
+			goto out_unlock;
+		}
+
+		group->name = kstrdup(name, GFP_KERNEL);
+		if (!group->name) {
+			kfree(group);
+			ret = -ENOMEM;
+			goto out_unlock;
+		}
+
+		INIT_LIST_HEAD(&group->members);
+		mutex_init(&group->lock);
+		spin_lock_init(&group->damage_lock);
+		INIT_DELAYED_WORK(&group->flush_work, epd_group_flush_work_fn);
+		group->mode = mode;
+		list_add_tail(&group->node, &epd_groups);
+		created = true;
+	} else if (group->mode != mode) {
+		dev_err(&epd->spi->dev, "Group mode does not match group '%s'\n",
+			name);
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	mutex_lock(&group->lock);
+	if (mode == EPD_GROUP_TILED)
+		ret = epd_group_check_tile(group, epd);
+	else if (mode == EPD_GROUP_MIRROR)
+		ret = epd_group_check_mirror(group, epd);
+	if (ret) {
+		mutex_unlock(&group->lock);
+		goto out_free_group;
+	}
+	list_add_tail(&epd->group_node, &group->members);
+	group->nr_members++;
+	epd->group = group;
+	mutex_unlock(&group->lock);
+
+	dev_info(&epd->spi->dev, "Joined panel group '%s' (%u members)\n",
+		 group->name, group->nr_members);
+
+	if (mode != EPD_GROUP_SYNC && group->nr_members == group->nr_expected) {
+		ret = epd_group_fb_register(group, epd);
+		if (ret)
+			dev_warn(&epd->spi->dev,
+				 "Failed to register group framebuffer: %d\n",
+				 ret);
+		ret = 0;
+	}
+
+out_unlock:
+	mutex_unlock(&epd_groups_lock);
+	return ret;
+
+out_free_group:
+	if (created) {
+		list_del(&group->node);
+		kfree(group->name);
+		kfree(group);
+	}
+	mutex_unlock(&epd_groups_lock);
+	return ret;
+}
+
+void epd_group_leave(struct epd_dev *epd)
+{
+	struct epd_group *group = epd->group;
+	bool empty;
+
+	if (!group)
+		return;
+
+	mutex_lock(&epd_groups_lock);
+
+	/* The group framebuffer is incomplete without this member */
+	epd_group_fb_unregister(group);
+
+	/* Waits for any group flush still using this panel */
+	mutex_lock(&group->lock);
+	list_del_init(&epd->group_node);
+	group->nr_members--;
+	empty = !group->nr_members;
+	epd->group = NULL;
+	mutex_unlock(&group->lock);
+
+	if (empty) {
+		list_del(&group->node);
+		kfree(group->name);
+		kfree(group);
+	}
+
+	mutex_unlock(&epd_groups_lock);
+}
+
+int epd_group_flush(struct epd_dev *epd)
+{
+	struct epd_group *group = epd->group;
+	struct epd_dev *member;
+	int ret;
+
+	if (!group)
+		return epd_display_flush(epd);
+
+	mutex_lock(&group->lock);
+
+	/* Fan out first so every bus is busy before we block on any of them */
+	list_for_each_entry(member, &group->members, group_node)
+		epd_group_queue(member);
+
+	ret = epd_group_wait(group);
+
+	mutex_unlock(&group->lock);
+	return ret;
+}
+
+/* True when the member refreshes only the requested area */
+static bool epd_group_member_partial(struct epd_group *group,
+				     struct epd_dev *member)
+{
+	return group->update_mode == EPD_MODE_PARTIAL &&
+	       (member->ctrl->caps & EPD_CAP_PARTIAL);
+}
+
+/*
+ * Copy the damaged part of one tile out of the spanning framebuffer and
+ * request a refresh of it. A member that refreshes in full gets the whole
+ * tile, since its framebuffer may hold something else outside the damage.
+ * Returns false if the damage does not touch this tile.
+ */
+static bool epd_tiled_prepare(struct epd_group *group, struct epd_dev *member,
+			      const struct epd_update_area *damage)
+{
+	struct epd_group_req *req = &member->group_req;
+	const u8 *src = group->info->screen_base;
+	u8 *dst = member->info->screen_base;
+	u32 tx = member->tile_col * group->tile_width;
+	u32 ty = member->tile_row * group->tile_height;
+	u32 x0 = max_t(u32, damage->x, tx);
+	u32 y0 = max_t(u32, damage->y, ty);
+	u32 x1 = min_t(u32, damage->x + damage->width, tx + group->tile_width);
+	u32 y1 = min_t(u32, damage->y + damage->height,
+		       ty + group->tile_height);
+	u32 y;
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	mutex_lock(&member->lock);
+
+	req->pending = true;
+	req->mode = group->update_mode;
+	req->frame = NULL;
+	req->area_set = epd_group_member_partial(group, member);
+	if (req->area_set) {
+		req->area.x = x0 - tx;
+		req->area.y = y0 - ty;
+		req->area.width = x1 - x0;
+		req->area.height = y1 - y0;
+	} else {
+		x0 = tx;
+		y0 = ty;
+		x1 = tx + group->tile_width;
+		y1 = ty + group->tile_height;
+	}
+
+	for (y = y0; y < y1; y++)
+		memcpy(dst + (y - ty) * member->bytes_per_line + (x0 - tx) / 8,
+		       src + y * group->bytes_per_line + x0 / 8, (x1 - x0) / 8);
+
+	mutex_unlock(&member->lock);
+	return true;
+}
+
+/*
+ * Let a member upload straight from the shared staging buffer instead of
+ * copying the frame into the panel's own framebuffer.
+ */
+static void epd_mirror_prepare(struct epd_group *group, struct epd_dev *member,
+			       const struct epd_update_area *damage)
+{
+	struct epd_group_req *req = &member->group_req;
+
+	mutex_lock(&member->lock);
+
+	req->pending = true;
+	req->mode = group->update_mode;
+	req->frame = group->staging;
+	req->area_set = epd_group_member_partial(group, member);
+	if (req->area_set)
+		req->area = *damage;
+
+	mutex_unlock(&member->lock);
+}
+
+/* True when no mirror member needs more than the damaged rows */
+static bool epd_mirror_all_partial(struct epd_group *group)
+{
+	struct epd_dev *member;
+
+	list_for_each_entry(member, &group->members, group_node) {
+		if (!epd_group_member_partial(group, member))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * damage_only is set for the deferred write and fbcon flushes; explicit
+ * updates without a partial area refresh the whole group framebuffer.
+ */
+int epd_group_fb_flush(struct epd_group *group, bool damage_only)
+{
+	struct epd_update_area damage;
+	struct epd_dev *member;
+	bool damage_set;
+	int ret;
+
+	mutex_lock(&group->lock);
+
+	if (!group->info) {
+		mutex_unlock(&group->lock);
+		return -ENODEV;
+	}
+
+	spin_lock_irq(&group->damage_lock);
+	damage_set = damage_only && group->damage_set;
+	if (damage_set)
+		damage = group->damage;
+	group->damage_set = false;
+	spin_unlock_irq(&group->damage_lock);
+
+	/* An explicit partial area wins, then what was drawn */
+	if (group->partial_area_set) {
+		damage = group->partial_area;
+	} else if (!damage_set) {
+		damage.x = 0;
+		damage.y = 0;
+		damage.width = group->width;
+		damage.height = group->height;
+	}
+
+	if (group->mode == EPD_GROUP_MIRROR) {
+		/* Snapshot the damaged rows, or all of them for a full refresh */
+		size_t offset = 0;
+		size_t len = group->screensize;
+
+		if (epd_mirror_all_partial(group)) {
+			offset = damage.y * group->bytes_per_line;
+			len = damage.height * group->bytes_per_line;
+		}
+
+		memcpy(group->staging + offset,
+		       group->info->screen_base + offset, len);
+
+		list_for_each_entry(member, &group->members, group_node) {
+			epd_mirror_prepare(group, member, &damage);
+			epd_group_queue(member);
+		}
+	} else {
+		/* Only panels the damage touches are uploaded and refreshed */
+		list_for_each_entry(member, &group->members, group_node) {
+			if (epd_tiled_prepare(group, member, &damage))
+				epd_group_queue(member);
+		}
+	}
+
+	ret = epd_group_wait(group);
+
+	/* Drop requests a failed or skipped flush left behind */
+	list_for_each_entry(member, &group->members, group_node) {
+		mutex_lock(&member->lock);
+		member->group_req.pending = false;
+		member->group_req.frame = NULL;
+		mutex_unlock(&member->lock);
+	}
+
+	mutex_unlock(&group->lock);
+	return ret;
+}
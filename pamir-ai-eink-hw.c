@@ -9,15 +9,184 @@
 #include <linux/spi/spi.h>
 #include <linux/gpio/consumer.h>
 #include <linux/delay.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
 
 #include "pamir-ai-eink-internal.h"
 
+struct epd_spi_batch {
+	struct completion done;
+	atomic_t pending;
+	int status;
+};
+
+struct epd_spi_chunk {
+	struct spi_message msg;
+	struct spi_transfer xfer;
+	struct epd_spi_batch *batch;
+};
+
+static void epd_spi_chunk_complete(void *context)
+{
+	struct epd_spi_chunk *chunk = context;
+	struct epd_spi_batch *batch = chunk->batch;
+
+	if (chunk->msg.status)
+		cmpxchg(&batch->status, 0, chunk->msg.status);
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+const char * const epd_bus_mode_names[] = {
+	[EPD_BUS_QUEUED] = "queued",
+	[EPD_BUS_SHARED] = "shared",
+	[EPD_BUS_EXCLUSIVE] = "exclusive",
+	NULL,
+};
+
+static int epd_spi_write_one(struct epd_dev *epd, const u8 *buf, size_t len)
+{
+	struct spi_transfer xfer = {
+		.tx_buf = buf,
+		.len = len,
+	};
+	struct spi_message msg;
+
+	spi_message_init_with_transfers(&msg, &xfer, 1);
+
+	if (epd->bus_locked)
+		return spi_sync_locked(epd->spi, &msg);
+
+	return spi_sync(epd->spi, &msg);
+}
+
+/*
+ * Send chunk by chunk, waiting for each one. On a shared bus the pause
+ * between chunks lets messages of other devices on the controller through;
+ * with the bus locked there is nobody to wait for.
+ */
+static int epd_spi_write_sync(struct epd_dev *epd, const u8 *buf, size_t len,
+			      size_t chunk, unsigned int yield_us)
+{
+	size_t offset;
+	int ret;
+
+	for (offset = 0; offset < len; offset += chunk) {
+		ret = epd_spi_write_one(epd, buf + offset,
+					min(chunk, len - offset));
+		if (ret)
+			return ret;
+
+		if (offset + chunk >= len)
+			break;
+
+		if (yield_us)
+			usleep_range(yield_us, yield_us + yield_us / 4 + 1);
+		else
+			cond_resched();
+	}
+
+	return 0;
+}
+
+/*
+ * Split a write into chunks the controller can take in one transfer and
+ * queue them all with spi_async(), so the next chunk is already waiting
+ * when the previous one finishes.
+ */
+static int epd_spi_write_queued(struct epd_dev *epd, const u8 *buf,
+				size_t len, size_t max)
+{
+	unsigned int i, nr_chunks = DIV_ROUND_UP(len, max);
+	struct epd_spi_chunk *chunks;
+	struct epd_spi_batch batch;
+	int ret = 0;
+
+	if (nr_chunks <= 1)
+		return epd_spi_write_one(epd, buf, len);
+
+	chunks = kvcalloc(nr_chunks, sizeof(*chunks), GFP_KERNEL);
+	if (!chunks)
+		return -ENOMEM;
+
+	init_completion(&batch.done);
+	atomic_set(&batch.pending, nr_chunks);
+	batch.status = 0;
+
+	for (i = 0; i < nr_chunks; i++) {
+		struct epd_spi_chunk *chunk = &chunks[i];
+		size_t offset = i * max;
+
+		chunk->xfer.tx_buf = buf + offset;
+		chunk->xfer.len = min(max, len - offset);
+		chunk->batch = &batch;
+		spi_message_init_with_transfers(&chunk->msg, &chunk->xfer, 1);
+		chunk->msg.complete = epd_spi_chunk_complete;
+		chunk->msg.context = chunk;
+
+		ret = spi_async(epd->spi, &chunk->msg);
+		if (ret)
+			break;
+	}
+
+	/* Chunks that were never queued will not complete on their own */
+	if (i < nr_chunks && atomic_sub_and_test(nr_chunks - i, &batch.pending))
+		complete(&batch.done);
+
+	wait_for_completion(&batch.done);
+	kvfree(chunks);
+
+	return ret ? ret : batch.status;
+}
+
+static int epd_spi_write(struct epd_dev *epd, const u8 *buf, size_t len)
+{
+	size_t max = spi_max_transfer_size(epd->spi);
+
+	switch (epd->bus_mode) {
+	case EPD_BUS_SHARED:
+		return epd_spi_write_sync(epd, buf, len,
+					  min_t(size_t, epd->spi_chunk_size,
+						max),
+					  epd->spi_yield_us);
+	case EPD_BUS_EXCLUSIVE:
+		return epd_spi_write_sync(epd, buf, len, max, 0);
+	default:
+		return epd_spi_write_queued(epd, buf, len, max);
+	}
+}
+
+/*
+ * In exclusive mode the bus stays locked for a whole command sequence, so
+ * no other device on the controller can slip in between its transfers.
+ * Callers hold epd->lock.
+ */
+void epd_bus_begin(struct epd_dev *epd)
+{
+	if (epd->bus_mode != EPD_BUS_EXCLUSIVE)
+		return;
+
+	spi_bus_lock(epd->spi->controller);
+	epd->bus_locked = true;
+}
+
+void epd_bus_end(struct epd_dev *epd)
+{
+	if (!epd->bus_locked)
+		return;
+
+	epd->bus_locked = false;
+	spi_bus_unlock(epd->spi->controller);
+}
+
 int epd_send_cmd(struct epd_dev *epd, u8 cmd)
 {
 	int ret;
 
 	gpiod_set_value_cansleep(epd->dc_gpio, 0);
-	ret = spi_write(epd->spi, &cmd, 1);
+	ret = epd_spi_write_one(epd, &cmd, 1);
+	epd_trace_event(epd, EPD_TRACE_CMD, cmd, NULL, 0, ret);
 	if (ret)
 		dev_err(&epd->spi->dev, "Failed to send command 0x%02x: %d\n",
 			cmd, ret);
@@ -33,7 +202,8 @@ int epd_send_data_buf(struct epd_dev *epd, const u8 *buf, size_t len)
 		return 0;
 
 	gpiod_set_value_cansleep(epd->dc_gpio, 1);
-	ret = spi_write(epd->spi, buf, len);
+	ret = epd_spi_write(epd, buf, len);
+	epd_trace_event(epd, EPD_TRACE_DATA, 0, buf, len, ret);
 	if (ret)
 		dev_err(&epd->spi->dev, "SPI write failed (%zu bytes): %d\n",
 			len, ret);
@@ -49,185 +219,40 @@ int epd_wait_busy(struct epd_dev *epd, unsigned int timeout_ms)
 		return 0;
 
 	while (elapsed < timeout_ms) {
-		if (gpiod_get_value_cansleep(epd->busy_gpio) == 0)
+		if (gpiod_get_value_cansleep(epd->busy_gpio) == 0) {
+			epd_trace_event(epd, EPD_TRACE_BUSY, 0, NULL, elapsed,
+					0);
 			return 0;
+		}
 
 		usleep_range(EPD_BUSY_POLL_INTERVAL_MS * 1000,
 			     EPD_BUSY_POLL_INTERVAL_MS * 1000 + 1000);
 		elapsed += EPD_BUSY_POLL_INTERVAL_MS;
 	}
 
+	epd_trace_event(epd, EPD_TRACE_BUSY, 0, NULL, elapsed, -ETIMEDOUT);
 	dev_warn(&epd->spi->dev, "Busy timeout after %u ms\n", timeout_ms);
 	return -ETIMEDOUT;
 }
 
-int epd_set_ram_area(struct epd_dev *epd, u16 x_start, u16 y_start, u16 x_end,
-		     u16 y_end)
-{
-	u8 data[4];
-	int ret;
-
-	x_start = x_start / 8;
-	x_end = x_end / 8;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_X);
-	if (ret)
-		return ret;
-
-	data[0] = x_start;
-	data[1] = x_end;
-	ret = epd_send_data_buf(epd, data, 2);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_Y);
-	if (ret)
-		return ret;
-
-	data[0] = y_start & 0xff;
-	data[1] = (y_start >> 8) & 0xff;
-	data[2] = y_end & 0xff;
-	data[3] = (y_end >> 8) & 0xff;
-	ret = epd_send_data_buf(epd, data, 4);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_X_COUNT);
-	if (ret)
-		return ret;
-
-	data[0] = x_start;
-	ret = epd_send_data_buf(epd, data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_Y_COUNT);
-	if (ret)
-		return ret;
-
-	data[0] = y_start & 0xff;
-	data[1] = (y_start >> 8) & 0xff;
-	ret = epd_send_data_buf(epd, data, 2);
-
-	return ret;
-}
-
-int epd_hw_init(struct epd_dev *epd)
+void epd_hw_reset(struct epd_dev *epd)
 {
-	u8 data[4];
-	int ret;
-
-	/* Try deep sleep command first to recover from stuck state */
-	/* This doesn't require busy wait and can help unstick the controller */
-	epd_send_cmd(epd, EPD_CMD_DEEP_SLEEP_MODE);
-	usleep_range(10000, 15000);
-
-	/* SSD1680 datasheet timing */
+	epd_trace_event(epd, EPD_TRACE_RESET, 0, NULL, 0, 0);
 	gpiod_set_value_cansleep(epd->reset_gpio, 0);
 	udelay(EPD_RESET_PULSE_US);
 	gpiod_set_value_cansleep(epd->reset_gpio, 1);
 	usleep_range(10000, 15000);
+}
 
-	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SW_RESET);
-	if (ret)
-		return ret;
-
-	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_DRIVER_OUTPUT_CTRL);
-	if (ret)
-		return ret;
-
-	data[0] = (epd->height - 1) & 0xff;
-	data[1] = ((epd->height - 1) >> 8) & 0xff;
-	data[2] = 0x00;
-	ret = epd_send_data_buf(epd, data, 3);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_DATA_ENTRY_MODE);
-	if (ret)
-		return ret;
-
-	data[0] = 0x03; /* X-increment, Y-increment */
-	ret = epd_send_data_buf(epd, data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_X);
-	if (ret)
-		return ret;
-
-	data[0] = 0x00;
-	data[1] = (epd->width / 8) - 1;
-	ret = epd_send_data_buf(epd, data, 2);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_Y);
-	if (ret)
-		return ret;
-
-	data[0] = (epd->height - 1) & 0xff;
-	data[1] = ((epd->height - 1) >> 8) & 0xff;
-	data[2] = 0x00;
-	data[3] = 0x00;
-	ret = epd_send_data_buf(epd, data, 4);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_BORDER_WAVEFORM);
-	if (ret)
-		return ret;
-
-	data[0] = 0x05;
-	ret = epd_send_data_buf(epd, data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_DISPLAY_UPDATE_CTRL1);
-	if (ret)
-		return ret;
-
-	data[0] = 0x00;
-	data[1] = 0x80;
-	ret = epd_send_data_buf(epd, data, 2);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_TEMP_SENSOR_READ);
-	if (ret)
-		return ret;
-
-	data[0] = 0x80;
-	ret = epd_send_data_buf(epd, data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_X_COUNT);
-	if (ret)
-		return ret;
-
-	data[0] = 0x00;
-	ret = epd_send_data_buf(epd, data, 1);
-	if (ret)
-		return ret;
-
-	ret = epd_send_cmd(epd, EPD_CMD_SET_RAM_Y_COUNT);
-	if (ret)
-		return ret;
+int epd_hw_init(struct epd_dev *epd)
+{
+	int ret;
 
-	data[0] = 0x00;
-	data[1] = 0x00;
-	ret = epd_send_data_buf(epd, data, 2);
-	if (ret)
-		return ret;
+	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
+	ret = epd->ctrl->init(epd);
+	epd_bus_end(epd);
+	mutex_unlock(&epd->lock);
 
-	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	return ret;
 }
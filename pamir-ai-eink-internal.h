@@ -9,44 +9,144 @@
 #define _PAMIR_AI_EINK_INTERNAL_H
 
 #include <linux/fb.h>
+#include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <linux/spi/spi.h>
 #include <linux/gpio/consumer.h>
 #include "pamir-ai-eink.h"
 
 #define DRIVER_NAME "pamir-ai-eink"
 
-#define EPD_CMD_DRIVER_OUTPUT_CTRL 0x01
-#define EPD_CMD_DEEP_SLEEP_MODE 0x10
-#define EPD_CMD_DATA_ENTRY_MODE 0x11
-#define EPD_CMD_SW_RESET 0x12
-#define EPD_CMD_TEMP_SENSOR_READ 0x18
-#define EPD_CMD_ACTIVATE 0x20
-#define EPD_CMD_DISPLAY_UPDATE_CTRL1 0x21
-#define EPD_CMD_DISPLAY_UPDATE_CTRL2 0x22
-#define EPD_CMD_WRITE_RAM_BW 0x24
-#define EPD_CMD_WRITE_RAM_RED 0x26
-#define EPD_CMD_BORDER_WAVEFORM 0x3C
-#define EPD_CMD_SET_RAM_X 0x44
-#define EPD_CMD_SET_RAM_Y 0x45
-#define EPD_CMD_SET_RAM_X_COUNT 0x4E
-#define EPD_CMD_SET_RAM_Y_COUNT 0x4F
-
-#define EPD_UPDATE_MODE_FULL 0xF7
-#define EPD_UPDATE_MODE_PARTIAL 0xFF
-
-#define EPD_BORDER_NORMAL 0x05
-#define EPD_BORDER_PARTIAL 0x80
-
 #define EPD_RESET_PULSE_US 200 /* per SSD1680 datasheet */
 #define EPD_RESET_INIT_MS 10
 #define EPD_BUSY_TIMEOUT_INIT_MS 2000
 #define EPD_BUSY_TIMEOUT_UPDATE_MS 10000
 #define EPD_BUSY_POLL_INTERVAL_MS 5
 
+#define EPD_SPI_CHUNK_SIZE_DEFAULT 256
+#define EPD_SPI_YIELD_US_DEFAULT 100
+
+/* Idle time after the last write() before its damage is flushed */
+#define EPD_WRITE_IDLE_MS 20
+
+/* Longest a console drawing waits before its damage is flushed */
+#define EPD_CONSOLE_FLUSH_MS 50
+
+/* SCHED_FIFO priority of the flush worker, 0 for SCHED_NORMAL */
+#define EPD_FLUSH_PRIORITY_DEFAULT 50
+
+/* Frame slots in the streaming ring, and the longest dwell per frame */
+#define EPD_STREAM_SLOTS 8
+#define EPD_STREAM_MAX_DWELL_MS 60000
+
+enum epd_governor {
+	EPD_GOV_LATENCY,
+	EPD_GOV_THROUGHPUT,
+	EPD_GOV_POWER,
+	EPD_GOV_CUSTOM,
+};
+
+/* Pacing applied by the flush worker */
+struct epd_governor_params {
+	unsigned int min_interval_ms;	/* Between refresh starts */
+	unsigned int batch_delay_ms;	/* Held back to batch more requests */
+	unsigned int full_interval_ms;	/* Between full or base map refreshes */
+};
+
+enum epd_trace_event {
+	EPD_TRACE_CMD,
+	EPD_TRACE_DATA,
+	EPD_TRACE_BUSY,
+	EPD_TRACE_RESET,
+};
+
+#ifdef CONFIG_DEBUG_FS
+/* Command stream capture in debugfs, see pamir-ai-eink-trace.c */
+struct epd_trace {
+	struct dentry *dir;
+	struct mutex lock;	/* Serializes buffer replacement and readers */
+	spinlock_t slock;	/* Protects appends */
+	bool enabled;
+	bool payload;		/* Also record data bytes */
+	u32 size;		/* Buffer size for the next capture */
+	u8 *buf;
+	size_t buf_size;	/* Allocated length of buf */
+	size_t used;
+	u32 dropped;		/* Events that did not fit */
+	ktime_t start;
+};
+#endif
+
+/* Ring of frames played by the flush worker, see pamir-ai-eink-stream.c */
+struct epd_stream {
+	struct mutex lock;		/* Serializes start, stop and mmap */
+	struct epd_stream_ring *ring;	/* Shared with userspace */
+	size_t ring_size;
+	u32 slot_size;
+	u32 tail;			/* Ours, ring->tail is only a copy */
+	bool active;
+	int error;
+	u64 frames;			/* Played since the last start */
+	struct kthread_delayed_work work;
+	wait_queue_head_t wq;
+};
+
+/*
+ * Refresh requested by a tiled or mirror group. It applies to the next
+ * flush only, so the panel's own mode and partial area are left alone.
+ */
+struct epd_group_req {
+	bool pending;
+	enum epd_update_mode mode;
+	struct epd_update_area area;
+	bool area_set;
+	const u8 *frame;		/* NULL for the panel's framebuffer */
+};
+
+#define EPD_CAP_PARTIAL BIT(0)
+#define EPD_CAP_FAST BIT(1)
+#define EPD_CAP_BASE_MAP BIT(2)
+
+struct epd_dev;
+struct epd_group;
+struct vm_area_struct;
+
+enum epd_bus_mode {
+	EPD_BUS_QUEUED = 0,	/* all chunks queued back-to-back */
+	EPD_BUS_SHARED,		/* bounded chunks, bus released in between */
+	EPD_BUS_EXCLUSIVE,	/* bus locked for a whole command sequence */
+};
+
+/*
+ * Per-controller command sequences, selected by compatible string. The
+ * display layer validates requests and serializes access; the ops only
+ * talk to the panel. Missing capabilities fall back to a full update.
+ */
+struct epd_controller {
+	const char *name;
+	unsigned int caps;
+	u32 max_width;
+	u32 max_height;
+	int (*init)(struct epd_dev *epd);
+	int (*full_update)(struct epd_dev *epd, const u8 *buf);
+	int (*fast_update)(struct epd_dev *epd, const u8 *buf);
+	int (*partial_update)(struct epd_dev *epd, const u8 *buf,
+			      const struct epd_update_area *area);
+	int (*base_map_update)(struct epd_dev *epd, const u8 *buf);
+	int (*clear)(struct epd_dev *epd);
+	int (*deep_sleep)(struct epd_dev *epd);
+	const void *priv;
+};
+
 struct epd_dev {
 	struct spi_device *spi;
 	struct fb_info *info;
+	const struct epd_controller *ctrl;
 	struct gpio_desc *reset_gpio;
 	struct gpio_desc *dc_gpio;
 	struct gpio_desc *busy_gpio;
@@ -60,23 +160,169 @@ struct epd_dev {
 	struct epd_update_area partial_area;
 	bool partial_area_set;
 	bool initialized;
+	spinlock_t damage_lock;
+	struct epd_update_area damage;	/* Written since the last refresh */
+	bool damage_set;
+	const u8 *frame;
+	enum epd_bus_mode bus_mode;
+	bool bus_locked;
+	size_t spi_chunk_size;
+	unsigned int spi_yield_us;
+	struct kthread_worker *flush_worker;
+	struct kthread_delayed_work flush_work;
+	struct kthread_delayed_work defer_work;
+	u64 defer_seq;
+	spinlock_t flush_slock;
+	wait_queue_head_t flush_done_wq;
+	u64 flush_req_seq;
+	u64 flush_done_seq;
+	u64 flush_panel_seq;	/* Last request not limited to the damage */
+	int flush_ret;
+	int flush_priority;
+	int flush_cpu;
+	enum epd_governor governor;
+	struct epd_governor_params gov;
+	ktime_t flush_last;
+	ktime_t flush_last_full;
+	struct epd_stream stream;
+	u64 group_seq;		/* Flush to wait for in a group update */
+	struct epd_group_req group_req;	/* Protected by lock */
+	struct epd_group *group;
+	struct list_head group_node;
+	u32 tile_col;
+	u32 tile_row;
+#ifdef CONFIG_DEBUG_FS
+	struct epd_trace trace;
+#endif
 };
 
+enum epd_group_mode {
+	EPD_GROUP_SYNC = 0,
+	EPD_GROUP_TILED,
+	EPD_GROUP_MIRROR,
+};
+
+/*
+ * Panels sharing a "pamir-ai,group" name in the device tree. A group update
+ * requests a flush from every member's worker at once so panels on
+ * different SPI buses or chip selects refresh concurrently.
+ *
+ * Tiled and mirror groups additionally expose one group framebuffer,
+ * registered once every expected member has probed. Tiled groups span
+ * cols x rows equally sized panels; mirror groups show the same frame on
+ * every member, uploaded from one shared staging snapshot.
+ */
+struct epd_group {
+	struct list_head node;
+	struct list_head members;
+	struct mutex lock;
+	const char *name;
+	unsigned int nr_members;
+	enum epd_group_mode mode;
+	unsigned int nr_expected;
+
+	/* Tiled and mirror mode only */
+	u32 cols;
+	u32 rows;
+	u32 tile_width;
+	u32 tile_height;
+	struct fb_info *info;
+	u8 *staging;
+	u32 width;
+	u32 height;
+	u32 bytes_per_line;
+	size_t screensize;
+	size_t alloc_size;
+	enum epd_update_mode update_mode;
+	struct epd_update_area partial_area;
+	bool partial_area_set;
+	spinlock_t damage_lock;
+	struct epd_update_area damage;	/* Written since the last flush */
+	bool damage_set;
+	struct delayed_work flush_work;	/* Deferred writes and fbcon */
+};
+
+/* Buffer the update pipeline uploads from */
+static inline const u8 *epd_frame(struct epd_dev *epd)
+{
+	return epd->frame ? epd->frame : (const u8 *)epd->info->screen_base;
+}
+
 int epd_send_cmd(struct epd_dev *epd, u8 cmd);
 int epd_send_data_buf(struct epd_dev *epd, const u8 *buf, size_t len);
 int epd_wait_busy(struct epd_dev *epd, unsigned int timeout_ms);
+void epd_bus_begin(struct epd_dev *epd);
+void epd_bus_end(struct epd_dev *epd);
+void epd_hw_reset(struct epd_dev *epd);
 int epd_hw_init(struct epd_dev *epd);
-int epd_set_ram_area(struct epd_dev *epd, u16 x_start, u16 y_start, u16 x_end,
-		     u16 y_end);
 
 int epd_full_update(struct epd_dev *epd);
+int epd_fast_update(struct epd_dev *epd);
 int epd_partial_update(struct epd_dev *epd);
 int epd_base_map_update(struct epd_dev *epd);
-int epd_display_flush(struct epd_dev *epd);
+int epd_display_update(struct epd_dev *epd, bool damage_only);
+int epd_stream_update(struct epd_dev *epd, const struct epd_update_area *area,
+		      bool full);
+void epd_area_grow(struct epd_update_area *area, bool *area_set, u32 x,
+		   u32 y, u32 width, u32 height, u32 max_width, u32 max_height);
+void epd_damage_add(struct epd_dev *epd, u32 x, u32 y, u32 width,
+		    u32 height);
 int epd_clear_display(struct epd_dev *epd);
 int epd_deep_sleep(struct epd_dev *epd);
 
+int epd_flush_init(struct epd_dev *epd);
+void epd_flush_destroy(struct epd_dev *epd);
+int epd_flush_set_sched(struct epd_dev *epd, int priority, int cpu);
+void epd_flush_set_governor(struct epd_dev *epd, enum epd_governor governor);
+u64 epd_flush_request(struct epd_dev *epd);
+unsigned int epd_flush_claim(struct epd_dev *epd, bool full);
+int epd_flush_wait(struct epd_dev *epd, u64 seq);
+int epd_display_flush(struct epd_dev *epd);
+void epd_flush_defer(struct epd_dev *epd, unsigned int idle_ms);
+void epd_flush_coalesce(struct epd_dev *epd, unsigned int delay_ms);
+int epd_flush_deferred_sync(struct epd_dev *epd);
+
+void epd_stream_init(struct epd_dev *epd);
+void epd_stream_destroy(struct epd_dev *epd);
+int epd_stream_start(struct epd_dev *epd, struct epd_stream_info *info);
+void epd_stream_stop(struct epd_dev *epd);
+int epd_stream_kick(struct epd_dev *epd);
+int epd_stream_wait(struct epd_dev *epd, u32 free);
+int epd_stream_play(struct epd_dev *epd, u32 *dwell_ms);
+int epd_stream_mmap(struct epd_dev *epd, struct vm_area_struct *vma);
+
+#ifdef CONFIG_DEBUG_FS
+void epd_trace_init(struct epd_dev *epd);
+void epd_trace_destroy(struct epd_dev *epd);
+void epd_trace_event(struct epd_dev *epd, enum epd_trace_event event,
+		     u8 cmd, const u8 *buf, size_t len, int ret);
+#else
+static inline void epd_trace_init(struct epd_dev *epd) {}
+static inline void epd_trace_destroy(struct epd_dev *epd) {}
+static inline void epd_trace_event(struct epd_dev *epd,
+				   enum epd_trace_event event, u8 cmd,
+				   const u8 *buf, size_t len, int ret) {}
+#endif
+
+int epd_group_join(struct epd_dev *epd);
+void epd_group_leave(struct epd_dev *epd);
+int epd_group_flush(struct epd_dev *epd);
+int epd_group_fb_flush(struct epd_group *group, bool damage_only);
+void epd_group_damage_add(struct epd_group *group, u32 x, u32 y, u32 width,
+			  u32 height);
+void epd_group_flush_defer(struct epd_group *group, unsigned int idle_ms);
+void epd_group_flush_coalesce(struct epd_group *group, unsigned int delay_ms);
+int epd_group_flush_deferred_sync(struct epd_group *group);
+
+extern const char * const epd_bus_mode_names[];
+extern const char * const epd_governor_names[];
+
+extern const struct epd_controller epd_ssd1680_controller;
+extern const struct epd_controller epd_ssd1683_controller;
+extern const struct epd_controller epd_uc8179_controller;
+
 extern const struct fb_ops epd_fb_ops;
+extern const struct fb_ops epd_group_fb_ops;
 
 extern const struct attribute_group epd_attr_group;
 
@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Behavioral SSD168x model for Pamir AI E-Ink display
+ *
+ * Decodes the same command stream the driver sends to the controller and
+ * keeps enough state to check it: RAM contents, address counters, BUSY
+ * timing and what the panel would physically show. The model only uses
+ * plain integer arithmetic so that the KUnit suite and the userspace
+ * harness in host/ can both build it.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "pamir-ai-eink-sim.h"
+
+#define EPD_SIM_CMD_DEEP_SLEEP_MODE 0x10
+#define EPD_SIM_CMD_DATA_ENTRY_MODE 0x11
+#define EPD_SIM_CMD_SW_RESET 0x12
+#define EPD_SIM_CMD_TEMP_SENSOR_WRITE 0x1A
+#define EPD_SIM_CMD_ACTIVATE 0x20
+#define EPD_SIM_CMD_DISPLAY_UPDATE_CTRL2 0x22
+#define EPD_SIM_CMD_WRITE_RAM_BW 0x24
+#define EPD_SIM_CMD_WRITE_RAM_RED 0x26
+#define EPD_SIM_CMD_SET_RAM_X 0x44
+#define EPD_SIM_CMD_SET_RAM_Y 0x45
+#define EPD_SIM_CMD_SET_RAM_X_COUNT 0x4E
+#define EPD_SIM_CMD_SET_RAM_Y_COUNT 0x4F
+
+/* Data entry mode bits */
+#define EPD_SIM_ENTRY_X_INC BIT(0)
+#define EPD_SIM_ENTRY_Y_INC BIT(1)
+#define EPD_SIM_ENTRY_Y_FIRST BIT(2)
+
+/* Display update control 2 sequence bits */
+#define EPD_SIM_SEQ_LOAD_TEMP BIT(5)
+#define EPD_SIM_SEQ_LOAD_LUT BIT(4)
+#define EPD_SIM_SEQ_MODE2 BIT(3)
+#define EPD_SIM_SEQ_DISPLAY BIT(2)
+
+/* BUSY durations at 25 C, in ms */
+#define EPD_SIM_SW_RESET_MS 2
+#define EPD_SIM_TEMP_READ_MS 5
+#define EPD_SIM_LUT_LOAD_MS 5
+#define EPD_SIM_MODE1_MS 3000
+#define EPD_SIM_MODE2_MS 400
+
+/* LUTs loaded at or above this temperature are the short waveforms */
+#define EPD_SIM_FAST_LUT_TEMP 50
+
+/* Share of a driven pixel's previous error left after a refresh, in 1/1000 */
+#define EPD_SIM_RESIDUAL_FULL 10
+#define EPD_SIM_RESIDUAL_FAST 60
+#define EPD_SIM_RESIDUAL_PARTIAL 120
+
+size_t epd_sim_mem_size(u32 width, u32 height)
+{
+	size_t plane = (size_t)DIV_ROUND_UP(width, 8) * height;
+
+	return 3 * plane + (size_t)width * height;
+}
+
+/* Power-on defaults of the registers; RAM is left alone */
+static void epd_sim_reset_regs(struct epd_sim *sim)
+{
+	sim->cmd = 0;
+	sim->nr_params = 0;
+	sim->entry_mode = EPD_SIM_ENTRY_X_INC | EPD_SIM_ENTRY_Y_INC;
+	sim->x_start = 0;
+	sim->x_end = sim->ram_bpl - 1;
+	sim->y_start = 0;
+	sim->y_end = sim->height - 1;
+	sim->x_count = 0;
+	sim->y_count = 0;
+	sim->update_ctrl2 = 0;
+	sim->temp = sim->ambient_temp;
+	sim->lut_loaded = false;
+}
+
+/* @mem must hold epd_sim_mem_size() bytes and outlive the model */
+void epd_sim_init(struct epd_sim *sim, u32 width, u32 height, void *mem)
+{
+	size_t plane;
+	u8 *p = mem;
+
+	memset(sim, 0, sizeof(*sim));
+	sim->width = width;
+	sim->height = height;
+	sim->ram_bpl = DIV_ROUND_UP(width, 8);
+	sim->ambient_temp = 25;
+
+	plane = (size_t)sim->ram_bpl * height;
+	sim->bw_ram = p;
+	sim->red_ram = p + plane;
+	sim->shown = p + 2 * plane;
+	sim->panel = p + 3 * plane;
+
+	memset(p, 0xFF, 3 * plane);
+	memset(sim->panel, EPD_SIM_WHITE, (size_t)width * height);
+
+	epd_sim_reset_regs(sim);
+}
+
+/* Hardware reset: also the only way out of deep sleep */
+void epd_sim_reset(struct epd_sim *sim)
+{
+	sim->sleeping = false;
+	sim->busy_until_ns = 0;
+	epd_sim_reset_regs(sim);
+}
+
+bool epd_sim_busy(struct epd_sim *sim, u64 now_ns)
+{
+	return now_ns < sim->busy_until_ns;
+}
+
+static void epd_sim_set_busy(struct epd_sim *sim, u32 ms, u64 now_ns)
+{
+	sim->busy_until_ns = now_ns + (u64)ms * 1000000;
+	sim->stats.busy_ns += (u64)ms * 1000000;
+	sim->stats.last_busy_ms = ms;
+}
+
+/* Waveforms get longer in the cold and shorter in the heat */
+static u32 epd_sim_temp_scale(int temp)
+{
+	int scale;
+
+	if (temp < 25)
+		scale = 1000 + 40 * (25 - temp);
+	else
+		scale = 1000 - 10 * (temp - 25);
+
+	return clamp(scale, 400, 3000);
+}
+
+static bool epd_sim_bit(const u8 *plane, u32 bpl, u32 x, u32 y)
+{
+	return plane[y * bpl + x / 8] & (0x80 >> (x % 8));
+}
+
+/* Drive a pixel towards @white, keeping @residual/1000 of its error */
+static void epd_sim_settle(u8 *level, bool white, u32 residual)
+{
+	int target = white ? EPD_SIM_WHITE : 0;
+	int error = (int)*level - target;
+
+	*level = target + error * (int)residual / 1000;
+}
+
+/* Mode 1 drives every pixel to the BW RAM through the loaded LUT */
+static u32 epd_sim_display_mode1(struct epd_sim *sim, bool lut_loaded_now)
+{
+	u32 residual = sim->lut_temp >= EPD_SIM_FAST_LUT_TEMP ?
+			       EPD_SIM_RESIDUAL_FAST : EPD_SIM_RESIDUAL_FULL;
+	u32 x, y;
+
+	for (y = 0; y < sim->height; y++)
+		for (x = 0; x < sim->width; x++)
+			epd_sim_settle(&sim->panel[y * sim->width + x],
+				       epd_sim_bit(sim->bw_ram, sim->ram_bpl,
+						   x, y),
+				       residual);
+
+	if (lut_loaded_now)
+		sim->stats.full++;
+	else
+		sim->stats.fast++;
+
+	return EPD_SIM_MODE1_MS * epd_sim_temp_scale(sim->lut_temp) / 1000;
+}
+
+/*
+ * Mode 2 only drives pixels whose BW and RED RAM bits differ, then copies
+ * BW into RED so the next partial update diffs against this one. Gate
+ * lines without changes are scanned faster, so the duration grows with
+ * the number of rows that changed.
+ */
+static u32 epd_sim_display_mode2(struct epd_sim *sim)
+{
+	size_t plane = (size_t)sim->ram_bpl * sim->height;
+	u32 rows = 0;
+	u32 x, y;
+
+	for (y = 0; y < sim->height; y++) {
+		bool changed = false;
+
+		for (x = 0; x < sim->width; x++) {
+			bool white = epd_sim_bit(sim->bw_ram, sim->ram_bpl,
+						 x, y);
+
+			if (white == epd_sim_bit(sim->red_ram, sim->ram_bpl,
+						 x, y))
+				continue;
+
+			epd_sim_settle(&sim->panel[y * sim->width + x], white,
+				       EPD_SIM_RESIDUAL_PARTIAL);
+			changed = true;
+		}
+		rows += changed;
+	}
+
+	memcpy(sim->red_ram, sim->bw_ram, plane);
+	sim->stats.partial++;
+
+	return EPD_SIM_MODE2_MS * (700 + 300 * rows / sim->height) / 1000 *
+	       epd_sim_temp_scale(sim->lut_temp) / 1000;
+}
+
+static void epd_sim_activate(struct epd_sim *sim, u64 now_ns)
+{
+	u8 seq = sim->update_ctrl2;
+	u32 ms = 0;
+
+	if (seq & EPD_SIM_SEQ_LOAD_TEMP) {
+		sim->temp = sim->ambient_temp;
+		ms += EPD_SIM_TEMP_READ_MS;
+	}
+
+	if (seq & EPD_SIM_SEQ_LOAD_LUT) {
+		sim->lut_temp = sim->temp;
+		sim->lut_loaded = true;
+		ms += EPD_SIM_LUT_LOAD_MS;
+	}
+
+	if (seq & EPD_SIM_SEQ_DISPLAY) {
+		if (!sim->lut_loaded) {
+			/* No waveform to drive the panel with */
+			sim->stats.busy_violations++;
+		} else {
+			if (seq & EPD_SIM_SEQ_MODE2)
+				ms += epd_sim_display_mode2(sim);
+			else
+				ms += epd_sim_display_mode1(
+					sim, seq & EPD_SIM_SEQ_LOAD_LUT);
+			memcpy(sim->shown, sim->bw_ram,
+			       (size_t)sim->ram_bpl * sim->height);
+			sim->stats.refreshes++;
+		}
+	}
+
+	epd_sim_set_busy(sim, ms, now_ns);
+}
+
+void epd_sim_cmd(struct epd_sim *sim, u8 cmd, u64 now_ns)
+{
+	if (sim->sleeping) {
+		sim->stats.ignored++;
+		return;
+	}
+
+	if (epd_sim_busy(sim, now_ns))
+		sim->stats.busy_violations++;
+
+	sim->cmd = cmd;
+	sim->nr_params = 0;
+
+	switch (cmd) {
+	case EPD_SIM_CMD_SW_RESET:
+		epd_sim_reset_regs(sim);
+		epd_sim_set_busy(sim, EPD_SIM_SW_RESET_MS, now_ns);
+		break;
+	case EPD_SIM_CMD_ACTIVATE:
+		epd_sim_activate(sim, now_ns);
+		break;
+	}
+}
+
+/* Move one counter within its window, returning true when it wrapped */
+static bool epd_sim_step(u16 *count, u16 start, u16 end, bool inc)
+{
+	u16 lo = min(start, end);
+	u16 hi = max(start, end);
+
+	if (inc) {
+		if (*count >= hi) {
+			*count = lo;
+			return true;
+		}
+		(*count)++;
+	} else {
+		if (*count <= lo) {
+			*count = hi;
+			return true;
+		}
+		(*count)--;
+	}
+
+	return false;
+}
+
+static void epd_sim_write_ram(struct epd_sim *sim, u8 *plane, u8 value)
+{
+	bool x_inc = sim->entry_mode & EPD_SIM_ENTRY_X_INC;
+	bool y_inc = sim->entry_mode & EPD_SIM_ENTRY_Y_INC;
+
+	if (sim->x_count < sim->ram_bpl && sim->y_count < sim->height)
+		plane[sim->y_count * sim->ram_bpl + sim->x_count] = value;
+
+	if (sim->entry_mode & EPD_SIM_ENTRY_Y_FIRST) {
+		if (epd_sim_step(&sim->y_count, sim->y_start, sim->y_end,
+				 y_inc))
+			epd_sim_step(&sim->x_count, sim->x_start, sim->x_end,
+				     x_inc);
+	} else {
+		if (epd_sim_step(&sim->x_count, sim->x_start, sim->x_end,
+				 x_inc))
+			epd_sim_step(&sim->y_count, sim->y_start, sim->y_end,
+				     y_inc);
+	}
+}
+
+static void epd_sim_param(struct epd_sim *sim, u8 value)
+{
+	u8 *p = sim->params;
+
+	if (sim->nr_params >= ARRAY_SIZE(sim->params))
+		return;
+	p[sim->nr_params++] = value;
+
+	switch (sim->cmd) {
+	case EPD_SIM_CMD_DEEP_SLEEP_MODE:
+		sim->sleeping = p[0] & 0x03;
+		break;
+	case EPD_SIM_CMD_DATA_ENTRY_MODE:
+		sim->entry_mode = p[0] & 0x07;
+		break;
+	case EPD_SIM_CMD_TEMP_SENSOR_WRITE:
+		if (sim->nr_params == 1)
+			sim->temp = (s8)p[0];
+		break;
+	case EPD_SIM_CMD_DISPLAY_UPDATE_CTRL2:
+		sim->update_ctrl2 = p[0];
+		break;
+	case EPD_SIM_CMD_SET_RAM_X:
+		if (sim->nr_params == 2) {
+			sim->x_start = p[0];
+			sim->x_end = p[1];
+		}
+		break;
+	case EPD_SIM_CMD_SET_RAM_Y:
+		if (sim->nr_params == 4) {
+			sim->y_start = p[0] | p[1] << 8;
+			sim->y_end = p[2] | p[3] << 8;
+		}
+		break;
+	case EPD_SIM_CMD_SET_RAM_X_COUNT:
+		sim->x_count = p[0];
+		break;
+	case EPD_SIM_CMD_SET_RAM_Y_COUNT:
+		if (sim->nr_params == 2)
+			sim->y_count = p[0] | p[1] << 8;
+		break;
+	}
+}
+
+void epd_sim_data(struct epd_sim *sim, const u8 *buf, size_t len,
+		  u64 now_ns)
+{
+	size_t i;
+
+	if (sim->sleeping) {
+		sim->stats.ignored += len;
+		return;
+	}
+
+	if (epd_sim_busy(sim, now_ns))
+		sim->stats.busy_violations++;
+
+	for (i = 0; i < len; i++) {
+		if (sim->cmd == EPD_SIM_CMD_WRITE_RAM_BW)
+			epd_sim_write_ram(sim, sim->bw_ram, buf[i]);
+		else if (sim->cmd == EPD_SIM_CMD_WRITE_RAM_RED)
+			epd_sim_write_ram(sim, sim->red_ram, buf[i]);
+		else
+			epd_sim_param(sim, buf[i]);
+	}
+}
+
+/*
+ * Ghosting estimate: the number of pixels further than
+ * EPD_SIM_GHOST_THRESHOLD from the frame the last refresh drove towards.
+ */
+u32 epd_sim_ghosted(const struct epd_sim *sim, u32 *max_error)
+{
+	u32 ghosted = 0, worst = 0;
+	u32 x, y;
+
+	for (y = 0; y < sim->height; y++) {
+		for (x = 0; x < sim->width; x++) {
+			int target = epd_sim_bit(sim->shown, sim->ram_bpl,
+						 x, y) ? EPD_SIM_WHITE : 0;
+			u32 error = abs(sim->panel[y * sim->width + x] -
+					target);
+
+			worst = max(worst, error);
+			if (error > EPD_SIM_GHOST_THRESHOLD)
+				ghosted++;
+		}
+	}
+
+	if (max_error)
+		*max_error = worst;
+	return ghosted;
+}
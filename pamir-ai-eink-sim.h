@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Behavioral SSD168x model for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#ifndef _PAMIR_AI_EINK_SIM_H
+#define _PAMIR_AI_EINK_SIM_H
+
+#include <linux/kernel.h>
+
+/* Grey levels: 0 is black, 255 white */
+#define EPD_SIM_WHITE 255
+/* Difference from the intended level above which a pixel counts as ghosted */
+#define EPD_SIM_GHOST_THRESHOLD 16
+
+struct epd_sim_stats {
+	u32 refreshes;
+	u32 full;		/* Display mode 1 with a freshly loaded LUT */
+	u32 fast;		/* Display mode 1 with a previously loaded LUT */
+	u32 partial;		/* Display mode 2 */
+	u64 busy_ns;		/* Total time BUSY was high */
+	u32 last_busy_ms;
+	u32 busy_violations;	/* Commands or data sent while BUSY */
+	u32 ignored;		/* Bytes sent during deep sleep */
+};
+
+/*
+ * Models the controller's two RAM planes, window and address counter
+ * registers, data entry modes and display update sequences, plus a
+ * "physical" panel of grey levels. Each pixel driven by a refresh settles
+ * at its target plus a fraction of its previous error, so shorter
+ * waveforms leave more of the old image behind. BUSY durations depend on
+ * the display mode, the refreshed area and the temperature the LUT was
+ * loaded for.
+ *
+ * Times are passed in by the caller, so the model works on a simulated
+ * clock as well as on a real one.
+ */
+struct epd_sim {
+	u32 width;
+	u32 height;
+	u32 ram_bpl;
+	u8 *bw_ram;
+	u8 *red_ram;
+	u8 *shown;		/* Frame the last refresh drove towards */
+	u8 *panel;		/* Grey level per pixel */
+	int ambient_temp;	/* Degrees C read by the internal sensor */
+
+	/* Command decoder */
+	u8 cmd;
+	u32 nr_params;
+	u8 params[4];
+
+	/* Registers */
+	u8 entry_mode;
+	u16 x_start;		/* In bytes */
+	u16 x_end;
+	u16 y_start;
+	u16 y_end;
+	u16 x_count;
+	u16 y_count;
+	u8 update_ctrl2;
+	int temp;		/* Temperature register */
+	int lut_temp;		/* Temperature the loaded LUT is for */
+	bool lut_loaded;
+	bool sleeping;
+	u64 busy_until_ns;
+
+	struct epd_sim_stats stats;
+};
+
+size_t epd_sim_mem_size(u32 width, u32 height);
+void epd_sim_init(struct epd_sim *sim, u32 width, u32 height, void *mem);
+void epd_sim_reset(struct epd_sim *sim);
+void epd_sim_cmd(struct epd_sim *sim, u8 cmd, u64 now_ns);
+void epd_sim_data(struct epd_sim *sim, const u8 *buf, size_t len,
+		  u64 now_ns);
+bool epd_sim_busy(struct epd_sim *sim, u64 now_ns);
+u32 epd_sim_ghosted(const struct epd_sim *sim, u32 *max_error);
+
+#endif /* _PAMIR_AI_EINK_SIM_H */
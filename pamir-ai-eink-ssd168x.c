@@ -0,0 +1,487 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SSD1680/SSD1683 controller support for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/gpio/consumer.h>
+#include <linux/slab.h>
+
+#include "pamir-ai-eink-internal.h"
+
+#define SSD168X_CMD_DRIVER_OUTPUT_CTRL 0x01
+#define SSD168X_CMD_DEEP_SLEEP_MODE 0x10
+#define SSD168X_CMD_DATA_ENTRY_MODE 0x11
+#define SSD168X_CMD_SW_RESET 0x12
+#define SSD168X_CMD_TEMP_SENSOR_READ 0x18
+#define SSD168X_CMD_TEMP_SENSOR_WRITE 0x1A
+#define SSD168X_CMD_ACTIVATE 0x20
+#define SSD168X_CMD_DISPLAY_UPDATE_CTRL1 0x21
+#define SSD168X_CMD_DISPLAY_UPDATE_CTRL2 0x22
+#define SSD168X_CMD_WRITE_RAM_BW 0x24
+#define SSD168X_CMD_WRITE_RAM_RED 0x26
+#define SSD168X_CMD_BORDER_WAVEFORM 0x3C
+#define SSD168X_CMD_SET_RAM_X 0x44
+#define SSD168X_CMD_SET_RAM_Y 0x45
+#define SSD168X_CMD_SET_RAM_X_COUNT 0x4E
+#define SSD168X_CMD_SET_RAM_Y_COUNT 0x4F
+
+#define SSD168X_UPDATE_MODE_FULL 0xF7
+#define SSD168X_UPDATE_MODE_PARTIAL 0xFF
+#define SSD168X_UPDATE_LOAD_TEMP_LUT 0x91
+#define SSD168X_UPDATE_MODE_FAST 0xC7
+
+#define SSD168X_BORDER_NORMAL 0x05
+#define SSD168X_BORDER_PARTIAL 0x80
+
+/* Register values that differ between the members of the family */
+struct ssd168x_variant {
+	u8 update_ctrl1[2];
+	/* Temperature forced before a fast refresh to select a shorter LUT */
+	u8 fast_temp;
+};
+
+static const struct ssd168x_variant ssd1680_variant = {
+	.update_ctrl1 = { 0x00, 0x80 },
+	.fast_temp = 0x64,
+};
+
+static const struct ssd168x_variant ssd1683_variant = {
+	.update_ctrl1 = { 0x40, 0x00 },
+	.fast_temp = 0x6E,
+};
+
+static const struct ssd168x_variant *ssd168x_variant(struct epd_dev *epd)
+{
+	return epd->ctrl->priv;
+}
+
+static int ssd168x_set_ram_area(struct epd_dev *epd, u16 x_start, u16 y_start,
+				u16 x_end, u16 y_end)
+{
+	u8 data[4];
+	int ret;
+
+	x_start = x_start / 8;
+	x_end = x_end / 8;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_X);
+	if (ret)
+		return ret;
+
+	data[0] = x_start;
+	data[1] = x_end;
+	ret = epd_send_data_buf(epd, data, 2);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_Y);
+	if (ret)
+		return ret;
+
+	data[0] = y_start & 0xff;
+	data[1] = (y_start >> 8) & 0xff;
+	data[2] = y_end & 0xff;
+	data[3] = (y_end >> 8) & 0xff;
+	ret = epd_send_data_buf(epd, data, 4);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_X_COUNT);
+	if (ret)
+		return ret;
+
+	data[0] = x_start;
+	ret = epd_send_data_buf(epd, data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_Y_COUNT);
+	if (ret)
+		return ret;
+
+	data[0] = y_start & 0xff;
+	data[1] = (y_start >> 8) & 0xff;
+	ret = epd_send_data_buf(epd, data, 2);
+
+	return ret;
+}
+
+static int ssd168x_init(struct epd_dev *epd)
+{
+	const struct ssd168x_variant *variant = ssd168x_variant(epd);
+	u8 data[4];
+	int ret;
+
+	/* Try deep sleep command first to recover from stuck state */
+	/* This doesn't require busy wait and can help unstick the controller */
+	epd_send_cmd(epd, SSD168X_CMD_DEEP_SLEEP_MODE);
+	usleep_range(10000, 15000);
+
+	epd_hw_reset(epd);
+
+	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SW_RESET);
+	if (ret)
+		return ret;
+
+	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_DRIVER_OUTPUT_CTRL);
+	if (ret)
+		return ret;
+
+	data[0] = (epd->height - 1) & 0xff;
+	data[1] = ((epd->height - 1) >> 8) & 0xff;
+	data[2] = 0x00;
+	ret = epd_send_data_buf(epd, data, 3);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_DATA_ENTRY_MODE);
+	if (ret)
+		return ret;
+
+	data[0] = 0x03; /* X-increment, Y-increment */
+	ret = epd_send_data_buf(epd, data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_X);
+	if (ret)
+		return ret;
+
+	data[0] = 0x00;
+	data[1] = (epd->width / 8) - 1;
+	ret = epd_send_data_buf(epd, data, 2);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_Y);
+	if (ret)
+		return ret;
+
+	data[0] = (epd->height - 1) & 0xff;
+	data[1] = ((epd->height - 1) >> 8) & 0xff;
+	data[2] = 0x00;
+	data[3] = 0x00;
+	ret = epd_send_data_buf(epd, data, 4);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_BORDER_WAVEFORM);
+	if (ret)
+		return ret;
+
+	data[0] = SSD168X_BORDER_NORMAL;
+	ret = epd_send_data_buf(epd, data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_DISPLAY_UPDATE_CTRL1);
+	if (ret)
+		return ret;
+
+	data[0] = variant->update_ctrl1[0];
+	data[1] = variant->update_ctrl1[1];
+	ret = epd_send_data_buf(epd, data, 2);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_TEMP_SENSOR_READ);
+	if (ret)
+		return ret;
+
+	data[0] = 0x80;
+	ret = epd_send_data_buf(epd, data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_X_COUNT);
+	if (ret)
+		return ret;
+
+	data[0] = 0x00;
+	ret = epd_send_data_buf(epd, data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_SET_RAM_Y_COUNT);
+	if (ret)
+		return ret;
+
+	data[0] = 0x00;
+	data[1] = 0x00;
+	ret = epd_send_data_buf(epd, data, 2);
+	if (ret)
+		return ret;
+
+	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+}
+
+static int ssd168x_trigger_update(struct epd_dev *epd, u8 mode)
+{
+	u8 data;
+	int ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_DISPLAY_UPDATE_CTRL2);
+	if (ret)
+		return ret;
+
+	data = mode;
+	ret = epd_send_data_buf(epd, &data, 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_ACTIVATE);
+	if (ret)
+		return ret;
+
+	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
+}
+
+/* Load the frame into both RAMs so the next partial update diffs against it */
+static int ssd168x_write_frame(struct epd_dev *epd, const u8 *buf)
+{
+	size_t len = epd->screensize;
+	u8 data;
+	int ret;
+
+	/* Y-increment mode */
+	ret = ssd168x_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_BW);
+	if (ret)
+		return ret;
+
+	ret = epd_send_data_buf(epd, buf, len);
+	if (ret)
+		return ret;
+
+	/* Clear residual data in red RAM */
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_RED);
+	if (ret)
+		return ret;
+
+	ret = epd_send_data_buf(epd, buf, len);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_BORDER_WAVEFORM);
+	if (ret)
+		return ret;
+
+	data = SSD168X_BORDER_NORMAL;
+	return epd_send_data_buf(epd, &data, 1);
+}
+
+static int ssd168x_full_update(struct epd_dev *epd, const u8 *buf)
+{
+	int ret;
+
+	ret = ssd168x_write_frame(epd, buf);
+	if (ret)
+		return ret;
+
+	return ssd168x_trigger_update(epd, SSD168X_UPDATE_MODE_FULL);
+}
+
+/*
+ * Full-screen refresh with a shorter waveform: force a high temperature
+ * reading so the controller loads its fast LUT, then display without
+ * reloading temperature. The next full update reads the sensor again.
+ */
+static int ssd168x_fast_update(struct epd_dev *epd, const u8 *buf)
+{
+	const struct ssd168x_variant *variant = ssd168x_variant(epd);
+	u8 data[2];
+	int ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_TEMP_SENSOR_WRITE);
+	if (ret)
+		return ret;
+
+	data[0] = variant->fast_temp;
+	data[1] = 0x00;
+	ret = epd_send_data_buf(epd, data, 2);
+	if (ret)
+		return ret;
+
+	ret = ssd168x_trigger_update(epd, SSD168X_UPDATE_LOAD_TEMP_LUT);
+	if (ret)
+		return ret;
+
+	ret = ssd168x_write_frame(epd, buf);
+	if (ret)
+		return ret;
+
+	return ssd168x_trigger_update(epd, SSD168X_UPDATE_MODE_FAST);
+}
+
+static int ssd168x_partial_update(struct epd_dev *epd, const u8 *buf,
+				  const struct epd_update_area *area)
+{
+	u8 data;
+	u32 x_bytes, y;
+	int ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_BORDER_WAVEFORM);
+	if (ret)
+		return ret;
+
+	data = SSD168X_BORDER_PARTIAL;
+	ret = epd_send_data_buf(epd, &data, 1);
+	if (ret)
+		return ret;
+
+	ret = ssd168x_set_ram_area(epd, area->x, area->y,
+				   area->x + area->width - 1,
+				   area->y + area->height - 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_BW);
+	if (ret)
+		return ret;
+
+	x_bytes = area->width / 8;
+
+	for (y = area->y; y < area->y + area->height; y++) {
+		size_t offset = y * epd->bytes_per_line + (area->x / 8);
+
+		ret = epd_send_data_buf(epd, buf + offset, x_bytes);
+		if (ret)
+			return ret;
+	}
+
+	return ssd168x_trigger_update(epd, SSD168X_UPDATE_MODE_PARTIAL);
+}
+
+static int ssd168x_base_map_update(struct epd_dev *epd, const u8 *buf)
+{
+	int ret;
+
+	ret = ssd168x_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_BW);
+	if (ret)
+		return ret;
+
+	ret = epd_send_data_buf(epd, buf, epd->screensize);
+	if (ret)
+		return ret;
+
+	return ssd168x_trigger_update(epd, SSD168X_UPDATE_MODE_FULL);
+}
+
+static int ssd168x_clear(struct epd_dev *epd)
+{
+	size_t len = epd->screensize;
+	u8 *clear_buf;
+	u8 data;
+	int ret;
+
+	/* Y-decrement mode needed for proper clear */
+	data = 0x01; /* X-increment, Y-decrement - matches height-1 to 0 coords */
+	ret = epd_send_cmd(epd, SSD168X_CMD_DATA_ENTRY_MODE);
+	if (ret)
+		return ret;
+	ret = epd_send_data_buf(epd, &data, 1);
+	if (ret)
+		return ret;
+
+	clear_buf = kmalloc(len, GFP_KERNEL);
+	if (!clear_buf)
+		return -ENOMEM;
+	memset(clear_buf, 0xFF, len);
+
+	/* Y-increment mode */
+	ret = ssd168x_set_ram_area(epd, 0, 0, epd->width - 1, epd->height - 1);
+	if (ret)
+		goto out_free;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_BW);
+	if (ret)
+		goto out_free;
+
+	ret = epd_send_data_buf(epd, clear_buf, len);
+	if (ret)
+		goto out_free;
+
+	/* Prevent ghosting */
+	ret = epd_send_cmd(epd, SSD168X_CMD_WRITE_RAM_RED);
+	if (ret)
+		goto out_free;
+
+	ret = epd_send_data_buf(epd, clear_buf, len);
+	if (ret)
+		goto out_free;
+
+	ret = ssd168x_trigger_update(epd, SSD168X_UPDATE_MODE_FULL);
+	if (ret)
+		goto out_free;
+
+	data = 0x03; /* X-increment, Y-increment for text display */
+	ret = epd_send_cmd(epd, SSD168X_CMD_DATA_ENTRY_MODE);
+	if (ret)
+		goto out_free;
+	ret = epd_send_data_buf(epd, &data, 1);
+
+out_free:
+	kfree(clear_buf);
+	return ret;
+}
+
+static int ssd168x_deep_sleep(struct epd_dev *epd)
+{
+	u8 data = 0x11; /* Mode 2: Deep Sleep without RAM retention */
+	int ret;
+
+	ret = epd_send_cmd(epd, SSD168X_CMD_DEEP_SLEEP_MODE);
+	if (ret)
+		return ret;
+
+	return epd_send_data_buf(epd, &data, 1);
+}
+
+const struct epd_controller epd_ssd1680_controller = {
+	.name = "ssd1680",
+	.caps = EPD_CAP_PARTIAL | EPD_CAP_FAST | EPD_CAP_BASE_MAP,
+	.max_width = 176,
+	.max_height = 296,
+	.init = ssd168x_init,
+	.full_update = ssd168x_full_update,
+	.fast_update = ssd168x_fast_update,
+	.partial_update = ssd168x_partial_update,
+	.base_map_update = ssd168x_base_map_update,
+	.clear = ssd168x_clear,
+	.deep_sleep = ssd168x_deep_sleep,
+	.priv = &ssd1680_variant,
+};
+
+const struct epd_controller epd_ssd1683_controller = {
+	.name = "ssd1683",
+	.caps = EPD_CAP_PARTIAL | EPD_CAP_FAST | EPD_CAP_BASE_MAP,
+	.max_width = 400,
+	.max_height = 300,
+	.init = ssd168x_init,
+	.full_update = ssd168x_full_update,
+	.fast_update = ssd168x_fast_update,
+	.partial_update = ssd168x_partial_update,
+	.base_map_update = ssd168x_base_map_update,
+	.clear = ssd168x_clear,
+	.deep_sleep = ssd168x_deep_sleep,
+	.priv = &ssd1683_variant,
+};
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Streaming mode for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ *
+ * Userspace queues whole frames, or just the rectangles that changed, in a
+ * ring it shares with the driver, and the flush worker plays them back to
+ * back: each slot is copied into the framebuffer and refreshed, then the
+ * worker sleeps out the rest of the slot's dwell time and takes the next.
+ * A steady animation needs no system call per frame. The ring is allocated
+ * on the first start and kept until the device goes away, since userspace
+ * may still have it mapped.
+ */
+
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <asm/barrier.h>
+
+#include "pamir-ai-eink-internal.h"
+
+static u8 *epd_stream_slot(struct epd_stream *stream, u32 index)
+{
+	return (u8 *)(stream->ring + 1) +
+	       (size_t)(index % EPD_STREAM_SLOTS) * stream->slot_size;
+}
+
+/*
+ * Play the slot at the tail if userspace has queued one. Returns 1 and the
+ * slot's dwell time once it was refreshed, or 0 if the ring is empty. A
+ * full refresh the governor holds back leaves the slot queued and returns
+ * -EAGAIN with the time left in dwell_ms.
+ */
+int epd_stream_play(struct epd_dev *epd, u32 *dwell_ms)
+{
+	struct epd_stream *stream = &epd->stream;
+	struct epd_stream_slot slot;
+	struct epd_update_area *area = &slot.area;
+	u32 head, queued, row, len, wait_ms;
+	bool full;
+	const u8 *src;
+	u8 *dst;
+	int ret;
+
+	/* Pairs with the release store userspace advances head with */
+	head = smp_load_acquire(&stream->ring->head);
+	queued = head - stream->tail;
+	if (!queued)
+		return 0;
+
+	if (queued > EPD_STREAM_SLOTS) {
+		dev_err(&epd->spi->dev, "Stream head is %u slots ahead\n",
+			queued);
+		return -EOVERFLOW;
+	}
+
+	/* Check a private copy, userspace can still write to the ring */
+	src = epd_stream_slot(stream, stream->tail);
+	memcpy(&slot, src, sizeof(slot));
+	src += sizeof(slot);
+
+	if (area->x % 8 != 0 || area->width % 8 != 0 || !area->width ||
+	    !area->height || area->x + area->width > epd->width ||
+	    area->y + area->height > epd->height ||
+	    slot.dwell_ms > EPD_STREAM_MAX_DWELL_MS) {
+		dev_err(&epd->spi->dev, "Invalid stream slot %u\n",
+			stream->tail);
+		return -EINVAL;
+	}
+
+	full = slot.flags & EPD_STREAM_FULL;
+	wait_ms = epd_flush_claim(epd, full);
+	if (wait_ms) {
+		*dwell_ms = wait_ms;
+		return -EAGAIN;
+	}
+
+	len = area->width / 8;
+	dst = (u8 *)epd->info->screen_base + area->y * epd->bytes_per_line +
+	      area->x / 8;
+	for (row = 0; row < area->height; row++) {
+		memcpy(dst, src, len);
+		dst += epd->bytes_per_line;
+		src += len;
+	}
+
+	ret = epd_stream_update(epd, area, full);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(stream->tail, stream->tail + 1);
+	stream->frames++;
+	smp_store_release(&stream->ring->tail, stream->tail);
+
+	*dwell_ms = slot.dwell_ms;
+	return 1;
+}
+
+/*
+ * Runs on the flush worker, so streamed frames and regular flushes never
+ * overlap. The next slot is due dwell_ms after this one started; when the
+ * refresh took longer than that, playback runs at the panel's rate. A
+ * full slot also waits out the governor's full_interval_ms.
+ */
+static void epd_stream_work_fn(struct kthread_work *work)
+{
+	struct epd_dev *epd = container_of(work, struct epd_dev,
+					   stream.work.work);
+	struct epd_stream *stream = &epd->stream;
+	ktime_t start = ktime_get();
+	ktime_t next, now;
+	u32 dwell_ms = 0;
+	int ret;
+
+	if (!READ_ONCE(stream->active))
+		return;
+
+	ret = epd_stream_play(epd, &dwell_ms);
+	if (ret == -EAGAIN) {
+		kthread_queue_delayed_work(epd->flush_worker, &stream->work,
+					   msecs_to_jiffies(dwell_ms));
+		return;
+	}
+	if (ret < 0) {
+		WRITE_ONCE(stream->error, ret);
+		WRITE_ONCE(stream->ring->error, ret);
+		WRITE_ONCE(stream->active, false);
+	}
+	wake_up_all(&stream->wq);
+
+	/* Empty: the next kick restarts playback */
+	if (ret <= 0)
+		return;
+
+	next = ktime_add_ms(start, dwell_ms);
+	now = ktime_get();
+	kthread_queue_delayed_work(epd->flush_worker, &stream->work,
+				   ktime_after(next, now) ?
+				   usecs_to_jiffies(ktime_us_delta(next, now)) :
+				   0);
+}
+
+void epd_stream_init(struct epd_dev *epd)
+{
+	struct epd_stream *stream = &epd->stream;
+
+	mutex_init(&stream->lock);
+	init_waitqueue_head(&stream->wq);
+	kthread_init_delayed_work(&stream->work, epd_stream_work_fn);
+}
+
+void epd_stream_destroy(struct epd_dev *epd)
+{
+	epd_stream_stop(epd);
+	vfree(epd->stream.ring);
+	epd->stream.ring = NULL;
+}
+
+int epd_stream_start(struct epd_dev *epd, struct epd_stream_info *info)
+{
+	struct epd_stream *stream = &epd->stream;
+	u32 slot_size = ALIGN(sizeof(struct epd_stream_slot) + epd->screensize,
+			      8);
+	size_t size = PAGE_ALIGN(sizeof(struct epd_stream_ring) +
+				 EPD_STREAM_SLOTS * slot_size);
+	int ret = 0;
+
+	/* Members of tiled and mirror groups show the group framebuffer */
+	if (epd->group && epd->group->mode != EPD_GROUP_SYNC)
+		return -EBUSY;
+
+	mutex_lock(&stream->lock);
+
+	if (stream->active) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	if (!stream->ring) {
+		stream->ring = vmalloc_user(size);
+		if (!stream->ring) {
+			ret = -ENOMEM;
+			goto out_unlock;
+		}
+		stream->ring_size = size;
+		stream->slot_size = slot_size;
+	}
+
+	stream->tail = 0;
+	stream->error = 0;
+	stream->frames = 0;
+	stream->ring->head = 0;
+	stream->ring->tail = 0;
+	stream->ring->nr_slots = EPD_STREAM_SLOTS;
+	stream->ring->slot_size = slot_size;
+	stream->ring->error = 0;
+	WRITE_ONCE(stream->active, true);
+
+	info->nr_slots = EPD_STREAM_SLOTS;
+	info->slot_size = slot_size;
+	info->offset = epd->alloc_size;
+	info->size = stream->ring_size;
+
+out_unlock:
+	mutex_unlock(&stream->lock);
+	return ret;
+}
+
+/* Waits for a frame being refreshed, the queued ones are dropped */
+void epd_stream_stop(struct epd_dev *epd)
+{
+	struct epd_stream *stream = &epd->stream;
+
+	mutex_lock(&stream->lock);
+	WRITE_ONCE(stream->active, false);
+	kthread_cancel_delayed_work_sync(&stream->work);
+	mutex_unlock(&stream->lock);
+
+	wake_up_all(&stream->wq);
+}
+
+int epd_stream_kick(struct epd_dev *epd)
+{
+	if (!READ_ONCE(epd->stream.active))
+		return -EINVAL;
+
+	/* Does nothing while the next slot's dwell timer is pending */
+	kthread_queue_delayed_work(epd->flush_worker, &epd->stream.work, 0);
+	return 0;
+}
+
+static bool epd_stream_has_room(struct epd_stream *stream, u32 free)
+{
+	u32 queued = READ_ONCE(stream->ring->head) - READ_ONCE(stream->tail);
+
+	return !READ_ONCE(stream->active) || queued > EPD_STREAM_SLOTS ||
+	       EPD_STREAM_SLOTS - queued >= free;
+}
+
+/* Kick, then wait until at least free slots are available */
+int epd_stream_wait(struct epd_dev *epd, u32 free)
+{
+	struct epd_stream *stream = &epd->stream;
+	int ret;
+
+	if (free > EPD_STREAM_SLOTS)
+		return -EINVAL;
+
+	ret = epd_stream_kick(epd);
+	if (ret)
+		return READ_ONCE(stream->error) ?: ret;
+
+	ret = wait_event_interruptible(stream->wq,
+				       epd_stream_has_room(stream, free));
+	if (ret)
+		return ret;
+
+	return READ_ONCE(stream->error);
+}
+
+/* The ring is mapped at the page after the framebuffer */
+int epd_stream_mmap(struct epd_dev *epd, struct vm_area_struct *vma)
+{
+	struct epd_stream *stream = &epd->stream;
+	unsigned long vma_size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	mutex_lock(&stream->lock);
+
+	if (!stream->ring)
+		ret = -ENODEV;
+	else if (vma_size > stream->ring_size)
+		ret = -EINVAL;
+	else
+		ret = remap_vmalloc_range(vma, stream->ring, 0);
+
+	mutex_unlock(&stream->lock);
+	return ret;
+}
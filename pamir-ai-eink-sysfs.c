@@ -30,6 +30,9 @@ static ssize_t update_mode_show(struct device *dev,
 	case EPD_MODE_BASE_MAP:
 		mode_str = "base_map";
 		break;
+	case EPD_MODE_FAST:
+		mode_str = "fast";
+		break;
 	default:
 		mode_str = "unknown";
 		break;
@@ -52,6 +55,8 @@ static ssize_t update_mode_store(struct device *dev,
 		mode = EPD_MODE_PARTIAL;
 	else if (sysfs_streq(buf, "base_map"))
 		mode = EPD_MODE_BASE_MAP;
+	else if (sysfs_streq(buf, "fast"))
+		mode = EPD_MODE_FAST;
 	else
 		return -EINVAL;
 
@@ -131,6 +136,302 @@ static ssize_t trigger_update_store(struct device *dev,
 
 static DEVICE_ATTR_WO(trigger_update);
 
+static ssize_t spi_bus_mode_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%s\n", epd_bus_mode_names[epd->bus_mode]);
+}
+
+static ssize_t spi_bus_mode_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	int mode;
+
+	mode = __sysfs_match_string(epd_bus_mode_names, -1, buf);
+	if (mode < 0)
+		return mode;
+
+	mutex_lock(&epd->lock);
+	epd->bus_mode = mode;
+	mutex_unlock(&epd->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(spi_bus_mode);
+
+static ssize_t spi_chunk_size_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%zu\n", epd->spi_chunk_size);
+}
+
+static ssize_t spi_chunk_size_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	unsigned int size;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &size);
+	if (ret)
+		return ret;
+
+	if (!size)
+		return -EINVAL;
+
+	mutex_lock(&epd->lock);
+	epd->spi_chunk_size = size;
+	mutex_unlock(&epd->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(spi_chunk_size);
+
+static ssize_t spi_yield_us_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%u\n", epd->spi_yield_us);
+}
+
+static ssize_t spi_yield_us_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	unsigned int yield_us;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &yield_us);
+	if (ret)
+		return ret;
+
+	mutex_lock(&epd->lock);
+	epd->spi_yield_us = yield_us;
+	mutex_unlock(&epd->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(spi_yield_us);
+
+static ssize_t flush_priority_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%d\n", epd->flush_priority);
+}
+
+static ssize_t flush_priority_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	int priority;
+	int ret;
+
+	ret = kstrtoint(buf, 0, &priority);
+	if (ret)
+		return ret;
+
+	mutex_lock(&epd->lock);
+	ret = epd_flush_set_sched(epd, priority, epd->flush_cpu);
+	mutex_unlock(&epd->lock);
+
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(flush_priority);
+
+static ssize_t flush_cpu_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%d\n", epd->flush_cpu);
+}
+
+static ssize_t flush_cpu_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	int cpu;
+	int ret;
+
+	ret = kstrtoint(buf, 0, &cpu);
+	if (ret)
+		return ret;
+
+	mutex_lock(&epd->lock);
+	ret = epd_flush_set_sched(epd, epd->flush_priority, cpu);
+	mutex_unlock(&epd->lock);
+
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(flush_cpu);
+
+static ssize_t flush_governor_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%s\n", epd_governor_names[epd->governor]);
+}
+
+static ssize_t flush_governor_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	int ret;
+
+	ret = __sysfs_match_string(epd_governor_names, -1, buf);
+	if (ret < 0)
+		return ret;
+
+	epd_flush_set_governor(epd, ret);
+	return count;
+}
+
+static DEVICE_ATTR_RW(flush_governor);
+
+/* Tuning a single parameter leaves the profile as "custom" */
+static ssize_t epd_gov_param_store(struct device *dev, const char *buf,
+				   size_t count, size_t offset)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&epd->flush_slock);
+	*(unsigned int *)((u8 *)&epd->gov + offset) = val;
+	epd->governor = EPD_GOV_CUSTOM;
+	spin_unlock(&epd->flush_slock);
+
+	return count;
+}
+
+static ssize_t epd_gov_param_show(struct device *dev, char *buf,
+				  size_t offset)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+
+	return sysfs_emit(buf, "%u\n",
+			  *(unsigned int *)((u8 *)&epd->gov + offset));
+}
+
+#define EPD_GOV_PARAM_ATTR(_name, _field)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	return epd_gov_param_show(dev, buf,				\
+				  offsetof(struct epd_governor_params,	\
+					   _field));			\
+}									\
+static ssize_t _name##_store(struct device *dev,			\
+			     struct device_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	return epd_gov_param_store(dev, buf, count,			\
+				   offsetof(struct epd_governor_params,	\
+					    _field));			\
+}									\
+static DEVICE_ATTR_RW(_name)
+
+EPD_GOV_PARAM_ATTR(flush_min_interval_ms, min_interval_ms);
+EPD_GOV_PARAM_ATTR(flush_batch_delay_ms, batch_delay_ms);
+EPD_GOV_PARAM_ATTR(flush_full_interval_ms, full_interval_ms);
+
+static ssize_t controller_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	unsigned int caps = epd->ctrl->caps;
+
+	return sysfs_emit(buf, "%s%s%s%s\n", epd->ctrl->name,
+			  caps & EPD_CAP_PARTIAL ? " partial" : "",
+			  caps & EPD_CAP_FAST ? " fast" : "",
+			  caps & EPD_CAP_BASE_MAP ? " base_map" : "");
+}
+
+static DEVICE_ATTR_RO(controller);
+
+static ssize_t group_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	struct epd_group *group = epd->group;
+
+	if (!group)
+		return sysfs_emit(buf, "none\n");
+
+	if (group->mode == EPD_GROUP_TILED)
+		return sysfs_emit(buf, "%s %u tiled %u,%u\n", group->name,
+				  group->nr_members, epd->tile_col,
+				  epd->tile_row);
+
+	if (group->mode == EPD_GROUP_MIRROR)
+		return sysfs_emit(buf, "%s %u mirror\n", group->name,
+				  group->nr_members);
+
+	return sysfs_emit(buf, "%s %u\n", group->name, group->nr_members);
+}
+
+static DEVICE_ATTR_RO(group);
+
+static ssize_t group_update_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	struct epd_dev *epd = spi_get_drvdata(spi);
+	int ret;
+
+	if (!sysfs_streq(buf, "1"))
+		return -EINVAL;
+
+	ret = epd_group_flush(epd);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static DEVICE_ATTR_WO(group_update);
+
 static ssize_t deep_sleep_store(struct device *dev,
 				struct device_attribute *attr, const char *buf,
 				size_t count)
@@ -183,7 +484,15 @@ static DEVICE_ATTR_WO(force_reset);
 static struct attribute *epd_attrs[] = {
 	&dev_attr_update_mode.attr,    &dev_attr_partial_area.attr,
 	&dev_attr_trigger_update.attr, &dev_attr_deep_sleep.attr,
-	&dev_attr_force_reset.attr,    NULL,
+	&dev_attr_force_reset.attr,    &dev_attr_group.attr,
+	&dev_attr_group_update.attr,   &dev_attr_controller.attr,
+	&dev_attr_spi_bus_mode.attr,   &dev_attr_spi_chunk_size.attr,
+	&dev_attr_spi_yield_us.attr,   &dev_attr_flush_priority.attr,
+	&dev_attr_flush_cpu.attr,      &dev_attr_flush_governor.attr,
+	&dev_attr_flush_min_interval_ms.attr,
+	&dev_attr_flush_batch_delay_ms.attr,
+	&dev_attr_flush_full_interval_ms.attr,
+	NULL,
 };
 
 const struct attribute_group epd_attr_group = {
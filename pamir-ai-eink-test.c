@@ -0,0 +1,604 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for Pamir AI E-Ink display
+ *
+ * The update paths run against a fake SPI controller and a fake GPIO chip.
+ * The controller records every transfer, split into command and data by
+ * the level of the DC line, and the BUSY line stays high for a few polls
+ * after each refresh or software reset. The sim_* cases instead feed the
+ * traffic to the SSD168x model, which drives BUSY on a virtual clock that
+ * advances by one poll interval per busy poll.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <kunit/test.h>
+#include <kunit/device.h>
+#include <linux/kernel.h>
+#include <linux/gpio/driver.h>
+#include <linux/gpio/consumer.h>
+#include <linux/spi/spi.h>
+#include <linux/version.h>
+
+#include "pamir-ai-eink-internal.h"
+#include "pamir-ai-eink-sim.h"
+
+#define EPD_TEST_WIDTH 128
+#define EPD_TEST_HEIGHT 250
+#define EPD_TEST_SCREENSIZE (EPD_TEST_WIDTH / 8 * EPD_TEST_HEIGHT)
+#define EPD_TEST_MAX_CMDS 32
+/* Polls that see BUSY high after an activation or software reset */
+#define EPD_TEST_BUSY_POLLS 2
+
+#define EPD_TEST_CMD_SW_RESET 0x12
+#define EPD_TEST_CMD_ACTIVATE 0x20
+#define EPD_TEST_CMD_UPDATE_CTRL2 0x22
+
+enum {
+	EPD_TEST_GPIO_RESET,
+	EPD_TEST_GPIO_DC,
+	EPD_TEST_GPIO_BUSY,
+	EPD_TEST_NR_GPIOS,
+};
+
+struct epd_test_priv {
+	struct spi_controller *ctlr;
+	struct spi_device *spi;
+	struct gpio_chip chip;
+	bool chip_added;
+	struct gpio_desc *gpios[EPD_TEST_NR_GPIOS];
+	struct epd_dev *epd;
+	u8 *frame;		/* Writable view of epd->frame */
+
+	bool dc;
+	bool reset;
+	unsigned int busy_left;
+
+	/* Set by epd_test_attach_sim() */
+	struct epd_sim *sim;
+	u64 now_ns;
+
+	/* Recorded since the last epd_test_reset_counts() */
+	unsigned int cmd_xfers;
+	unsigned int data_xfers;
+	size_t data_bytes;
+	unsigned int busy_polls;
+	u8 cmds[EPD_TEST_MAX_CMDS];
+	unsigned int nr_cmds;
+	u8 last_cmd;
+	u8 update_mode;
+};
+
+static void epd_test_reset_counts(struct epd_test_priv *priv)
+{
+	priv->cmd_xfers = 0;
+	priv->data_xfers = 0;
+	priv->data_bytes = 0;
+	priv->busy_polls = 0;
+	priv->nr_cmds = 0;
+}
+
+static int epd_test_transfer_one(struct spi_controller *ctlr,
+				 struct spi_device *spi,
+				 struct spi_transfer *xfer)
+{
+	struct epd_test_priv *priv =
+		*(struct epd_test_priv **)spi_controller_get_devdata(ctlr);
+	const u8 *tx = xfer->tx_buf;
+
+	if (priv->sim && priv->dc)
+		epd_sim_data(priv->sim, tx, xfer->len, priv->now_ns);
+	else if (priv->sim)
+		epd_sim_cmd(priv->sim, tx[xfer->len - 1], priv->now_ns);
+
+	if (priv->dc) {
+		if (priv->last_cmd == EPD_TEST_CMD_UPDATE_CTRL2)
+			priv->update_mode = tx[0];
+		priv->data_xfers++;
+		priv->data_bytes += xfer->len;
+		return 0;
+	}
+
+	priv->cmd_xfers++;
+	priv->last_cmd = tx[xfer->len - 1];
+	if (priv->nr_cmds < EPD_TEST_MAX_CMDS)
+		priv->cmds[priv->nr_cmds++] = priv->last_cmd;
+
+	if (priv->last_cmd == EPD_TEST_CMD_ACTIVATE ||
+	    priv->last_cmd == EPD_TEST_CMD_SW_RESET)
+		priv->busy_left = EPD_TEST_BUSY_POLLS;
+
+	return 0;
+}
+
+static int epd_test_gpio_get(struct gpio_chip *chip, unsigned int offset)
+{
+	struct epd_test_priv *priv = gpiochip_get_data(chip);
+
+	if (offset == EPD_TEST_GPIO_DC)
+		return priv->dc;
+
+	if (offset != EPD_TEST_GPIO_BUSY)
+		return 0;
+
+	priv->busy_polls++;
+	if (priv->sim) {
+		if (!epd_sim_busy(priv->sim, priv->now_ns))
+			return 0;
+		priv->now_ns += EPD_BUSY_POLL_INTERVAL_MS * NSEC_PER_MSEC;
+		return 1;
+	}
+
+	if (!priv->busy_left)
+		return 0;
+
+	priv->busy_left--;
+	return 1;
+}
+
+static void epd_test_set_line(struct epd_test_priv *priv, unsigned int offset,
+			      int value)
+{
+	if (offset == EPD_TEST_GPIO_DC) {
+		priv->dc = value;
+	} else if (offset == EPD_TEST_GPIO_RESET) {
+		/* Rising edge ends the reset pulse */
+		if (value && !priv->reset && priv->sim)
+			epd_sim_reset(priv->sim);
+		priv->reset = value;
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 17, 0)
+static int epd_test_gpio_set(struct gpio_chip *chip, unsigned int offset,
+			     int value)
+{
+	epd_test_set_line(gpiochip_get_data(chip), offset, value);
+	return 0;
+}
+#else
+static void epd_test_gpio_set(struct gpio_chip *chip, unsigned int offset,
+			      int value)
+{
+	epd_test_set_line(gpiochip_get_data(chip), offset, value);
+}
+#endif
+
+static int epd_test_gpio_get_direction(struct gpio_chip *chip,
+				       unsigned int offset)
+{
+	return offset == EPD_TEST_GPIO_BUSY ? GPIO_LINE_DIRECTION_IN :
+					      GPIO_LINE_DIRECTION_OUT;
+}
+
+static int epd_test_gpio_direction_input(struct gpio_chip *chip,
+					 unsigned int offset)
+{
+	return offset == EPD_TEST_GPIO_BUSY ? 0 : -EINVAL;
+}
+
+static int epd_test_gpio_direction_output(struct gpio_chip *chip,
+					  unsigned int offset, int value)
+{
+	if (offset == EPD_TEST_GPIO_BUSY)
+		return -EINVAL;
+
+	epd_test_gpio_set(chip, offset, value);
+	return 0;
+}
+
+static int epd_test_request_gpios(struct kunit *test,
+				  struct epd_test_priv *priv)
+{
+	static const char * const labels[EPD_TEST_NR_GPIOS] = {
+		"reset", "dc", "busy",
+	};
+	static const enum gpiod_flags flags[EPD_TEST_NR_GPIOS] = {
+		GPIOD_OUT_HIGH, GPIOD_OUT_LOW, GPIOD_IN,
+	};
+	unsigned int i;
+
+	for (i = 0; i < EPD_TEST_NR_GPIOS; i++) {
+		priv->gpios[i] = gpiochip_request_own_desc(&priv->chip, i,
+							   labels[i],
+							   GPIO_ACTIVE_HIGH,
+							   flags[i]);
+		if (IS_ERR(priv->gpios[i])) {
+			int ret = PTR_ERR(priv->gpios[i]);
+
+			priv->gpios[i] = NULL;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int epd_test_init(struct kunit *test)
+{
+	struct spi_board_info board = {
+		.modalias = "epd-kunit",
+		.max_speed_hz = 4000000,
+	};
+	struct epd_test_priv *priv, **ctlr_priv;
+	struct epd_dev *epd;
+	struct device *dev;
+	int ret;
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+	test->priv = priv;
+
+	dev = kunit_device_register(test, "epd-kunit");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(dev));
+
+	priv->chip.label = "epd-kunit";
+	priv->chip.parent = dev;
+	priv->chip.owner = THIS_MODULE;
+	priv->chip.base = -1;
+	priv->chip.ngpio = EPD_TEST_NR_GPIOS;
+	priv->chip.get = epd_test_gpio_get;
+	priv->chip.set = epd_test_gpio_set;
+	priv->chip.get_direction = epd_test_gpio_get_direction;
+	priv->chip.direction_input = epd_test_gpio_direction_input;
+	priv->chip.direction_output = epd_test_gpio_direction_output;
+	ret = gpiochip_add_data(&priv->chip, priv);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+	priv->chip_added = true;
+
+	ret = epd_test_request_gpios(test, priv);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	priv->ctlr = spi_alloc_host(dev, sizeof(priv));
+	KUNIT_ASSERT_NOT_NULL(test, priv->ctlr);
+	ctlr_priv = spi_controller_get_devdata(priv->ctlr);
+	*ctlr_priv = priv;
+	priv->ctlr->bus_num = -1;
+	priv->ctlr->num_chipselect = 1;
+	priv->ctlr->transfer_one = epd_test_transfer_one;
+
+	ret = spi_register_controller(priv->ctlr);
+	if (ret) {
+		spi_controller_put(priv->ctlr);
+		priv->ctlr = NULL;
+	}
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	priv->spi = spi_new_device(priv->ctlr, &board);
+	KUNIT_ASSERT_NOT_NULL(test, priv->spi);
+
+	epd = kunit_kzalloc(test, sizeof(*epd), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, epd);
+	priv->epd = epd;
+
+	epd->spi = priv->spi;
+	epd->ctrl = &epd_ssd1680_controller;
+	epd->width = EPD_TEST_WIDTH;
+	epd->height = EPD_TEST_HEIGHT;
+	epd->bytes_per_line = EPD_TEST_WIDTH / 8;
+	epd->screensize = EPD_TEST_SCREENSIZE;
+	epd->alloc_size = PAGE_ALIGN(epd->screensize);
+	mutex_init(&epd->lock);
+	spin_lock_init(&epd->damage_lock);
+	spin_lock_init(&epd->flush_slock);
+	epd->update_mode = EPD_MODE_FULL;
+	epd->initialized = true;
+	epd->bus_mode = EPD_BUS_QUEUED;
+	epd->spi_chunk_size = EPD_SPI_CHUNK_SIZE_DEFAULT;
+	epd->spi_yield_us = EPD_SPI_YIELD_US_DEFAULT;
+	epd->reset_gpio = priv->gpios[EPD_TEST_GPIO_RESET];
+	epd->dc_gpio = priv->gpios[EPD_TEST_GPIO_DC];
+	epd->busy_gpio = priv->gpios[EPD_TEST_GPIO_BUSY];
+
+	priv->frame = kunit_kzalloc(test, epd->screensize, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv->frame);
+	epd->frame = priv->frame;
+
+	epd_test_reset_counts(priv);
+	return 0;
+}
+
+static void epd_test_exit(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	unsigned int i;
+
+	if (!priv)
+		return;
+
+	if (priv->spi)
+		spi_unregister_device(priv->spi);
+	if (priv->ctlr)
+		spi_unregister_controller(priv->ctlr);
+
+	for (i = 0; i < EPD_TEST_NR_GPIOS; i++) {
+		if (priv->gpios[i])
+			gpiochip_free_own_desc(priv->gpios[i]);
+	}
+
+	if (priv->chip_added)
+		gpiochip_remove(&priv->chip);
+}
+
+/* Route the traffic through the SSD168x model from here on */
+static struct epd_sim *epd_test_attach_sim(struct kunit *test,
+					   int ambient_temp)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_sim *sim;
+	void *mem;
+
+	sim = kunit_kzalloc(test, sizeof(*sim), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, sim);
+	mem = kunit_kzalloc(test, epd_sim_mem_size(EPD_TEST_WIDTH,
+						   EPD_TEST_HEIGHT),
+			    GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, mem);
+
+	epd_sim_init(sim, EPD_TEST_WIDTH, EPD_TEST_HEIGHT, mem);
+	sim->ambient_temp = ambient_temp;
+	epd_sim_reset(sim);
+	priv->sim = sim;
+	return sim;
+}
+
+static void epd_test_hw_init(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+
+	KUNIT_ASSERT_EQ(test, epd_hw_init(priv->epd), 0);
+
+	/* Deep sleep, SW reset and 9 register writes */
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 11);
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 9);
+	KUNIT_EXPECT_EQ(test, priv->data_bytes, 17);
+	KUNIT_EXPECT_EQ(test, priv->cmds[1], EPD_TEST_CMD_SW_RESET);
+	/* One poll after the reset pulse and at the end, three after SW reset */
+	KUNIT_EXPECT_EQ(test, priv->busy_polls, 2 + EPD_TEST_BUSY_POLLS + 1);
+}
+
+static void epd_test_full_update(struct kunit *test)
+{
+	static const u8 expected[] = {
+		0x44, 0x45, 0x4E, 0x4F, 0x24, 0x26, 0x3C, 0x22, 0x20,
+	};
+	struct epd_test_priv *priv = test->priv;
+
+	KUNIT_ASSERT_EQ(test, epd_full_update(priv->epd), 0);
+
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, ARRAY_SIZE(expected));
+	KUNIT_EXPECT_MEMEQ(test, priv->cmds, expected, sizeof(expected));
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 8);
+	/* RAM window, both RAM planes, border and update mode */
+	KUNIT_EXPECT_EQ(test, priv->data_bytes,
+			9 + 2 * EPD_TEST_SCREENSIZE + 2);
+	KUNIT_EXPECT_EQ(test, priv->update_mode, 0xF7);
+	KUNIT_EXPECT_EQ(test, priv->busy_polls, EPD_TEST_BUSY_POLLS + 1);
+}
+
+static void epd_test_partial_update(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+
+	epd->partial_area.x = 16;
+	epd->partial_area.y = 8;
+	epd->partial_area.width = 32;
+	epd->partial_area.height = 10;
+	epd->partial_area_set = true;
+
+	KUNIT_ASSERT_EQ(test, epd_partial_update(epd), 0);
+
+	/* Border, RAM window, write RAM and the two update commands */
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 8);
+	/* One data transfer per row of the area */
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 1 + 4 + 10 + 1);
+	KUNIT_EXPECT_EQ(test, priv->data_bytes, 1 + 9 + 10 * 4 + 1);
+	KUNIT_EXPECT_EQ(test, priv->update_mode, 0xFF);
+}
+
+static void epd_test_partial_unaligned(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+
+	epd->partial_area.x = 4;
+	epd->partial_area.y = 0;
+	epd->partial_area.width = 16;
+	epd->partial_area.height = 1;
+	epd->partial_area_set = true;
+
+	KUNIT_EXPECT_EQ(test, epd_partial_update(epd), -EINVAL);
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 0);
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 0);
+}
+
+static void epd_test_base_map_update(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+
+	KUNIT_ASSERT_EQ(test, epd_base_map_update(priv->epd), 0);
+
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 7);
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 6);
+	KUNIT_EXPECT_EQ(test, priv->data_bytes, 9 + EPD_TEST_SCREENSIZE + 1);
+	KUNIT_EXPECT_EQ(test, priv->update_mode, 0xF7);
+}
+
+static void epd_test_clear_display(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+
+	KUNIT_ASSERT_EQ(test, epd_clear_display(priv->epd), 0);
+
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 10);
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 9);
+	KUNIT_EXPECT_EQ(test, priv->data_bytes,
+			2 + 9 + 2 * EPD_TEST_SCREENSIZE + 1);
+	KUNIT_EXPECT_EQ(test, priv->busy_polls, EPD_TEST_BUSY_POLLS + 1);
+}
+
+static void epd_test_shared_bus_chunks(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+	unsigned int chunks = DIV_ROUND_UP(EPD_TEST_SCREENSIZE, 256);
+
+	epd->bus_mode = EPD_BUS_SHARED;
+	epd->spi_chunk_size = 256;
+	epd->spi_yield_us = 0;
+
+	KUNIT_ASSERT_EQ(test, epd_full_update(epd), 0);
+
+	/* Each RAM plane goes out in chunks, the byte count is unchanged */
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 9);
+	KUNIT_EXPECT_EQ(test, priv->data_xfers, 6 + 2 * chunks);
+	KUNIT_EXPECT_EQ(test, priv->data_bytes,
+			9 + 2 * EPD_TEST_SCREENSIZE + 2);
+}
+
+/* A hot panel keeps the simulated refreshes, and so the polling, short */
+#define EPD_TEST_SIM_TEMP 85
+
+static void epd_test_sim_full_update(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+	struct epd_sim *sim = epd_test_attach_sim(test, EPD_TEST_SIM_TEMP);
+	u32 max_error;
+	size_t i;
+
+	for (i = 0; i < EPD_TEST_SCREENSIZE; i++)
+		priv->frame[i] = i * 7;
+
+	KUNIT_ASSERT_EQ(test, epd_full_update(epd), 0);
+
+	KUNIT_EXPECT_MEMEQ(test, sim->bw_ram, epd->frame, EPD_TEST_SCREENSIZE);
+	KUNIT_EXPECT_MEMEQ(test, sim->red_ram, epd->frame,
+			   EPD_TEST_SCREENSIZE);
+	KUNIT_EXPECT_EQ(test, sim->stats.full, 1);
+	KUNIT_EXPECT_EQ(test, sim->stats.busy_violations, 0);
+	/* The panel started white, a full refresh leaves no visible ghost */
+	KUNIT_EXPECT_EQ(test, epd_sim_ghosted(sim, &max_error), 0);
+	KUNIT_EXPECT_LE(test, max_error, EPD_SIM_GHOST_THRESHOLD);
+	/* Polled until BUSY dropped, then once more to see it low */
+	KUNIT_EXPECT_EQ(test, priv->busy_polls,
+			DIV_ROUND_UP(sim->stats.last_busy_ms,
+				     EPD_BUSY_POLL_INTERVAL_MS) + 1);
+}
+
+static void epd_test_sim_partial_update(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+	struct epd_sim *sim = epd_test_attach_sim(test, EPD_TEST_SIM_TEMP);
+	u32 y;
+
+	KUNIT_ASSERT_EQ(test, epd_full_update(epd), 0);
+
+	/* Turn a 32x10 block white and refresh only that */
+	for (y = 8; y < 18; y++)
+		memset(&priv->frame[y * epd->bytes_per_line + 2], 0xFF, 4);
+	epd->partial_area.x = 16;
+	epd->partial_area.y = 8;
+	epd->partial_area.width = 32;
+	epd->partial_area.height = 10;
+	epd->partial_area_set = true;
+
+	epd_test_reset_counts(priv);
+	KUNIT_ASSERT_EQ(test, epd_partial_update(epd), 0);
+
+	KUNIT_EXPECT_MEMEQ(test, sim->bw_ram, epd->frame, EPD_TEST_SCREENSIZE);
+	/* Mode 2 leaves the new frame in RED RAM for the next diff */
+	KUNIT_EXPECT_MEMEQ(test, sim->red_ram, epd->frame,
+			   EPD_TEST_SCREENSIZE);
+	KUNIT_EXPECT_EQ(test, sim->stats.partial, 1);
+	KUNIT_EXPECT_EQ(test, sim->stats.busy_violations, 0);
+	/* Only the driven pixels carry the short waveform's residue */
+	KUNIT_EXPECT_EQ(test, epd_sim_ghosted(sim, NULL), 32 * 10);
+	KUNIT_EXPECT_LT(test, sim->stats.last_busy_ms, 1000);
+}
+
+static void epd_test_stream_slots(struct kunit *test)
+{
+	struct epd_test_priv *priv = test->priv;
+	struct epd_dev *epd = priv->epd;
+	struct epd_stream_info info;
+	struct epd_stream_slot *slot;
+	u8 *screen, *expected;
+	u32 dwell_ms, y;
+
+	/* Slots are copied into the framebuffer and uploaded from there */
+	epd->info = kunit_kzalloc(test, sizeof(*epd->info), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, epd->info);
+	screen = kunit_kzalloc(test, EPD_TEST_SCREENSIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, screen);
+	expected = kunit_kzalloc(test, EPD_TEST_SCREENSIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, expected);
+	epd->info->screen_base = (char __force __iomem *)screen;
+	epd->frame = NULL;
+
+	epd_stream_init(epd);
+	KUNIT_ASSERT_EQ(test, epd_stream_start(epd, &info), 0);
+	KUNIT_EXPECT_EQ(test, info.nr_slots, EPD_STREAM_SLOTS);
+	KUNIT_EXPECT_EQ(test, info.offset, epd->alloc_size);
+	KUNIT_EXPECT_EQ(test, epd_stream_play(epd, &dwell_ms), 0);
+
+	/* A white 32x10 delta at (16, 8) */
+	slot = (void *)(epd->stream.ring + 1);
+	slot->area.x = 16;
+	slot->area.y = 8;
+	slot->area.width = 32;
+	slot->area.height = 10;
+	slot->dwell_ms = 40;
+	memset(slot + 1, 0xFF, 4 * 10);
+	epd->stream.ring->head = 1;
+
+	KUNIT_ASSERT_EQ(test, epd_stream_play(epd, &dwell_ms), 1);
+	KUNIT_EXPECT_EQ(test, dwell_ms, 40);
+	KUNIT_EXPECT_EQ(test, epd->stream.ring->tail, 1);
+	for (y = 8; y < 18; y++)
+		memset(&expected[y * epd->bytes_per_line + 2], 0xFF, 4);
+	KUNIT_EXPECT_MEMEQ(test, screen, expected, EPD_TEST_SCREENSIZE);
+	/* The same traffic as a partial update of that area */
+	KUNIT_EXPECT_EQ(test, priv->data_bytes, 1 + 9 + 10 * 4 + 1);
+	KUNIT_EXPECT_EQ(test, priv->update_mode, 0xFF);
+
+	/* An unaligned slot stops playback before reaching the panel */
+	slot = (void *)((u8 *)(epd->stream.ring + 1) + info.slot_size);
+	slot->area.x = 4;
+	slot->area.y = 0;
+	slot->area.width = 16;
+	slot->area.height = 1;
+	epd->stream.ring->head = 2;
+	epd_test_reset_counts(priv);
+
+	KUNIT_EXPECT_EQ(test, epd_stream_play(epd, &dwell_ms), -EINVAL);
+	KUNIT_EXPECT_EQ(test, priv->cmd_xfers, 0);
+	KUNIT_EXPECT_EQ(test, epd->stream.ring->tail, 1);
+
+	epd_stream_destroy(epd);
+}
+
+static struct kunit_case epd_test_cases[] = {
+	KUNIT_CASE(epd_test_hw_init),
+	KUNIT_CASE(epd_test_full_update),
+	KUNIT_CASE(epd_test_partial_update),
+	KUNIT_CASE(epd_test_partial_unaligned),
+	KUNIT_CASE(epd_test_base_map_update),
+	KUNIT_CASE(epd_test_clear_display),
+	KUNIT_CASE(epd_test_shared_bus_chunks),
+	KUNIT_CASE(epd_test_sim_full_update),
+	KUNIT_CASE(epd_test_sim_partial_update),
+	KUNIT_CASE(epd_test_stream_slots),
+	{}
+};
+
+static struct kunit_suite epd_test_suite = {
+	.name = "pamir-ai-eink",
+	.init = epd_test_init,
+	.exit = epd_test_exit,
+	.test_cases = epd_test_cases,
+};
+
+kunit_test_suite(epd_test_suite);
@@ -0,0 +1,503 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Command stream capture and replay for Pamir AI E-Ink display
+ *
+ * /sys/kernel/debug/pamir-ai-eink/<device>/ holds:
+ *   capture          1 starts a new capture, 0 stops it
+ *   capture_payload  also record data bytes (needed for replay)
+ *   capture_size     buffer size in bytes for the next capture
+ *   dropped          events that did not fit in the buffer
+ *   trace            the capture, one event per line
+ *   replay           write a capture here to send it to the panel again
+ *
+ * Trace lines are "<usec> cmd 0xNN", "<usec> data <len> [hex]",
+ * "<usec> busy <waited ms> <ret>" and "<usec> reset", with time counted
+ * from the start of the capture. host/epd-replay feeds the same format to
+ * the SSD168x model.
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "pamir-ai-eink-internal.h"
+
+#define EPD_TRACE_SIZE_DEFAULT SZ_1M
+#define EPD_TRACE_SIZE_MAX SZ_64M
+
+struct epd_trace_rec {
+	u64 time_ns;
+	u32 len;	/* Data bytes, or ms spent waiting for BUSY */
+	u32 stored;	/* Payload bytes following the record */
+	s32 ret;
+	u8 event;
+	u8 cmd;
+};
+
+static const char * const epd_trace_event_names[] = {
+	[EPD_TRACE_CMD] = "cmd",
+	[EPD_TRACE_DATA] = "data",
+	[EPD_TRACE_BUSY] = "busy",
+	[EPD_TRACE_RESET] = "reset",
+};
+
+static DEFINE_MUTEX(epd_trace_root_lock);
+static struct dentry *epd_trace_root;
+static unsigned int epd_trace_users;
+
+static size_t epd_trace_rec_size(const struct epd_trace_rec *rec)
+{
+	return ALIGN(sizeof(*rec) + rec->stored, 8);
+}
+
+void epd_trace_event(struct epd_dev *epd, enum epd_trace_event event,
+		     u8 cmd, const u8 *buf, size_t len, int ret)
+{
+	struct epd_trace *t = &epd->trace;
+	struct epd_trace_rec *rec;
+	size_t stored, need;
+
+	if (!READ_ONCE(t->enabled))
+		return;
+
+	stored = t->payload && buf ? len : 0;
+	need = ALIGN(sizeof(*rec) + stored, 8);
+
+	spin_lock(&t->slock);
+	if (!t->enabled)
+		goto out;
+
+	if (t->used + need > t->buf_size) {
+		t->dropped++;
+		goto out;
+	}
+
+	rec = (struct epd_trace_rec *)(t->buf + t->used);
+	rec->time_ns = ktime_to_ns(ktime_sub(ktime_get(), t->start));
+	rec->len = len;
+	rec->stored = stored;
+	rec->ret = ret;
+	rec->event = event;
+	rec->cmd = cmd;
+	if (stored)
+		memcpy(rec + 1, buf, stored);
+	t->used += need;
+out:
+	spin_unlock(&t->slock);
+}
+
+static int epd_trace_start(struct epd_dev *epd)
+{
+	struct epd_trace *t = &epd->trace;
+	u32 size = clamp_t(u32, READ_ONCE(t->size), PAGE_SIZE,
+			   EPD_TRACE_SIZE_MAX);
+	u8 *buf, *old;
+
+	buf = vmalloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&t->lock);
+	spin_lock(&t->slock);
+	old = t->buf;
+	t->buf = buf;
+	t->buf_size = size;
+	t->used = 0;
+	t->dropped = 0;
+	t->start = ktime_get();
+	t->enabled = true;
+	spin_unlock(&t->slock);
+	mutex_unlock(&t->lock);
+
+	vfree(old);
+	return 0;
+}
+
+static void epd_trace_stop(struct epd_dev *epd)
+{
+	struct epd_trace *t = &epd->trace;
+
+	spin_lock(&t->slock);
+	t->enabled = false;
+	spin_unlock(&t->slock);
+}
+
+static ssize_t epd_trace_capture_read(struct file *file, char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct epd_dev *epd = file->private_data;
+	char buf[3];
+
+	buf[0] = READ_ONCE(epd->trace.enabled) ? '1' : '0';
+	buf[1] = '\n';
+	buf[2] = '\0';
+	return simple_read_from_buffer(ubuf, count, ppos, buf, 2);
+}
+
+static ssize_t epd_trace_capture_write(struct file *file,
+				       const char __user *ubuf, size_t count,
+				       loff_t *ppos)
+{
+	struct epd_dev *epd = file->private_data;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+
+	if (enable) {
+		ret = epd_trace_start(epd);
+		if (ret)
+			return ret;
+	} else {
+		epd_trace_stop(epd);
+	}
+
+	return count;
+}
+
+static const struct file_operations epd_trace_capture_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = epd_trace_capture_read,
+	.write = epd_trace_capture_write,
+	.llseek = default_llseek,
+};
+
+/* Positions are byte offsets into the buffer plus one; 0 is the header */
+static void *epd_trace_seq_at(struct epd_trace *t, loff_t pos)
+{
+	struct epd_trace_rec *rec;
+	size_t used;
+
+	spin_lock(&t->slock);
+	used = t->used;
+	spin_unlock(&t->slock);
+
+	/* A new capture may have started since the last read() */
+	if (!t->buf || pos - 1 + sizeof(*rec) > used)
+		return NULL;
+
+	rec = (struct epd_trace_rec *)(t->buf + pos - 1);
+	if (rec->event >= ARRAY_SIZE(epd_trace_event_names) ||
+	    pos - 1 + epd_trace_rec_size(rec) > used)
+		return NULL;
+
+	return rec;
+}
+
+static void *epd_trace_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct epd_dev *epd = m->private;
+
+	mutex_lock(&epd->trace.lock);
+	if (!*pos)
+		return SEQ_START_TOKEN;
+
+	return epd_trace_seq_at(&epd->trace, *pos);
+}
+
+static void *epd_trace_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct epd_dev *epd = m->private;
+
+	if (v == SEQ_START_TOKEN)
+		*pos = 1;
+	else
+		*pos += epd_trace_rec_size(v);
+
+	return epd_trace_seq_at(&epd->trace, *pos);
+}
+
+static void epd_trace_seq_stop(struct seq_file *m, void *v)
+{
+	struct epd_dev *epd = m->private;
+
+	mutex_unlock(&epd->trace.lock);
+}
+
+static int epd_trace_seq_show(struct seq_file *m, void *v)
+{
+	struct epd_dev *epd = m->private;
+	const struct epd_trace_rec *rec = v;
+	const u8 *payload = (const u8 *)(rec + 1);
+	u64 time_us;
+	u32 i;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_printf(m, "# %s %s %ux%u\n", DRIVER_NAME, epd->ctrl->name,
+			   epd->width, epd->height);
+		return 0;
+	}
+
+	time_us = div_u64(rec->time_ns, NSEC_PER_USEC);
+	seq_printf(m, "%llu %s", time_us, epd_trace_event_names[rec->event]);
+
+	switch (rec->event) {
+	case EPD_TRACE_CMD:
+		seq_printf(m, " 0x%02x", rec->cmd);
+		break;
+	case EPD_TRACE_DATA:
+		seq_printf(m, " %u", rec->len);
+		if (rec->stored)
+			seq_putc(m, ' ');
+		for (i = 0; i < rec->stored; i += 32) {
+			char hex[64];
+			u32 n = min_t(u32, rec->stored - i, 32);
+
+			bin2hex(hex, payload + i, n);
+			seq_write(m, hex, 2 * n);
+		}
+		break;
+	case EPD_TRACE_BUSY:
+		seq_printf(m, " %u %d", rec->len, rec->ret);
+		break;
+	}
+
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static const struct seq_operations epd_trace_seq_ops = {
+	.start = epd_trace_seq_start,
+	.next = epd_trace_seq_next,
+	.stop = epd_trace_seq_stop,
+	.show = epd_trace_seq_show,
+};
+
+static int epd_trace_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	ret = seq_open(file, &epd_trace_seq_ops);
+	if (ret)
+		return ret;
+
+	((struct seq_file *)file->private_data)->private = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations epd_trace_fops = {
+	.owner = THIS_MODULE,
+	.open = epd_trace_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+/* Replay state, one per open file */
+struct epd_replay {
+	char *line;
+	size_t len;
+	size_t max;
+	u8 *data;
+	size_t data_max;
+};
+
+static int epd_replay_line(struct epd_dev *epd, struct epd_replay *r,
+			   char *line)
+{
+	unsigned long long time_us;
+	unsigned int len;
+	char event[8];
+	char *args;
+	int n = 0;
+	u8 cmd;
+	int ret;
+
+	line = strim(line);
+	if (!*line || *line == '#')
+		return 0;
+
+	if (sscanf(line, "%llu %7s %n", &time_us, event, &n) != 2 || !n)
+		return -EINVAL;
+	args = line + n;
+
+	if (!strcmp(event, "cmd")) {
+		ret = kstrtou8(args, 0, &cmd);
+		if (ret)
+			return ret;
+		return epd_send_cmd(epd, cmd);
+	}
+
+	if (!strcmp(event, "data")) {
+		n = 0;
+		if (sscanf(args, "%u %n", &len, &n) != 1)
+			return -EINVAL;
+		if (len > r->data_max)
+			return -EINVAL;
+		if (strlen(args + n) != 2 * len) {
+			dev_err(&epd->spi->dev,
+				"Replay needs a capture with payload\n");
+			return -ENODATA;
+		}
+		ret = hex2bin(r->data, args + n, len);
+		if (ret)
+			return ret;
+		return epd_send_data_buf(epd, r->data, len);
+	}
+
+	if (!strcmp(event, "busy"))
+		return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
+
+	if (!strcmp(event, "reset")) {
+		epd_hw_reset(epd);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int epd_replay_open(struct inode *inode, struct file *file)
+{
+	struct epd_dev *epd = inode->i_private;
+	struct epd_replay *r;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	/* The longest line is a whole frame in hex */
+	r->data_max = epd->alloc_size;
+	r->max = 2 * r->data_max + 64;
+	r->line = kvmalloc(r->max + 1, GFP_KERNEL);
+	r->data = kvmalloc(r->data_max, GFP_KERNEL);
+	if (!r->line || !r->data) {
+		kvfree(r->line);
+		kvfree(r->data);
+		kfree(r);
+		return -ENOMEM;
+	}
+
+	file->private_data = r;
+	return nonseekable_open(inode, file);
+}
+
+/*
+ * Lines are executed as soon as they are complete, with the device lock
+ * held for each write() so updates from the framebuffer do not interleave
+ * with a buffer's worth of replayed commands.
+ */
+static ssize_t epd_replay_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct epd_dev *epd = file_inode(file)->i_private;
+	struct epd_replay *r = file->private_data;
+	size_t done = 0;
+	int ret = 0;
+
+	mutex_lock(&epd->lock);
+	epd_bus_begin(epd);
+
+	while (done < count) {
+		char c;
+
+		if (get_user(c, ubuf + done)) {
+			ret = -EFAULT;
+			break;
+		}
+		done++;
+
+		if (c != '\n') {
+			if (r->len == r->max) {
+				ret = -E2BIG;
+				break;
+			}
+			r->line[r->len++] = c;
+			continue;
+		}
+
+		r->line[r->len] = '\0';
+		r->len = 0;
+		ret = epd_replay_line(epd, r, r->line);
+		if (ret)
+			break;
+	}
+
+	epd_bus_end(epd);
+	mutex_unlock(&epd->lock);
+
+	if (ret) {
+		r->len = 0;
+		return ret;
+	}
+
+	return done;
+}
+
+static int epd_replay_release(struct inode *inode, struct file *file)
+{
+	struct epd_dev *epd = inode->i_private;
+	struct epd_replay *r = file->private_data;
+
+	/* A last line without a newline */
+	if (r->len) {
+		r->line[r->len] = '\0';
+		mutex_lock(&epd->lock);
+		epd_bus_begin(epd);
+		epd_replay_line(epd, r, r->line);
+		epd_bus_end(epd);
+		mutex_unlock(&epd->lock);
+	}
+
+	kvfree(r->line);
+	kvfree(r->data);
+	kfree(r);
+	return 0;
+}
+
+static const struct file_operations epd_replay_fops = {
+	.owner = THIS_MODULE,
+	.open = epd_replay_open,
+	.write = epd_replay_write,
+	.release = epd_replay_release,
+};
+
+void epd_trace_init(struct epd_dev *epd)
+{
+	struct epd_trace *t = &epd->trace;
+
+	mutex_init(&t->lock);
+	spin_lock_init(&t->slock);
+	t->size = EPD_TRACE_SIZE_DEFAULT;
+
+	mutex_lock(&epd_trace_root_lock);
+	if (!epd_trace_users++)
+		epd_trace_root = debugfs_create_dir(DRIVER_NAME, NULL);
+	mutex_unlock(&epd_trace_root_lock);
+
+	t->dir = debugfs_create_dir(dev_name(&epd->spi->dev), epd_trace_root);
+	debugfs_create_file("capture", 0600, t->dir, epd,
+			    &epd_trace_capture_fops);
+	debugfs_create_bool("capture_payload", 0600, t->dir, &t->payload);
+	debugfs_create_u32("capture_size", 0600, t->dir, &t->size);
+	debugfs_create_u32("dropped", 0400, t->dir, &t->dropped);
+	debugfs_create_file("trace", 0400, t->dir, epd, &epd_trace_fops);
+	debugfs_create_file("replay", 0200, t->dir, epd, &epd_replay_fops);
+}
+
+void epd_trace_destroy(struct epd_dev *epd)
+{
+	struct epd_trace *t = &epd->trace;
+
+	debugfs_remove_recursive(t->dir);
+	t->dir = NULL;
+
+	mutex_lock(&epd_trace_root_lock);
+	if (!--epd_trace_users) {
+		debugfs_remove(epd_trace_root);
+		epd_trace_root = NULL;
+	}
+	mutex_unlock(&epd_trace_root_lock);
+
+	epd_trace_stop(epd);
+	vfree(t->buf);
+	t->buf = NULL;
+}
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * UC8179 controller support for Pamir AI E-Ink display
+ *
+ * Copyright (C) 2025 Pamir AI
+ */
+
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+
+#include "pamir-ai-eink-internal.h"
+
+#define UC8179_CMD_PANEL_SETTING 0x00
+#define UC8179_CMD_POWER_SETTING 0x01
+#define UC8179_CMD_POWER_OFF 0x02
+#define UC8179_CMD_POWER_ON 0x04
+#define UC8179_CMD_BOOSTER_SOFT_START 0x06
+#define UC8179_CMD_DEEP_SLEEP 0x07
+#define UC8179_CMD_DATA_START_OLD 0x10
+#define UC8179_CMD_DISPLAY_REFRESH 0x12
+#define UC8179_CMD_DATA_START_NEW 0x13
+#define UC8179_CMD_DUAL_SPI 0x15
+#define UC8179_CMD_VCOM_DATA_INTERVAL 0x50
+#define UC8179_CMD_TCON 0x60
+#define UC8179_CMD_RESOLUTION 0x61
+#define UC8179_CMD_PARTIAL_WINDOW 0x90
+#define UC8179_CMD_PARTIAL_IN 0x91
+#define UC8179_CMD_PARTIAL_OUT 0x92
+#define UC8179_CMD_CASCADE_SETTING 0xE0
+#define UC8179_CMD_FORCE_TEMP 0xE5
+
+#define UC8179_DEEP_SLEEP_CHECK 0xA5
+/* Forced temperatures selecting the OTP's shorter waveforms */
+#define UC8179_TEMP_FAST 0x5A
+#define UC8179_TEMP_PARTIAL 0x6E
+
+/* Send a command followed by a short parameter list */
+static int uc8179_write(struct epd_dev *epd, u8 cmd, const u8 *data,
+			size_t len)
+{
+	int ret;
+
+	ret = epd_send_cmd(epd, cmd);
+	if (ret)
+		return ret;
+
+	return epd_send_data_buf(epd, data, len);
+}
+
+static int uc8179_init(struct epd_dev *epd)
+{
+	static const u8 power[] = { 0x07, 0x07, 0x28, 0x17 };
+	static const u8 booster[] = { 0x17, 0x17, 0x28, 0x17 };
+	static const u8 psr[] = { 0x1F }; /* KW mode, LUT from OTP */
+	static const u8 dual_spi[] = { 0x00 };
+	/* DDX=01: a set bit is white, matching the framebuffer */
+	static const u8 cdi[] = { 0x11, 0x07 };
+	static const u8 tcon[] = { 0x22 };
+	u8 res[4];
+	int ret;
+
+	epd_hw_reset(epd);
+
+	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	if (ret)
+		return ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_POWER_SETTING, power, sizeof(power));
+	if (ret)
+		return ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_BOOSTER_SOFT_START, booster,
+			   sizeof(booster));
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, UC8179_CMD_POWER_ON);
+	if (ret)
+		return ret;
+
+	usleep_range(100000, 110000);
+	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	if (ret)
+		return ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_PANEL_SETTING, psr, sizeof(psr));
+	if (ret)
+		return ret;
+
+	res[0] = (epd->width >> 8) & 0xff;
+	res[1] = epd->width & 0xff;
+	res[2] = (epd->height >> 8) & 0xff;
+	res[3] = epd->height & 0xff;
+	ret = uc8179_write(epd, UC8179_CMD_RESOLUTION, res, sizeof(res));
+	if (ret)
+		return ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_DUAL_SPI, dual_spi,
+			   sizeof(dual_spi));
+	if (ret)
+		return ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_VCOM_DATA_INTERVAL, cdi,
+			   sizeof(cdi));
+	if (ret)
+		return ret;
+
+	return uc8179_write(epd, UC8179_CMD_TCON, tcon, sizeof(tcon));
+}
+
+static int uc8179_force_temp(struct epd_dev *epd, u8 temp)
+{
+	u8 data = 0x02; /* Use the forced temperature below */
+	int ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_CASCADE_SETTING, &data, 1);
+	if (ret)
+		return ret;
+
+	return uc8179_write(epd, UC8179_CMD_FORCE_TEMP, &temp, 1);
+}
+
+static int uc8179_refresh(struct epd_dev *epd)
+{
+	int ret;
+
+	ret = epd_send_cmd(epd, UC8179_CMD_DISPLAY_REFRESH);
+	if (ret)
+		return ret;
+
+	/* BUSY_N only drops a little after the refresh command */
+	usleep_range(1000, 2000);
+	return epd_wait_busy(epd, EPD_BUSY_TIMEOUT_UPDATE_MS);
+}
+
+/* Old and new data both get the frame so later partial updates diff cleanly */
+static int uc8179_write_frame(struct epd_dev *epd, const u8 *buf)
+{
+	int ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_DATA_START_OLD, buf,
+			   epd->screensize);
+	if (ret)
+		return ret;
+
+	return uc8179_write(epd, UC8179_CMD_DATA_START_NEW, buf,
+			    epd->screensize);
+}
+
+static int uc8179_full_update(struct epd_dev *epd, const u8 *buf)
+{
+	u8 data = 0x00; /* Back to the on-chip temperature sensor */
+	int ret;
+
+	ret = uc8179_write(epd, UC8179_CMD_CASCADE_SETTING, &data, 1);
+	if (ret)
+		return ret;
+
+	ret = uc8179_write_frame(epd, buf);
+	if (ret)
+		return ret;
+
+	return uc8179_refresh(epd);
+}
+
+static int uc8179_fast_update(struct epd_dev *epd, const u8 *buf)
+{
+	int ret;
+
+	ret = uc8179_force_temp(epd, UC8179_TEMP_FAST);
+	if (ret)
+		return ret;
+
+	ret = uc8179_write_frame(epd, buf);
+	if (ret)
+		return ret;
+
+	return uc8179_refresh(epd);
+}
+
+static int uc8179_partial_update(struct epd_dev *epd, const u8 *buf,
+				 const struct epd_update_area *area)
+{
+	u32 x_bytes = area->width / 8;
+	u16 x_end = area->x + area->width - 1;
+	u16 y_end = area->y + area->height - 1;
+	u8 window[9];
+	u32 y;
+	int ret;
+
+	ret = uc8179_force_temp(epd, UC8179_TEMP_PARTIAL);
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, UC8179_CMD_PARTIAL_IN);
+	if (ret)
+		return ret;
+
+	window[0] = (area->x >> 8) & 0xff;
+	window[1] = area->x & 0xf8;
+	window[2] = (x_end >> 8) & 0xff;
+	window[3] = (x_end & 0xff) | 0x07;
+	window[4] = (area->y >> 8) & 0xff;
+	window[5] = area->y & 0xff;
+	window[6] = (y_end >> 8) & 0xff;
+	window[7] = y_end & 0xff;
+	window[8] = 0x01; /* Scan inside the window only */
+	ret = uc8179_write(epd, UC8179_CMD_PARTIAL_WINDOW, window,
+			   sizeof(window));
+	if (ret)
+		return ret;
+
+	ret = epd_send_cmd(epd, UC8179_CMD_DATA_START_NEW);
+	if (ret)
+		goto out_partial;
+
+	for (y = area->y; y <= y_end; y++) {
+		ret = epd_send_data_buf(epd,
+					buf + y * epd->bytes_per_line +
+						area->x / 8,
+					x_bytes);
+		if (ret)
+			goto out_partial;
+	}
+
+	ret = uc8179_refresh(epd);
+	if (ret)
+		goto out_partial;
+
+	/* The window's new data becomes the old data of the next update */
+	ret = epd_send_cmd(epd, UC8179_CMD_DATA_START_OLD);
+	if (ret)
+		goto out_partial;
+
+	for (y = area->y; y <= y_end; y++) {
+		ret = epd_send_data_buf(epd,
+					buf + y * epd->bytes_per_line +
+						area->x / 8,
+					x_bytes);
+		if (ret)
+			goto out_partial;
+	}
+
+out_partial:
+	epd_send_cmd(epd, UC8179_CMD_PARTIAL_OUT);
+	return ret;
+}
+
+static int uc8179_clear(struct epd_dev *epd)
+{
+	u8 *clear_buf;
+	int ret;
+
+	clear_buf = kmalloc(epd->screensize, GFP_KERNEL);
+	if (!clear_buf)
+		return -ENOMEM;
+	memset(clear_buf, 0xFF, epd->screensize);
+
+	ret = uc8179_full_update(epd, clear_buf);
+
+	kfree(clear_buf);
+	return ret;
+}
+
+static int uc8179_deep_sleep(struct epd_dev *epd)
+{
+	u8 data = UC8179_DEEP_SLEEP_CHECK;
+	int ret;
+
+	ret = epd_send_cmd(epd, UC8179_CMD_POWER_OFF);
+	if (ret)
+		return ret;
+
+	ret = epd_wait_busy(epd, EPD_BUSY_TIMEOUT_INIT_MS);
+	if (ret)
+		return ret;
+
+	return uc8179_write(epd, UC8179_CMD_DEEP_SLEEP, &data, 1);
+}
+
+const struct epd_controller epd_uc8179_controller = {
+	.name = "uc8179",
+	.caps = EPD_CAP_PARTIAL | EPD_CAP_FAST,
+	.max_width = 800,
+	.max_height = 600,
+	.init = uc8179_init,
+	.full_update = uc8179_full_update,
+	.fast_update = uc8179_fast_update,
+	.partial_update = uc8179_partial_update,
+	.base_map_update = uc8179_full_update,
+	.clear = uc8179_clear,
+	.deep_sleep = uc8179_deep_sleep,
+};
@@ -20,11 +20,17 @@
 #define EPD_IOC_SET_BASE_MAP _IOW(EPD_IOC_MAGIC, 6, void *)
 #define EPD_IOC_RESET _IO(EPD_IOC_MAGIC, 7)
 #define EPD_IOC_CLEAR_DISPLAY _IO(EPD_IOC_MAGIC, 8)
+#define EPD_IOC_GROUP_UPDATE _IO(EPD_IOC_MAGIC, 9)
+#define EPD_IOC_STREAM_START _IOR(EPD_IOC_MAGIC, 10, struct epd_stream_info)
+#define EPD_IOC_STREAM_KICK _IO(EPD_IOC_MAGIC, 11)
+#define EPD_IOC_STREAM_WAIT _IOW(EPD_IOC_MAGIC, 12, __u32)
+#define EPD_IOC_STREAM_STOP _IO(EPD_IOC_MAGIC, 13)
 
 enum epd_update_mode {
 	EPD_MODE_FULL = 0,
 	EPD_MODE_PARTIAL,
 	EPD_MODE_BASE_MAP,
+	EPD_MODE_FAST,
 };
 
 struct epd_update_area {
@@ -34,4 +40,43 @@ struct epd_update_area {
 	__u16 height;
 };
 
+/*
+ * Streaming mode. EPD_IOC_STREAM_START sets up a ring of frame slots,
+ * mapped with mmap() at info.offset, which the driver plays back to back
+ * with no further system calls. To queue a frame, fill the slot at index
+ * head % nr_slots, then advance head with a release store. The driver
+ * advances tail as slots are played; EPD_IOC_STREAM_KICK starts playback
+ * after the ring ran empty and EPD_IOC_STREAM_WAIT also kicks, then blocks
+ * until at least the given number of slots are free.
+ */
+struct epd_stream_info {
+	__u32 nr_slots;
+	__u32 slot_size;	/* Bytes from one slot to the next */
+	__u32 offset;		/* mmap() offset of the ring */
+	__u32 size;		/* mmap() length of the ring */
+};
+
+/* At the start of the ring, followed by the slots */
+struct epd_stream_ring {
+	__u32 head;		/* Slots queued, written by userspace */
+	__u32 tail;		/* Slots played, written by the driver */
+	__u32 nr_slots;
+	__u32 slot_size;
+	__s32 error;		/* Error that stopped playback, or 0 */
+	__u32 reserved[3];
+};
+
+#define EPD_STREAM_FULL (1 << 0)	/* Full refresh instead of partial */
+
+/*
+ * Slot header, followed by area.height rows of area.width / 8 bytes that
+ * are copied into the framebuffer at area before it is refreshed. An area
+ * covering the panel streams whole frames, smaller ones frame deltas.
+ */
+struct epd_stream_slot {
+	struct epd_update_area area;
+	__u32 dwell_ms;		/* From this refresh starting to the next */
+	__u32 flags;
+};
+
 #endif /* _UAPI_PAMIR_AI_EINK_H */